@@ -22,9 +22,16 @@
 //
 
 #include "adapters.h"
+#include "endpointmap.h"
 
 // MARK: - BridgeAdapter
 
+BridgeAdapter::BridgeAdapter() :
+  mBulkWork("bulk work")
+{
+}
+
+
 void BridgeAdapter::startup(BridgeMainDelegate& aBridgeMainDelegate)
 {
   mBridgeMainDelegateP = &aBridgeMainDelegate;
@@ -58,6 +65,9 @@ bool BridgeAdapter::hasBridgeableDevices()
 
 void BridgeAdapter::cleanup()
 {
+  mBulkWork.clear();
+  mArrivedDevicesTicket.cancel();
+  mArrivedDevices.clear();
 }
 
 
@@ -75,25 +85,45 @@ void BridgeAdapter::bridgeAdditionalDevice(DevicePtr aDevice)
     DevicePtr dev = pos->second;
     EndpointId previousEndpoint = dev->endpointId();
     if (previousEndpoint!=kInvalidEndpointId) {
-      if (emberAfEndpointIsEnabled(previousEndpoint)) {
+      if (isEndpointEnabled(previousEndpoint)) {
         // already enabled - should not happen
         POLOG(dev, LOG_ERR, "is already bridged and operational, cannot be added again!")
         return;
       }
       else {
         // exists, but is disabled - re-enable
-        // - use newer definition of the device
+        // - use newer definition of the device, which takes over the previous device's endpoint(s)
         mDeviceUIDMap[aDevice->deviceInfoDelegate().endpointUID()] = aDevice;
-        mBridgeMainDelegateP->reEnableDevice(aDevice, *this);
+        mBridgeMainDelegateP->reEnableDevice(aDevice, dev, *this);
         return;
       }
     }
   }
   // is new, or previous device with same endpointUID had no endpoint assigned yet -> add it
   mDeviceUIDMap[aDevice->deviceInfoDelegate().endpointUID()] = aDevice;
-  ErrorPtr err = mBridgeMainDelegateP->addAdditionalDevice(aDevice, *this);
+  // - but together with all other devices arriving in this mainloop cycle
+  if (mArrivedDevices.empty()) {
+    mArrivedDevicesTicket.executeOnce(boost::bind(&BridgeAdapter::installArrivedDevices, this), 0);
+  }
+  for (DevicesList::iterator apos = mArrivedDevices.begin(); apos!=mArrivedDevices.end(); ++apos) {
+    if ((*apos)->deviceInfoDelegate().endpointUID()==aDevice->deviceInfoDelegate().endpointUID()) {
+      // same device arrived again before being installed, use newer definition
+      mArrivedDevices.erase(apos);
+      break;
+    }
+  }
+  mArrivedDevices.push_back(aDevice);
+}
+
+
+void BridgeAdapter::installArrivedDevices()
+{
+  mArrivedDevicesTicket.cancel();
+  DevicesList devices;
+  devices.swap(mArrivedDevices);
+  ErrorPtr err = mBridgeMainDelegateP->addAdditionalDevices(devices, *this);
   if (Error::notOK(err)) {
-    POLOG(aDevice, LOG_ERR, "cannot add device: %s", err->text());
+    LOG(LOG_ERR, "cannot add all of %zu arrived devices: %s", devices.size(), err->text());
   }
 }
 
@@ -104,6 +134,53 @@ void BridgeAdapter::removeDevice(DevicePtr aDevice)
 }
 
 
+bool BridgeAdapter::isEndpointEnabled(EndpointId aEndpointId)
+{
+  return mBridgeMainDelegateP->isEndpointEnabled(aEndpointId, *this);
+}
+
+
+void BridgeAdapter::setSharding(int aNumShards, int aShardIndex, bool aByZone)
+{
+  if (aNumShards<1) aNumShards = 1;
+  if (aShardIndex<0 || aShardIndex>=aNumShards) {
+    LOG(LOG_ERR, "invalid shard index %d for %d shards, using shard 0", aShardIndex, aNumShards);
+    aShardIndex = 0;
+  }
+  mNumShards = aNumShards;
+  mShardIndex = aShardIndex;
+  mShardByZone = aByZone;
+  if (isSharded()) {
+    LOG(LOG_NOTICE, "sharding: this instance is shard %d of %d, partitioned by %s", mShardIndex, mNumShards, mShardByZone ? "zone" : "endpointUID");
+  }
+}
+
+
+bool BridgeAdapter::isInShard(const string aEndpointUID, int aZoneId)
+{
+  if (!isSharded()) return true;
+  if (mShardByZone && aZoneId>=0) {
+    return aZoneId % mNumShards == mShardIndex;
+  }
+  // use the same stable hash as the endpoint map, so all instances agree on the partitioning
+  return EndpointMap::uidHash(aEndpointUID) % static_cast<uint64_t>(mNumShards) == static_cast<uint64_t>(mShardIndex);
+}
+
+
+void BridgeAdapter::updateAllDevicesReachability(bool aApiConnected)
+{
+  int n = 0;
+  for (DeviceUIDMap::iterator pos = mDeviceUIDMap.begin(); pos!=mDeviceUIDMap.end(); ++pos) {
+    DevicePtr dev = pos->second;
+    if (dev->endpointId()==kInvalidEndpointId) continue; // not installed
+    // Note: updateReachable() only reports actual changes
+    dev->updateReachable(aApiConnected && dev->deviceInfoDelegate().isReachable(), UpdateMode(UpdateFlags::matter));
+    n++;
+  }
+  LOG(LOG_NOTICE, "bridge API %s: updated reachability of %d devices", aApiConnected ? "connected" : "disconnected", n);
+}
+
+
 ErrorPtr BridgeAdapter::requestCommissioning(bool aCommissionable)
 {
   return mBridgeMainDelegateP->makeCommissionable(aCommissionable, *this);
@@ -27,6 +27,7 @@
 
 #include "device.h"
 #include "actions.h"
+#include "dispatchqueue.h"
 
 // commonly needed matter headers
 #include <app-common/zap-generated/attributes/Accessors.h>
@@ -58,9 +59,9 @@ public:
   /// can be be called by the bridge implementation at any time after
   /// adapter startup up to when cleanup() is invoked to add further devices while the matter
   /// bridge is already operational.
-  /// @param aDevice device to add
-  /// @return ok or error when device could not be added
-  virtual ErrorPtr addAdditionalDevice(DevicePtr aDevice, BridgeAdapter& aAdapter) = 0;
+  /// @param aDevices devices to add, all installed together (one endpoint map commit)
+  /// @return ok or error when not all devices could be added
+  virtual ErrorPtr addAdditionalDevices(DevicesList& aDevices, BridgeAdapter& aAdapter) = 0;
 
   /// can be be called by the bridge implementation to disable a device that no
   /// longer exists at the bridge's other end. It may be re-enabled later
@@ -70,8 +71,16 @@ public:
 
   /// can be be called by the bridge implementation to re-enable a device that was
   /// disabled while the bridge was operational
-  /// @param aDevice device to re-enable
-  virtual void reEnableDevice(DevicePtr aDevice, BridgeAdapter& aAdapter) = 0;
+  /// @param aDevice newer definition of the device to re-enable. This takes over the endpoint(s)
+  ///   of aPreviousDevice, including those of its subdevices with matching endpointUIDs.
+  /// @param aPreviousDevice the previously installed, now disabled device with the same endpointUID
+  virtual void reEnableDevice(DevicePtr aDevice, DevicePtr aPreviousDevice, BridgeAdapter& aAdapter) = 0;
+
+  /// can be called to check if an endpoint is enabled, including enable/disable changes
+  /// that are already requested, but not yet applied
+  /// @param aEndpointId endpoint to check
+  /// @return true if endpoint is (or will be) enabled
+  virtual bool isEndpointEnabled(EndpointId aEndpointId, BridgeAdapter& aAdapter) = 0;
 
   /// can be called to make the bridge device open or close a commissioning window
   /// @param aCommissionable requested commissionable status
@@ -111,11 +120,26 @@ protected:
   typedef std::map<string, DevicePtr> DeviceUIDMap;
   DeviceUIDMap mDeviceUIDMap;
 
+  /// for splitting bulk work (processing device lists, zone updates) into chunks that yield to the mainloop
+  DispatchQueue mBulkWork;
+
+  BridgeAdapter();
+
 private:
 
   /// delegate for calling main-level functionality from adapters
   BridgeMainDelegate* mBridgeMainDelegateP = nullptr;
 
+  int mNumShards = 1; ///< number of p44mbrd instances (shards) sharing the same bridge API
+  int mShardIndex = 0; ///< index of this instance among the shards (0..mNumShards-1)
+  bool mShardByZone = false; ///< if set, devices are partitioned by zone rather than by endpointUID hash
+
+  /// additional devices arrived in the current mainloop cycle, to be installed together
+  DevicesList mArrivedDevices;
+  MLTicket mArrivedDevicesTicket;
+
+  void installArrivedDevices();
+
 public:
 
   using UpdateMode = Device::UpdateMode;
@@ -134,6 +158,17 @@ public:
   /// @return true if the adapter has at least one bridgeable device registered
   bool hasBridgeableDevices();
 
+  /// set up sharding, i.e. have this instance bridge only a deterministic subset of the devices
+  /// @param aNumShards number of p44mbrd instances running against the same bridge API
+  /// @param aShardIndex index of this instance (0..aNumShards-1)
+  /// @param aByZone if set, devices are partitioned by zone, otherwise by hash of their endpointUID
+  /// @note must be called before startup()
+  void setSharding(int aNumShards, int aShardIndex, bool aByZone);
+
+  /// @param aSlice max time to spend on bulk work (such as processing the device list at startup)
+  ///   per mainloop cycle, 0 = do bulk work in one pass
+  void setBulkWorkSlice(MLMicroSeconds aSlice) { mBulkWork.setBudget(aSlice); }
+
   /// @}
 
   /// @name functionality **to implement** in the adapter
@@ -221,6 +256,9 @@ public:
   /// @note register only bridge-level devices, not subdevices of a composed device!
   ///   Subdevices must be added to the composed device via addSubdevice() BEFORE the
   ///   composed device is registered, and will be published to the matter side automatically.
+  /// @note new devices are not installed immediately, but together with all other devices
+  ///   added in the same mainloop cycle. So adapters should add devices arriving in bulk
+  ///   (e.g. after a bus scan) from one call stack.
   void bridgeAdditionalDevice(DevicePtr aDevice);
 
   /// @brief remove (disable) a device which is already bridged. This is for devices
@@ -231,6 +269,30 @@ public:
   /// @param aDevice the device to remove.
   void removeDevice(DevicePtr aDevice);
 
+  /// @param aEndpointId endpoint to check
+  /// @return true if endpoint is enabled, or will be when pending enable/disable changes are applied
+  /// @note use this rather than emberAfEndpointIsEnabled(), because endpoint enable/disable
+  ///   changes are collected and applied in batches.
+  bool isEndpointEnabled(EndpointId aEndpointId);
+
+  /// @return true if this adapter is one of several shards
+  bool isSharded() { return mNumShards>1; }
+
+  /// @return index of this shard (0 if not sharded)
+  int shardIndex() { return mShardIndex; }
+
+  /// @brief check if a device belongs to this shard
+  /// @param aEndpointUID the endpointUID of the (top level) device
+  /// @param aZoneId the zone the device is in, or -1 if not known. Devices without known zone
+  ///   are partitioned by endpointUID hash even when sharding by zone.
+  /// @return true if the device should be bridged by this instance (always true when not sharded)
+  bool isInShard(const string aEndpointUID, int aZoneId = -1);
+
+  /// @brief update reachability of all devices of this adapter in one pass
+  /// @param aApiConnected if false, all devices are reported unreachable (bridge API connection lost),
+  ///   otherwise, devices are reported with the reachability their device info delegate reports.
+  void updateAllDevicesReachability(bool aApiConnected);
+
   /// @brief can be called to request opening or closing the commissioning window
   /// @param aCommissionable requested commissionable status
   /// @note reportCommissionable() will be called to report when commissioning window status
@@ -0,0 +1,374 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "apicapture.h"
+#include "apisocket.h"
+
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace p44;
+
+static const char* gCaptureMagic = "P44MBCAP"; ///< file header (followed by a version byte)
+static const uint8_t gCaptureVersion = 1;
+
+// MARK: - ApiCapture
+
+bool ApiCapture::sEnabled = false;
+
+
+ApiCapture::ApiCapture() :
+  mMaxSize(API_CAPTURE_MAX_SIZE),
+  mFile(nullptr),
+  mSize(0),
+  mLastRecord(Never)
+{
+}
+
+
+ApiCapture::~ApiCapture()
+{
+  closeFile();
+}
+
+
+ApiCapture& ApiCapture::sharedCapture()
+{
+  static ApiCapture capture;
+  return capture;
+}
+
+
+void ApiCapture::setup(const string aCaptureFile, size_t aMaxSize)
+{
+  mCaptureFile = aCaptureFile;
+  if (aMaxSize>0) mMaxSize = aMaxSize;
+}
+
+
+void ApiCapture::enable(bool aEnable)
+{
+  if (aEnable==sEnabled) return;
+  if (aEnable) {
+    ErrorPtr err = openFile();
+    if (Error::notOK(err)) {
+      LOG(LOG_ERR, "API capture: cannot open '%s': %s", mCaptureFile.c_str(), err->text());
+      return;
+    }
+    sEnabled = true;
+    LOG(LOG_NOTICE, "API capture started into '%s'", mCaptureFile.c_str());
+  }
+  else {
+    sEnabled = false;
+    closeFile();
+    LOG(LOG_NOTICE, "API capture stopped");
+  }
+}
+
+
+ErrorPtr ApiCapture::openFile()
+{
+  if (mCaptureFile.empty()) return TextError::err("no capture file path set");
+  if (access(mCaptureFile.c_str(), F_OK)==0) {
+    // do not overwrite an existing capture, rotate it
+    if (rename(mCaptureFile.c_str(), (mCaptureFile+".1").c_str())!=0) return SysError::errNo("cannot rotate existing capture file: ");
+  }
+  mFile = fopen(mCaptureFile.c_str(), "w");
+  if (!mFile) return SysError::errNo();
+  fwrite(gCaptureMagic, 1, strlen(gCaptureMagic), mFile);
+  fputc(gCaptureVersion, mFile);
+  mSize = strlen(gCaptureMagic)+1;
+  mLastRecord = MainLoop::now();
+  return ErrorPtr();
+}
+
+
+void ApiCapture::closeFile()
+{
+  mFlushTicket.cancel();
+  if (mFile) {
+    fclose(mFile);
+    mFile = nullptr;
+  }
+}
+
+
+void ApiCapture::flush()
+{
+  mFlushTicket.cancel();
+  if (mFile) fflush(mFile);
+}
+
+
+void ApiCapture::putVarint(uint64_t aValue)
+{
+  do {
+    uint8_t b = (uint8_t)(aValue & 0x7F);
+    aValue >>= 7;
+    if (aValue) b = (uint8_t)(b | 0x80);
+    fputc(b, mFile);
+    mSize++;
+  } while (aValue);
+}
+
+
+void ApiCapture::capture(Channel aChannel, Direction aDirection, JsonObjectPtr aMessage)
+{
+  if (!mFile || !aMessage) return;
+  if (mSize>=mMaxSize) {
+    // rotate (openFile() renames the current file)
+    closeFile();
+    ErrorPtr err = openFile();
+    if (Error::notOK(err)) {
+      LOG(LOG_ERR, "API capture: cannot rotate '%s', stopping capture: %s", mCaptureFile.c_str(), err->text());
+      sEnabled = false;
+      return;
+    }
+  }
+  string msg = aMessage->json_str();
+  MLMicroSeconds now = MainLoop::now();
+  fputc(aChannel, mFile);
+  fputc(aDirection, mFile);
+  mSize += 2;
+  putVarint((uint64_t)(now-mLastRecord));
+  putVarint(msg.size());
+  fwrite(msg.data(), 1, msg.size(), mFile);
+  mSize += msg.size();
+  mLastRecord = now;
+  // do not leave records in the stdio buffer for long, but also do not flush for every record
+  if (!mFlushTicket) mFlushTicket.executeOnce(boost::bind(&ApiCapture::flush, this), API_CAPTURE_FLUSH_INTERVAL);
+}
+
+
+// MARK: - ApiReplayer
+
+ApiReplayer::ApiReplayer() :
+  mChannel(ApiCapture::p44),
+  mNextMessage(0),
+  mFast(false),
+  mStarted(Never),
+  mHeldSince(Never)
+{
+}
+
+
+static bool getVarint(const string& aData, size_t& aPos, uint64_t& aValue)
+{
+  aValue = 0;
+  int shift = 0;
+  while (aPos<aData.size() && shift<64) {
+    uint8_t b = (uint8_t)aData[aPos++];
+    aValue |= (uint64_t)(b & 0x7F)<<shift;
+    if ((b & 0x80)==0) return true;
+    shift += 7;
+  }
+  return false;
+}
+
+
+ErrorPtr ApiReplayer::load(const string aCaptureFile, ApiCapture::Channel aChannel)
+{
+  FILE* f = fopen(aCaptureFile.c_str(), "r");
+  if (!f) return SysError::errNo();
+  string data;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f))>0) data.append(buf, n);
+  fclose(f);
+  size_t pos = strlen(gCaptureMagic)+1;
+  if (data.size()<pos || data.substr(0, strlen(gCaptureMagic))!=gCaptureMagic || (uint8_t)data[pos-1]!=gCaptureVersion) {
+    return TextError::err("'%s' is not a p44mbrd API capture file", aCaptureFile.c_str());
+  }
+  mChannel = aChannel;
+  mMessages.clear();
+  std::map<string, string> capturedCallMethods; // call id -> method of the calls sent at capture time
+  MLMicroSeconds sinceLast = 0;
+  while (pos+2<=data.size()) {
+    uint8_t channel = (uint8_t)data[pos++];
+    uint8_t direction = (uint8_t)data[pos++];
+    uint64_t delta, len;
+    if (!getVarint(data, pos, delta) || !getVarint(data, pos, len) || pos+len>data.size()) {
+      OLOG(LOG_WARNING, "capture file truncated at offset %zu", pos);
+      break;
+    }
+    sinceLast += (MLMicroSeconds)delta;
+    if (channel==aChannel) {
+      JsonObjectPtr msg = JsonObject::objFromText(data.substr(pos, (size_t)len).c_str());
+      JsonObjectPtr o, m;
+      if (msg && direction==ApiCapture::sent) {
+        // remember the methods of the calls, to match the answers by method
+        if (msg->get("id", o) && msg->get("method", m)) capturedCallMethods[o->stringValue()] = m->stringValue();
+      }
+      else if (msg && direction==ApiCapture::received) {
+        ReplayMessage rm;
+        rm.mDelay = sinceLast;
+        rm.mMessage = msg;
+        if (msg->get("id", o) && !msg->get("method") && !msg->get("notification")) {
+          // answer: determine the method of the call it answers
+          if (msg->get("x-p44-method", m)) {
+            // captured with the method (when the call's id is not known at capture time)
+            rm.mAnsweredMethod = m->stringValue();
+            msg->del("x-p44-method");
+          }
+          else {
+            std::map<string, string>::iterator cpos = capturedCallMethods.find(o->stringValue());
+            if (cpos!=capturedCallMethods.end()) rm.mAnsweredMethod = cpos->second;
+          }
+          if (rm.mAnsweredMethod=="x-p44-setEncoding") {
+            // the replayer only speaks JSON, so decline the binary encoding negotiated at capture time
+            rm.mMessage = JsonObject::newObj();
+            rm.mMessage->add("id", o);
+            rm.mMessage->add("error", JsonObject::newString("replay supports JSON encoding only"));
+          }
+        }
+        mMessages.push_back(rm);
+        sinceLast = 0;
+      }
+    }
+    pos += (size_t)len;
+  }
+  OLOG(LOG_NOTICE, "loaded %zu messages to replay from '%s'", mMessages.size(), aCaptureFile.c_str());
+  return ErrorPtr();
+}
+
+
+ErrorPtr ApiReplayer::start(const string aService, bool aFast)
+{
+  mFast = aFast;
+  mServer = SocketCommPtr(new SocketComm(MainLoop::currentMainLoop()));
+  if (aService.substr(0, strlen(API_LOCAL_SOCKET_PREFIX))==API_LOCAL_SOCKET_PREFIX) {
+    string path = aService.substr(strlen(API_LOCAL_SOCKET_PREFIX));
+    unlink(path.c_str()); // remove stale socket
+    mServer->setConnectionParams(nullptr, path.c_str(), SOCK_STREAM, PF_LOCAL);
+  }
+  else {
+    mServer->setConnectionParams(nullptr, aService.c_str(), SOCK_STREAM, PF_INET);
+  }
+  OLOG(LOG_NOTICE, "fake bridge API server waiting for connection at '%s'", aService.c_str());
+  return mServer->startServer(boost::bind(&ApiReplayer::connectionHandler, this, _1), 1);
+}
+
+
+SocketCommPtr ApiReplayer::connectionHandler(SocketCommPtr aServerSocketComm)
+{
+  JsonCommPtr conn = JsonCommPtr(new JsonComm(MainLoop::currentMainLoop()));
+  // End-of-Message is 0 in the CC JsonRPC socket stream
+  if (mChannel==ApiCapture::cc) conn->setEndOfMessageChar('\x00');
+  conn->setMessageHandler(boost::bind(&ApiReplayer::messageHandler, this, _1, _2));
+  conn->setConnectionStatusHandler(boost::bind(&ApiReplayer::connectionStatusHandler, this, _2));
+  mConnection = conn;
+  mSeenCallIds.clear();
+  mUnansweredCallIds.clear();
+  mHeldSince = Never;
+  mNextMessage = 0;
+  mStarted = MainLoop::now();
+  OLOG(LOG_NOTICE, "p44mbrd connected, starting replay of %zu messages%s", mMessages.size(), mFast ? " as fast as possible" : " at original timing");
+  mReplayTicket.executeOnce(boost::bind(&ApiReplayer::sendNext, this), mFast || mMessages.empty() ? 0 : mMessages[0].mDelay);
+  return conn;
+}
+
+
+void ApiReplayer::connectionStatusHandler(ErrorPtr aStatus)
+{
+  if (Error::notOK(aStatus)) {
+    OLOG(LOG_NOTICE, "p44mbrd disconnected after replaying %zu of %zu messages: %s", mNextMessage, mMessages.size(), aStatus->text());
+    mReplayTicket.cancel();
+    mConnection.reset();
+  }
+}
+
+
+void ApiReplayer::messageHandler(ErrorPtr aError, JsonObjectPtr aJsonObject)
+{
+  JsonObjectPtr o;
+  if (Error::isOK(aError) && aJsonObject && aJsonObject->get("id", o) && aJsonObject->get("method")) {
+    // call/request from p44mbrd: answers to it may now be sent
+    mSeenCallIds.insert(o->stringValue());
+    mUnansweredCallIds[aJsonObject->get("method")->stringValue()].push_back(o);
+    // resume when waiting for a call (but not when waiting for the original gap to the next message)
+    if ((!mReplayTicket || mHeldSince!=Never) && mNextMessage<mMessages.size()) sendNext();
+  }
+}
+
+
+void ApiReplayer::sendNext()
+{
+  mReplayTicket.cancel();
+  if (!mConnection) return;
+  while (mNextMessage<mMessages.size()) {
+    ReplayMessage& rm = mMessages[mNextMessage];
+    JsonObjectPtr msg = rm.mMessage;
+    JsonObjectPtr o;
+    if (msg->get("id", o) && !msg->get("method") && !msg->get("notification")) {
+      // this is an answer: hold back until p44mbrd has sent a matching call
+      if (!releaseAnswer(rm)) {
+        MLMicroSeconds now = MainLoop::now();
+        if (mHeldSince==Never) mHeldSince = now;
+        if (now-mHeldSince<API_REPLAY_ANSWER_TIMEOUT) {
+          // messageHandler() will resume, or the timeout will skip the answer
+          mReplayTicket.executeOnce(boost::bind(&ApiReplayer::sendNext, this), mHeldSince+API_REPLAY_ANSWER_TIMEOUT-now);
+          return;
+        }
+        OLOG(LOG_WARNING,
+          "answer #%zu (id %s%s%s) was never called for by p44mbrd within %.1f seconds, skipping it",
+          mNextMessage, o->json_c_str(),
+          rm.mAnsweredMethod.empty() ? "" : ", method ", rm.mAnsweredMethod.c_str(),
+          (double)API_REPLAY_ANSWER_TIMEOUT/Second
+        );
+        mHeldSince = Never;
+        mNextMessage++;
+        continue;
+      }
+      mHeldSince = Never;
+    }
+    mConnection->sendMessage(msg);
+    mNextMessage++;
+    if (mNextMessage>=mMessages.size()) {
+      OLOG(LOG_NOTICE, "replay complete, %zu messages sent in %.3f seconds", mMessages.size(), (double)(MainLoop::now()-mStarted)/Second);
+      return;
+    }
+    if (!mFast) {
+      // schedule next message with original gap
+      mReplayTicket.executeOnce(boost::bind(&ApiReplayer::sendNext, this), mMessages[mNextMessage].mDelay);
+      return;
+    }
+  }
+}
+
+
+bool ApiReplayer::releaseAnswer(ReplayMessage& aAnswer)
+{
+  if (!aAnswer.mAnsweredMethod.empty()) {
+    // match by method and sequence
+    CallIdsMap::iterator pos = mUnansweredCallIds.find(aAnswer.mAnsweredMethod);
+    if (pos==mUnansweredCallIds.end() || pos->second.empty()) return false;
+    // answer the oldest unanswered call of that method, with its id
+    aAnswer.mMessage->add("id", pos->second.front());
+    pos->second.pop_front();
+    return true;
+  }
+  // method unknown (call not captured), fall back to matching the identical id
+  JsonObjectPtr o = aAnswer.mMessage->get("id");
+  return o && mSeenCallIds.find(o->stringValue())!=mSeenCallIds.end();
+}
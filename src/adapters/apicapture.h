@@ -0,0 +1,170 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "p44mbrd_common.h"
+
+#include "jsoncomm.hpp"
+
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace p44;
+
+#ifndef API_CAPTURE_MAX_SIZE
+  #define API_CAPTURE_MAX_SIZE (10*1024*1024) ///< default max size of a capture file before it is rotated
+#endif
+#ifndef API_CAPTURE_FLUSH_INTERVAL
+  #define API_CAPTURE_FLUSH_INTERVAL (250*MilliSecond) ///< max time captured records stay in the stdio buffer
+#endif
+#ifndef API_REPLAY_ANSWER_TIMEOUT
+  #define API_REPLAY_ANSWER_TIMEOUT (10*Second) ///< max time to hold back an answer waiting for the matching call
+#endif
+
+
+/// @brief capture of bridge API traffic into a size bounded, rotating file
+/// Every message is stored as a compact binary record: channel (one char identifying the adapter),
+/// direction, time since the previous record and message length as varints, followed by the message as
+/// JSON text. When the file exceeds the max size, it is renamed to <file>.1 (replacing an older one)
+/// and a new file is started, so the capture never uses more than twice the max size. An existing
+/// capture file is rotated the same way when capturing starts, so it does not get overwritten.
+/// Records are flushed to the file within API_CAPTURE_FLUSH_INTERVAL, so a crash loses at most the
+/// last few records. When not capturing, capture points cost a single check of a static flag.
+class ApiCapture
+{
+public:
+
+  enum Channel : uint8_t {
+    p44 = 'P', ///< P44 bridge API
+    cc = 'C' ///< CC JSON-RPC API
+  };
+
+  enum Direction : uint8_t {
+    received = 0, ///< message received from the bridge API
+    sent = 1 ///< message sent to the bridge API
+  };
+
+private:
+
+  static bool sEnabled;
+  string mCaptureFile; ///< path of the capture file
+  size_t mMaxSize; ///< max size of a capture file before rotating
+  FILE* mFile; ///< the open capture file
+  size_t mSize; ///< current size of the capture file
+  MLMicroSeconds mLastRecord; ///< time of the last record
+  MLTicket mFlushTicket; ///< for flushing the records written since the last flush
+
+public:
+
+  ApiCapture();
+  ~ApiCapture();
+
+  /// @return the shared API capture of the application
+  static ApiCapture& sharedCapture();
+
+  /// @return true when capturing
+  static inline bool enabled() { return sEnabled; }
+
+  /// @param aCaptureFile path of the capture file
+  /// @param aMaxSize max size of the capture file before it is rotated
+  void setup(const string aCaptureFile, size_t aMaxSize);
+
+  /// start or stop capturing
+  /// @param aEnable true to start capturing (into a new file), false to stop
+  void enable(bool aEnable);
+
+  /// capture a message
+  /// @param aChannel the API channel
+  /// @param aDirection direction of the message
+  /// @param aMessage the message
+  void capture(Channel aChannel, Direction aDirection, JsonObjectPtr aMessage);
+
+private:
+
+  ErrorPtr openFile();
+  void closeFile();
+  void flush();
+  void putVarint(uint64_t aValue);
+
+};
+
+
+/// @brief fake bridge API server replaying the received messages of one channel of a capture
+/// The replayer accepts a connection from a p44mbrd instance and sends it the messages that were
+/// received from the bridge API at capture time, at original timing (gaps between messages) or as fast
+/// as possible. Answers to calls are held back until the p44mbrd instance has sent a matching call,
+/// so the replay stays in sync with the instance's own requests. As call ids of the instance differ
+/// from those at capture time, answers are matched by method and sequence: the n-th answer to a method
+/// answers the n-th unanswered call of that method, and gets that call's id. Answers to calls not found
+/// in the capture fall back to matching by identical id. Answers that cannot be released within
+/// API_REPLAY_ANSWER_TIMEOUT are logged and skipped.
+class ApiReplayer : public P44LoggingObj
+{
+  typedef P44LoggingObj inherited;
+
+  typedef struct {
+    MLMicroSeconds mDelay; ///< time since the previous message of the channel at capture time
+    JsonObjectPtr mMessage; ///< the message
+    string mAnsweredMethod; ///< for answers: the method of the answered call, empty if unknown
+  } ReplayMessage;
+  std::vector<ReplayMessage> mMessages; ///< messages to replay
+  ApiCapture::Channel mChannel; ///< the channel being replayed
+  size_t mNextMessage; ///< index of the next message to send
+  bool mFast; ///< if set, replay as fast as possible
+  SocketCommPtr mServer; ///< the server socket
+  JsonCommPtr mConnection; ///< the connection to the p44mbrd instance
+  std::set<string> mSeenCallIds; ///< ids of calls/requests received from the p44mbrd instance
+  typedef std::map<string, std::list<JsonObjectPtr> > CallIdsMap;
+  CallIdsMap mUnansweredCallIds; ///< ids of not yet answered calls/requests from the p44mbrd instance, per method
+  MLMicroSeconds mHeldSince; ///< since when the next message (an answer) is held back, Never if not held
+  MLTicket mReplayTicket; ///< for sending the next message
+  MLMicroSeconds mStarted; ///< when replaying started
+
+public:
+
+  ApiReplayer();
+
+  virtual string logContextPrefix() override { return "API replay"; }
+
+  /// load the messages to replay
+  /// @param aCaptureFile the capture file
+  /// @param aChannel the channel (adapter) to replay
+  ErrorPtr load(const string aCaptureFile, ApiCapture::Channel aChannel);
+
+  /// start the fake bridge API server
+  /// @param aService port number, or API_LOCAL_SOCKET_PREFIX followed by a socket path
+  /// @param aFast if set, replay as fast as possible instead of with original timing
+  ErrorPtr start(const string aService, bool aFast);
+
+private:
+
+  SocketCommPtr connectionHandler(SocketCommPtr aServerSocketComm);
+  void connectionStatusHandler(ErrorPtr aStatus);
+  void messageHandler(ErrorPtr aError, JsonObjectPtr aJsonObject);
+  void sendNext();
+  bool releaseAnswer(ReplayMessage& aAnswer);
+
+};
@@ -0,0 +1,74 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "apisocket.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace p44;
+
+static int gAllowedPeerUid = -1;
+
+
+void setApiConnectionParams(SocketComm& aSocket, const string aApiHost, const string aApiService)
+{
+  if (aApiHost.substr(0, strlen(API_LOCAL_SOCKET_PREFIX))==API_LOCAL_SOCKET_PREFIX) {
+    // local socket, path is passed as service
+    string path = aApiHost.substr(strlen(API_LOCAL_SOCKET_PREFIX));
+    LOG(LOG_INFO, "bridge API via local socket '%s'", path.c_str());
+    aSocket.setConnectionParams(nullptr, path.c_str(), SOCK_STREAM, PF_LOCAL);
+  }
+  else {
+    aSocket.setConnectionParams(aApiHost.c_str(), aApiService.c_str(), SOCK_STREAM);
+  }
+}
+
+
+void setApiAllowedPeerUid(int aUid)
+{
+  gAllowedPeerUid = aUid;
+}
+
+
+ErrorPtr checkApiPeerCredentials(SocketComm& aSocket)
+{
+  int fd = aSocket.getFd();
+  struct sockaddr_storage sa;
+  socklen_t salen = sizeof(sa);
+  if (fd<0 || getsockname(fd, (struct sockaddr*)&sa, &salen)!=0 || sa.ss_family!=AF_UNIX) {
+    return ErrorPtr(); // not a local socket, nothing to check
+  }
+  #ifdef SO_PEERCRED
+  struct ucred cred;
+  socklen_t credlen = sizeof(cred);
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen)!=0) {
+    return SysError::errNo("cannot get local socket peer credentials: ");
+  }
+  if (cred.uid!=0 && cred.uid!=geteuid() && (gAllowedPeerUid<0 || cred.uid!=static_cast<uid_t>(gAllowedPeerUid))) {
+    return TextError::err("local socket peer (pid=%d) runs as uid %d, which is not allowed", (int)cred.pid, (int)cred.uid);
+  }
+  LOG(LOG_INFO, "local socket peer credentials ok: pid=%d, uid=%d", (int)cred.pid, (int)cred.uid);
+  #endif // SO_PEERCRED
+  return ErrorPtr();
+}
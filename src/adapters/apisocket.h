@@ -0,0 +1,51 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "p44mbrd_common.h"
+
+#include "socketcomm.hpp"
+
+using namespace p44;
+
+#ifndef API_LOCAL_SOCKET_PREFIX
+  #define API_LOCAL_SOCKET_PREFIX "unix:" ///< API host prefix selecting a local (unix domain) socket, followed by the socket path
+#endif
+
+/// @brief set up connection parameters for a bridge API connection
+/// @param aSocket the socket to set up
+/// @param aApiHost host name or address, or API_LOCAL_SOCKET_PREFIX followed by a socket path
+///   to connect to a co-located bridge backend via a local socket
+/// @param aApiService port number or service name (not used for local sockets)
+void setApiConnectionParams(SocketComm& aSocket, const string aApiHost, const string aApiService);
+
+/// @brief set the user id, in addition to root and our own user id, a local socket peer may run as
+/// @param aUid the allowed user id, -1 for none
+void setApiAllowedPeerUid(int aUid);
+
+/// @brief check the credentials of the peer of a connected bridge API socket
+/// @param aSocket the connected socket
+/// @return Ok if the connection is not via a local socket, or the peer's user id is allowed.
+///   Error if the peer is not allowed or its credentials cannot be obtained.
+ErrorPtr checkApiPeerCredentials(SocketComm& aSocket);
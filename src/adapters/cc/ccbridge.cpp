@@ -26,6 +26,11 @@
 #if CC_ADAPTERS
 
 #include "ccdevices.h"
+#include "adapters/apisocket.h"
+#include "stalldetector.h"
+#include "eventtrace.h"
+
+#include <algorithm>
 
 using namespace p44;
 
@@ -52,11 +57,21 @@ CC_BridgeImpl& CC_BridgeImpl::adapter()
 
 void CC_BridgeImpl::startup()
 {
+  if (isSharded()) {
+    // each shard is a separate matter bridge, so it needs a distinct identity
+    mUID += string_format("-shard%d", shardIndex());
+    mSerial += string_format("-shard%d", shardIndex());
+  }
   // start the socket connection
   // - install connection status callback
   mJsonRpcAPI.setConnectionStatusHandler(boost::bind(&CC_BridgeImpl::jsonRpcConnectionStatusHandler, this, _2));
-  // - initiate the connection
-  jsonRpcConnectionOpen();
+  // - let supervisor initiate (and later re-initiate) the connection
+  mSupervisor.setHandlers(
+    boost::bind(&CC_BridgeImpl::jsonRpcConnectionOpen, this),
+    boost::bind(&CC_BridgeImpl::probe, this, _1),
+    boost::bind(&CC_BridgeImpl::jsonRpcConnectionLost, this, _1)
+  );
+  mSupervisor.connect();
 }
 
 
@@ -74,7 +89,7 @@ void CC_BridgeImpl::reportCommissionable(bool aIsCommissionable)
       result->add ("qrcode", JsonObject::newString (QRCodeData));
       result->add ("pairingcode", JsonObject::newString (ManualPairingCode));
     }
-  mJsonRpcAPI.sendRequest("matter_commissionable_status", result, NULL);
+  sendRequest("matter_commissionable_status", result, NULL, OutgoingQueue::sync);
 }
 
 
@@ -101,16 +116,218 @@ void CC_BridgeImpl::setBridgeRunning(bool aRunning)
 
 void CC_BridgeImpl::cleanup()
 {
+  mArrivingItemsTicket.cancel();
+  mArrivingItems.clear();
+  failPendingRequests("CC adapter shutting down");
   // TODO: maybe other cleanup required before or after closing connection
+  mSupervisor.stop();
+  mDispatchQueue.clear();
   mJsonRpcAPI.closeConnection();
   inherited::cleanup();
 }
 
 
+// MARK: outgoing requests
+
+void CC_BridgeImpl::sendRequest(const string aMethod, JsonObjectPtr aParams, JsonRpcResponseCB aResponseCB, OutgoingQueue::Priority aPriority)
+{
+  StatusCB discardedCB;
+  if (aResponseCB) discardedCB = boost::bind(&CC_BridgeImpl::requestDiscarded, this, aMethod, aResponseCB, _1);
+  if (!mOutgoingQueue.send(aPriority, boost::bind(&CC_BridgeImpl::sendQueuedRequest, this, aMethod, aParams, aResponseCB), "", discardedCB)) {
+    OLOG(LOG_ERR, "outgoing queue full, request '%s' dropped", aMethod.c_str());
+    if (aResponseCB) {
+      ErrorPtr err = TextError::err("outgoing queue full");
+      aResponseCB(0, err, JsonObjectPtr());
+    }
+  }
+}
+
+
+void CC_BridgeImpl::requestDiscarded(const string aMethod, JsonRpcResponseCB aResponseCB, ErrorPtr aReason)
+{
+  OLOG(LOG_INFO, "request '%s' not sent: %s", aMethod.c_str(), Error::text(aReason));
+  aResponseCB(0, aReason, JsonObjectPtr());
+}
+
+
+bool CC_BridgeImpl::canSend()
+{
+  return mRequestsInFlight.size()<CC_MAX_REQUESTS_IN_FLIGHT;
+}
+
+
+void CC_BridgeImpl::sendQueuedRequest(const string aMethod, JsonObjectPtr aParams, JsonRpcResponseCB aResponseCB)
+{
+  TRACE_EVENT("bridge", "request", aMethod);
+  if (!aResponseCB) {
+    // notification, no answer expected
+    apiRequest(aMethod, aParams, aResponseCB);
+    return;
+  }
+  PendingRequest r;
+  r.mSerial = ++mRequestSerial;
+  r.mMethod = aMethod;
+  r.mResponseCB = aResponseCB;
+  mRequestsInFlight.push_back(r);
+  ErrorPtr err = apiRequest(aMethod, aParams, boost::bind(&CC_BridgeImpl::requestAnswered, this, r.mSerial, _1, _2, _3));
+  if (Error::notOK(err)) {
+    OLOG(LOG_ERR, "sending request '%s' failed: %s", aMethod.c_str(), err->text());
+    requestAnswered(r.mSerial, 0, err, JsonObjectPtr());
+  }
+}
+
+
+void CC_BridgeImpl::requestAnswered(long aSerial, int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData)
+{
+  PendingRequestsList::iterator pos = mRequestsInFlight.begin();
+  while (pos!=mRequestsInFlight.end() && pos->mSerial!=aSerial) ++pos;
+  if (pos==mRequestsInFlight.end()) {
+    // request was already called back with an error when the connection was lost
+    OLOG(LOG_INFO, "ignoring late answer to a request given up before: %s", Error::text(aError));
+    return;
+  }
+  PendingRequest r = *pos;
+  mRequestsInFlight.erase(pos);
+  MLMicroSeconds start = MainLoop::now();
+  TRACE_SPAN("bridge", "answer", r.mMethod);
+  // peer has capacity for another request now
+  mOutgoingQueue.resume();
+  r.mResponseCB(aResponseId, aError, aResultOrErrorData);
+  MLMicroSeconds stall = StallDetector::sharedDetector().handled(start);
+  if (stall) StallDetector::sharedDetector().stalled(stall, "answer to '" + r.mMethod + "'", "");
+}
+
+
+void CC_BridgeImpl::failPendingRequests(const char* aReason)
+{
+  // requests collected for a burst
+  mBurstTicket.cancel();
+  BurstRequestsList burstRequests;
+  burstRequests.swap(mBurstRequests);
+  for (BurstRequestsList::iterator pos = burstRequests.begin(); pos!=burstRequests.end(); ++pos) {
+    if (!pos->mResponseCB) continue;
+    ErrorPtr err = TextError::err("%s, request '%s' not sent", aReason, pos->mMethod.c_str());
+    pos->mResponseCB(0, err, JsonObjectPtr());
+  }
+  // queued requests
+  mOutgoingQueue.clear(TextError::err("%s, queued request discarded", aReason));
+  // requests sent, answers will never arrive
+  // Note: fail only those in flight now, callbacks might send new requests
+  if (!mRequestsInFlight.empty()) {
+    OLOG(LOG_WARNING, "failing %zu unanswered requests", mRequestsInFlight.size());
+    PendingRequestsList lostRequests = mRequestsInFlight; // copy, requestAnswered() removes the entries
+    for (PendingRequestsList::iterator pos = lostRequests.begin(); pos!=lostRequests.end(); ++pos) {
+      ErrorPtr err = TextError::err("%s, no answer to request '%s'", aReason, pos->mMethod.c_str());
+      requestAnswered(pos->mSerial, 0, err, JsonObjectPtr());
+    }
+  }
+}
+
+
+// MARK: API access with capture
+
+ErrorPtr CC_BridgeImpl::apiRequest(const string aMethod, JsonObjectPtr aParams, JsonRpcResponseCB aResponseCB)
+{
+  if (ApiCapture::enabled()) {
+    captureRpcMessage(ApiCapture::sent, aMethod.c_str(), JsonObjectPtr(), aParams, JsonObjectPtr(), JsonObjectPtr());
+    if (aResponseCB) aResponseCB = boost::bind(&CC_BridgeImpl::capturedAnswer, this, aMethod, aResponseCB, _1, _2, _3);
+  }
+  return mJsonRpcAPI.sendRequest(aMethod.c_str(), aParams, aResponseCB);
+}
+
+
+void CC_BridgeImpl::capturedAnswer(const string aMethod, JsonRpcResponseCB aResponseCB, int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData)
+{
+  // only answers actually received from the API count, not local errors such as timeouts
+  if (ApiCapture::enabled() && (Error::isOK(aError) || aError->isDomain(JsonRpcError::domain()))) {
+    JsonObjectPtr err;
+    if (Error::notOK(aError)) {
+      err = JsonObject::newObj();
+      err->add("code", JsonObject::newInt32((int32_t)aError->getErrorCode()));
+      err->add("message", JsonObject::newString(aError->getErrorMessage()));
+      if (aResultOrErrorData) err->add("data", aResultOrErrorData);
+    }
+    // Note: the request's id is not known at capture time, so record the method with the answer for replay
+    captureRpcMessage(ApiCapture::received, nullptr, JsonObject::newInt32(aResponseId), JsonObjectPtr(), Error::isOK(aError) ? aResultOrErrorData : JsonObjectPtr(), err, aMethod.c_str());
+  }
+  aResponseCB(aResponseId, aError, aResultOrErrorData);
+}
+
+
+void CC_BridgeImpl::sendApiResult(const JsonObjectPtr aJsonRpcId, JsonObjectPtr aResult)
+{
+  if (ApiCapture::enabled()) captureRpcMessage(ApiCapture::sent, nullptr, aJsonRpcId, JsonObjectPtr(), aResult, JsonObjectPtr());
+  mJsonRpcAPI.sendResult(aJsonRpcId, aResult);
+}
+
+
+void CC_BridgeImpl::sendApiError(const JsonObjectPtr aJsonRpcId, int32_t aErrorCode, const char* aErrorMessage)
+{
+  if (ApiCapture::enabled()) {
+    JsonObjectPtr err = JsonObject::newObj();
+    err->add("code", JsonObject::newInt32(aErrorCode));
+    err->add("message", JsonObject::newString(aErrorMessage));
+    captureRpcMessage(ApiCapture::sent, nullptr, aJsonRpcId, JsonObjectPtr(), JsonObjectPtr(), err);
+  }
+  mJsonRpcAPI.sendError(aJsonRpcId, aErrorCode, aErrorMessage);
+}
+
+
+void CC_BridgeImpl::captureRpcMessage(ApiCapture::Direction aDirection, const char* aMethod, const JsonObjectPtr aJsonRpcId, JsonObjectPtr aParams, JsonObjectPtr aResult, JsonObjectPtr aError, const char* aAnsweredMethod)
+{
+  // JsonRpcComm does not expose the messages as sent/received, so reconstruct them
+  JsonObjectPtr msg = JsonObject::newObj();
+  msg->add("jsonrpc", JsonObject::newString("2.0"));
+  if (aMethod) msg->add("method", JsonObject::newString(aMethod));
+  if (aParams) msg->add("params", aParams);
+  if (aResult) msg->add("result", aResult);
+  if (aError) msg->add("error", aError);
+  if (aJsonRpcId) msg->add("id", aJsonRpcId);
+  if (aAnsweredMethod) msg->add("x-p44-method", JsonObject::newString(aAnsweredMethod)); // removed again by the replayer
+  ApiCapture::sharedCapture().capture(ApiCapture::cc, aDirection, msg);
+}
+
+
+// MARK: burst requests
+
+void CC_BridgeImpl::sendRequestInBurst(const string aMethod, JsonObjectPtr aParams, JsonRpcResponseCB aResponseCB)
+{
+  BurstRequest r;
+  r.mMethod = aMethod;
+  r.mParams = aParams;
+  r.mResponseCB = aResponseCB;
+  mBurstRequests.push_back(r);
+  if (!mBurstTicket) {
+    mBurstTicket.executeOnce(boost::bind(&CC_BridgeImpl::sendBurst, this), CC_COMMAND_BURST_WINDOW);
+  }
+}
+
+
+void CC_BridgeImpl::sendBurst()
+{
+  mBurstTicket.cancel();
+  if (mBurstRequests.size()>1) {
+    OLOG(LOG_INFO, "sending burst of %zu requests", mBurstRequests.size());
+  }
+  while (!mBurstRequests.empty()) {
+    BurstRequest& r = mBurstRequests.front();
+    sendRequest(r.mMethod, r.mParams, r.mResponseCB);
+    mBurstRequests.pop_front();
+  }
+}
+
+
 // MARK: CC_BridgeImpl internals
 
-CC_BridgeImpl::CC_BridgeImpl()
+CC_BridgeImpl::CC_BridgeImpl() :
+  mSupervisor("CC API"),
+  mDispatchQueue("CC API"),
+  mOutgoingQueue("CC API"),
+  mRequestSerial(0),
+  mPendingItemQueries(0)
 {
+  mOutgoingQueue.setMaxQueued(CC_MAX_QUEUED_REQUESTS);
+  mOutgoingQueue.setFlowControl(boost::bind(&CC_BridgeImpl::canSend, this));
   // Note: isMemberVariable() MUST be called on P44Obj based objects that are instantiated
   //   as C++ member variables (instead of allocated via new and managed by refcount),
   //   preferably in the ctor of the containing object (= here).
@@ -123,7 +340,7 @@ void CC_BridgeImpl::setAPIParams(const string aApiHost, const string aApiService
   // End-of-Message is 0 in the CC JsonRPC socket stream
   mJsonRpcAPI.setEndOfMessageChar('\x00');
   // set up connection parameters
-  mJsonRpcAPI.setConnectionParams(aApiHost.c_str(), aApiService.c_str(), SOCK_STREAM);
+  setApiConnectionParams(mJsonRpcAPI, aApiHost, aApiService);
   // install method/notification request handler
   mJsonRpcAPI.setRequestHandler(boost::bind(&CC_BridgeImpl::jsonRpcRequestHandler, this, _1, _2, _3));
 }
@@ -138,9 +355,17 @@ void CC_BridgeImpl::jsonRpcConnectionOpen()
 
 void CC_BridgeImpl::jsonRpcConnectionStatusHandler(ErrorPtr aStatus)
 {
+  if (Error::isOK(aStatus)) {
+    aStatus = checkApiPeerCredentials(mJsonRpcAPI);
+    if (Error::notOK(aStatus)) {
+      OLOG(LOG_ERR, "rejecting connection: %s", aStatus->text());
+      mJsonRpcAPI.closeConnection();
+    }
+  }
   if (Error::isOK(aStatus)) {
     // connection established ok
-    mApiRetryTicket.cancel();
+    mSupervisor.connectionEstablished();
+    updateAllDevicesReachability(true); // restore reachability of devices (if any) after reconnect
 
     // initiate stuff, in particular:
     // - query the API to discover devices that need to be bridged
@@ -160,16 +385,44 @@ void CC_BridgeImpl::jsonRpcConnectionStatusHandler(ErrorPtr aStatus)
     // {"jsonrpc":"2.0","id":"26", "method":"deviced_get_group_names","params":{"room_id":1}}
     JsonObjectPtr params = JsonObject::newObj();
     params->add("name", JsonObject::newString("p44mbrd"));
-    mJsonRpcAPI.sendRequest("rpc_client_register", params, boost::bind(&CC_BridgeImpl::client_registered, this, _1, _2, _3));
+    apiRequest("rpc_client_register", params, boost::bind(&CC_BridgeImpl::client_registered, this, _1, _2, _3));
     // processing will continue at client_registered via callback
     return;
   }
   else {
-    // connection error
-    OLOG(LOG_WARNING, "JSON RPC API connection failed: %s", aStatus->text());
-    // TODO: better recovery
-    // for now: just retry connecting in 10 seconds
-    mApiRetryTicket.executeOnce(boost::bind(&CC_BridgeImpl::jsonRpcConnectionOpen, this), 10*Second);
+    // connection error, supervisor will retry with backoff
+    mSupervisor.connectionFailed(aStatus);
+  }
+}
+
+
+void CC_BridgeImpl::jsonRpcConnectionLost(ErrorPtr aError)
+{
+  OLOG(LOG_WARNING, "JSON RPC API connection lost: %s", aError->text());
+  // make sure connection is closed (peer might just be stalled)
+  mJsonRpcAPI.closeConnection();
+  // answers will never arrive, queued requests are outdated
+  failPendingRequests("JSON RPC API connection lost");
+  // all devices are unreachable now
+  updateAllDevicesReachability(false);
+}
+
+
+void CC_BridgeImpl::probe(StatusCB aProbeResultCB)
+{
+  // Note: any answer, even a "method not found" error, proves the peer is alive
+  ErrorPtr err = apiRequest("rpc_ping", JsonObjectPtr(), boost::bind(&CC_BridgeImpl::probeAnswer, this, aProbeResultCB, _1, _2, _3));
+  if (Error::notOK(err)) {
+    OLOG(LOG_WARNING, "cannot send probe: %s", err->text());
+  }
+}
+
+
+void CC_BridgeImpl::probeAnswer(StatusCB aProbeResultCB, int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData)
+{
+  // only answers actually received from the peer count, not local errors such as timeouts or a full queue
+  if (Error::isOK(aError) || aError->isDomain(JsonRpcError::domain())) {
+    if (aProbeResultCB) aProbeResultCB(aError);
   }
 }
 
@@ -183,7 +436,7 @@ void CC_BridgeImpl::client_registered(int32_t aResponseId, ErrorPtr &aStatus, Js
 
     JsonObjectPtr params = JsonObject::newObj();
     params->add("pattern", JsonObject::newString("deviced.item_(config|state|vitals)_changed"));
-    mJsonRpcAPI.sendRequest("rpc_client_subscribe", params, boost::bind(&CC_BridgeImpl::client_subscribed, this, _1, _2, _3));
+    apiRequest("rpc_client_subscribe", params, boost::bind(&CC_BridgeImpl::client_subscribed, this, _1, _2, _3));
     return;
   }
   OLOG(LOG_ERR, "error from rpc_client_subscribe: %s", aStatus->text());
@@ -201,7 +454,7 @@ void CC_BridgeImpl::client_subscribed(int32_t aResponseId, ErrorPtr &aStatus, Js
 
     JsonObjectPtr params = JsonObject::newObj();
     params->add("verbose", JsonObject::newBool (true));
-    mJsonRpcAPI.sendRequest("deviced.deviced_get_items_info", params, boost::bind(&CC_BridgeImpl::deviceListReceived, this, _1, _2, _3));
+    apiRequest("deviced.deviced_get_items_info", params, boost::bind(&CC_BridgeImpl::deviceListReceived, this, _1, _2, _3));
     return;
   }
   OLOG(LOG_ERR, "error from deviced_get_group_names: %s", aStatus->text());
@@ -229,6 +482,13 @@ void CC_BridgeImpl::createDeviceForData(JsonObjectPtr item,
   if (item->getCString ("backend") == NULL)
     return;
 
+  /* ignore items bridged by another shard */
+  if (!isInShard (CC_DeviceImpl::uid_string (item_id->int32Value())))
+    {
+      OLOG (LOG_INFO, "... belongs to another shard, not bridged by this instance");
+      return;
+    }
+
   device_type = item->getCString ("device_type");
   feedback = item->get("feedback") ? item->get("feedback")->boolValue() : false;
 
@@ -310,9 +570,10 @@ void CC_BridgeImpl::deviceListReceived(int32_t aResponseId, ErrorPtr &aStatus, J
     if (ilist && ilist->arrayLength() > 0) {
       int i;
 
+      /* process in chunks, giving the mainloop a chance to do other things in between */
       for (i = 0; i < ilist->arrayLength(); i++)
       {
-        createDeviceForData (ilist->arrayGet (i), true);
+        mBulkWork.dispatch (boost::bind (&CC_BridgeImpl::createDeviceForData, this, ilist->arrayGet (i), true));
       }
     }
   }
@@ -327,24 +588,97 @@ void CC_BridgeImpl::deviceListReceived(int32_t aResponseId, ErrorPtr &aStatus, J
   params->add("code", JsonObject::newInt32 (0));
   params->add("message", JsonObject::newString ("p44mbrd startup done"));
 
-  mJsonRpcAPI.sendRequest("systemd.log_entry_dump", params, boost::bind(&CC_BridgeImpl::ignoreLogResponse, this, _1, _2, _3));
+  sendRequest("systemd.log_entry_dump", params, boost::bind(&CC_BridgeImpl::ignoreLogResponse, this, _1, _2, _3), OutgoingQueue::diagnostics);
 
-  // Assume discovery done at this point, so report back to main app
-  startupComplete(aStatus);
+  // Assume discovery done when all items are processed, so report back to main app then
+  mBulkWork.dispatch(boost::bind(&CC_BridgeImpl::startupComplete, this, aStatus));
 }
 
 
-void CC_BridgeImpl::itemInfoReceived(int32_t aResponseId, ErrorPtr &aStatus, JsonObjectPtr aResultOrErrorData)
+// MARK: arriving items
+
+void CC_BridgeImpl::itemCreated(int aItemId)
 {
-  if (Error::isOK(aStatus)) {
-    // request ok
+  // collect items created in bulk (e.g. after a bus scan) to query their info in one call
+  for (ItemIdsList::iterator pos = mArrivingItems.begin(); pos!=mArrivingItems.end(); ++pos) {
+    if (*pos==aItemId) return; // already waiting for query
+  }
+  mArrivingItems.push_back(aItemId);
+  if (!mArrivingItemsTicket) {
+    mArrivingItemsTicket.executeOnce(boost::bind(&CC_BridgeImpl::queryArrivingItems, this), CC_DEVICE_ARRIVAL_WINDOW);
+  }
+}
 
-    // we have an item info object of the device to be bridged here:
 
-    createDeviceForData (aResultOrErrorData, false);
+void CC_BridgeImpl::queryArrivingItems()
+{
+  mArrivingItemsTicket.cancel();
+  if (mArrivingItems.empty()) return;
+  // The CC API cannot query specific items in one call, only all items' info. On a large installation,
+  // that is more expensive than querying a few items one by one.
+  size_t numKnown = mDeviceUIDMap.size();
+  if (mArrivingItems.size()<CC_BULK_QUERY_MIN_ITEMS || mArrivingItems.size()<CC_BULK_QUERY_MIN_FRACTION*(double)(numKnown+mArrivingItems.size())) {
+    // few items: query them one by one, but bridge them together when all are answered
+    if (mArrivingItems.size()>1) OLOG(LOG_INFO, "%zu items created, querying their info one by one", mArrivingItems.size());
+    if (!mQueriedItems) mQueriedItems = JsonObject::newArray();
+    for (ItemIdsList::iterator pos = mArrivingItems.begin(); pos!=mArrivingItems.end(); ++pos) {
+      JsonObjectPtr params = JsonObject::newObj();
+      params->add("item_id", JsonObject::newInt32(*pos));
+      mPendingItemQueries++;
+      sendRequest("deviced.item_get_info", params, boost::bind(&CC_BridgeImpl::arrivingItemInfoReceived, this, _1, _2, _3), OutgoingQueue::sync);
+    }
+  }
+  else {
+    // many items: get all items' info and pick the created ones
+    OLOG(LOG_NOTICE, "%zu items created (%zu known), querying all items' info in one call", mArrivingItems.size(), numKnown);
+    JsonObjectPtr params = JsonObject::newObj();
+    params->add("verbose", JsonObject::newBool(true));
+    sendRequest("deviced.deviced_get_items_info", params, boost::bind(&CC_BridgeImpl::arrivingItemsInfoReceived, this, mArrivingItems, _1, _2, _3), OutgoingQueue::sync);
+  }
+  mArrivingItems.clear();
+}
+
+
+void CC_BridgeImpl::arrivingItemInfoReceived(int32_t aResponseId, ErrorPtr &aStatus, JsonObjectPtr aResultOrErrorData)
+{
+  if (mPendingItemQueries>0) mPendingItemQueries--;
+  if (Error::isOK(aStatus)) {
+    if (aResultOrErrorData && mQueriedItems) mQueriedItems->arrayAppend(aResultOrErrorData);
   }
   else {
-    OLOG(LOG_ERR, "error from item_get_info: %s", aStatus->text());
+    OLOG(LOG_ERR, "error from item_get_info for created item: %s", aStatus->text());
+  }
+  if (mPendingItemQueries>0) return; // more answers to come
+  JsonObjectPtr items = mQueriedItems;
+  mQueriedItems.reset();
+  if (items) bridgeArrivingItems(items, nullptr);
+}
+
+
+void CC_BridgeImpl::arrivingItemsInfoReceived(ItemIdsList aItemIds, int32_t aResponseId, ErrorPtr &aStatus, JsonObjectPtr aResultOrErrorData)
+{
+  if (Error::notOK(aStatus)) {
+    OLOG(LOG_ERR, "error from deviced_get_items_info for created items: %s", aStatus->text());
+    return;
+  }
+  JsonObjectPtr ilist = aResultOrErrorData->get("item_list");
+  if (!ilist) return;
+  bridgeArrivingItems(ilist, &aItemIds);
+}
+
+
+void CC_BridgeImpl::bridgeArrivingItems(JsonObjectPtr aItemInfos, ItemIdsList* aItemIdsP)
+{
+  for (int i = 0; i<aItemInfos->arrayLength(); i++) {
+    JsonObjectPtr item = aItemInfos->arrayGet(i);
+    JsonObjectPtr o = item->get("id");
+    if (!o) continue;
+    int item_id = o->int32Value();
+    if (aItemIdsP && std::find(aItemIdsP->begin(), aItemIdsP->end(), item_id)==aItemIdsP->end()) continue; // not one of the created items
+    // Note: all devices bridged from this call stack get installed together
+    if (mDeviceUIDMap.find(CC_DeviceImpl::uid_string(item_id))==mDeviceUIDMap.end()) {
+      createDeviceForData(item, false);
+    }
   }
 }
 
@@ -361,6 +695,30 @@ void CC_BridgeImpl::ignoreLogResponse(int32_t aResponseId, ErrorPtr &aStatus, Js
 
 
 void CC_BridgeImpl::jsonRpcRequestHandler(const char *aMethod, const JsonObjectPtr aJsonRpcId, JsonObjectPtr aParams)
+{
+  mSupervisor.activity();
+  mTrafficMeter.received(aParams);
+  if (ApiCapture::enabled()) captureRpcMessage(ApiCapture::received, aMethod, aJsonRpcId, aParams, JsonObjectPtr(), JsonObjectPtr());
+  // Note: aMethod is only valid during this call, so pass a copy
+  mDispatchQueue.dispatch(boost::bind(&CC_BridgeImpl::meteredRequest, this, string(aMethod), aJsonRpcId, aParams));
+}
+
+
+void CC_BridgeImpl::meteredRequest(const string aMethod, const JsonObjectPtr aJsonRpcId, JsonObjectPtr aParams)
+{
+  MLMicroSeconds start = MainLoop::now();
+  TRACE_SPAN("bridge", "request received", aMethod);
+  processRequest(aMethod, aJsonRpcId, aParams);
+  mTrafficMeter.processed(MainLoop::now()-start);
+  MLMicroSeconds stall = StallDetector::sharedDetector().handled(start);
+  if (stall) {
+    JsonObjectPtr o;
+    StallDetector::sharedDetector().stalled(stall, "request '" + aMethod + "'", aParams && aParams->get("item_id", o) ? "item_id " + o->stringValue() : "");
+  }
+}
+
+
+void CC_BridgeImpl::processRequest(const string aMethod, const JsonObjectPtr aJsonRpcId, JsonObjectPtr aParams)
 {
   // JSON RPC request/notification coming FROM bridge
 
@@ -368,8 +726,8 @@ void CC_BridgeImpl::jsonRpcRequestHandler(const char *aMethod, const JsonObjectP
 
   if (!aJsonRpcId)
     {
-      OLOG (LOG_NOTICE, "Notification %s received: %s", aMethod, JsonObject::text(aParams));
-      if (strcmp ("deviced.item_config_changed", aMethod) == 0)
+      OLOG (LOG_NOTICE, "Notification %s received: %s", aMethod.c_str(), JsonObject::text(aParams));
+      if (strcmp ("deviced.item_config_changed", aMethod.c_str()) == 0)
         {
           // find device
           JsonObjectPtr o;
@@ -383,7 +741,7 @@ void CC_BridgeImpl::jsonRpcRequestHandler(const char *aMethod, const JsonObjectP
             }
           }
         }
-      else if (strcmp ("deviced.item_state_changed", aMethod) == 0)
+      else if (strcmp ("deviced.item_state_changed", aMethod.c_str()) == 0)
         {
           // find device
           JsonObjectPtr o;
@@ -397,7 +755,7 @@ void CC_BridgeImpl::jsonRpcRequestHandler(const char *aMethod, const JsonObjectP
             }
           }
         }
-      else if (strcmp ("deviced.item_vitals_changed", aMethod) == 0)
+      else if (strcmp ("deviced.item_vitals_changed", aMethod.c_str()) == 0)
         {
           // determine what happened
           JsonObjectPtr o1, o2;
@@ -412,9 +770,7 @@ void CC_BridgeImpl::jsonRpcRequestHandler(const char *aMethod, const JsonObjectP
               if (dev!=mDeviceUIDMap.end())
                 return;
 
-              JsonObjectPtr params = JsonObject::newObj();
-              params->add("item_id", JsonObject::newInt32 (o2->int32Value()));
-              mJsonRpcAPI.sendRequest("deviced.item_get_info", params, boost::bind(&CC_BridgeImpl::itemInfoReceived, this, _1, _2, _3));
+              itemCreated(item_id);
             }
             else if (strcmp (o1->c_strValue(), "deleted") == 0)
             {
@@ -443,7 +799,7 @@ void CC_BridgeImpl::jsonRpcRequestHandler(const char *aMethod, const JsonObjectP
 
       return;
     }
-  else if (strcmp ("matter_set_commissionable", aMethod) == 0)
+  else if (strcmp ("matter_set_commissionable", aMethod.c_str()) == 0)
     {
       JsonObjectPtr o;
 
@@ -454,16 +810,16 @@ void CC_BridgeImpl::jsonRpcRequestHandler(const char *aMethod, const JsonObjectP
         {
           bool commissionable = o->boolValue ();
           requestCommissioning (commissionable);
-          mJsonRpcAPI.sendResult(aJsonRpcId, JsonObject::objFromText ("{\"success\": 1}"));
+          sendApiResult(aJsonRpcId, JsonObject::objFromText ("{\"success\": 1}"));
         }
       else
         {
-          mJsonRpcAPI.sendError(aJsonRpcId, JsonRpcError::InvalidParams, "mandatory boolean parameter \"commissionable\" wrong or missing.");
+          sendApiError(aJsonRpcId, JsonRpcError::InvalidParams, "mandatory boolean parameter \"commissionable\" wrong or missing.");
         }
 
       return;
     }
-  else if (strcmp ("matter_get_commissionable", aMethod) == 0)
+  else if (strcmp ("matter_get_commissionable", aMethod.c_str()) == 0)
     {
       JsonObjectPtr result = JsonObject::newObj();
 
@@ -474,10 +830,10 @@ void CC_BridgeImpl::jsonRpcRequestHandler(const char *aMethod, const JsonObjectP
           result->add ("qrcode", JsonObject::newString (QRCodeData));
           result->add ("pairingcode", JsonObject::newString (ManualPairingCode));
         }
-      mJsonRpcAPI.sendResult(aJsonRpcId, result);
+      sendApiResult(aJsonRpcId, result);
       return;
     }
-  else if (strcmp ("matter_reset_credentials", aMethod) == 0)
+  else if (strcmp ("matter_reset_credentials", aMethod.c_str()) == 0)
     {
       JsonObjectPtr o;
 
@@ -489,20 +845,53 @@ void CC_BridgeImpl::jsonRpcRequestHandler(const char *aMethod, const JsonObjectP
         {
           int exitcode = 5;  // special case handling in the shell envelope script: remove KVS file.
 
-          mJsonRpcAPI.sendResult(aJsonRpcId, JsonObject::objFromText ("{\"success\": 1}"));
+          sendApiResult(aJsonRpcId, JsonObject::objFromText ("{\"success\": 1}"));
           OLOG(LOG_NOTICE, "Terminating application with exitcode=%d", exitcode);
           Application::sharedApplication()->terminateApp(exitcode);
         }
       else
         {
-          mJsonRpcAPI.sendError(aJsonRpcId, JsonRpcError::InvalidParams, "mandatory boolean parameter \"i_mean_it\" wrong or missing.");
+          sendApiError(aJsonRpcId, JsonRpcError::InvalidParams, "mandatory boolean parameter \"i_mean_it\" wrong or missing.");
         }
 
       return;
     }
 
+  else if (strcmp ("matter_set_capture", aMethod.c_str()) == 0)
+    {
+      JsonObjectPtr o;
+      ApiCapture::sharedCapture().enable(aParams && aParams->get("enable", o) && o->boolValue());
+      sendApiResult(aJsonRpcId, JsonObject::objFromText ("{\"success\": 1}"));
+      return;
+    }
+
+  else if (strcmp ("matter_set_trace", aMethod.c_str()) == 0)
+    {
+      JsonObjectPtr o;
+      EventTrace::sharedTrace().enable(aParams && aParams->get("enable", o) && o->boolValue());
+      sendApiResult(aJsonRpcId, JsonObject::objFromText ("{\"success\": 1}"));
+      return;
+    }
+
+  else if (strcmp ("matter_get_statistics", aMethod.c_str()) == 0)
+    {
+      JsonObjectPtr result = JsonObject::newObj();
+
+      result->add ("connection", JsonObject::newString (mSupervisor.statistics()));
+      result->add ("dispatch", JsonObject::newString (mDispatchQueue.statistics()));
+      result->add ("traffic", JsonObject::newString (mTrafficMeter.statistics()));
+      result->add ("outgoing", JsonObject::newString (mOutgoingQueue.statistics()));
+      result->add ("attributecache", JsonObject::newString (AttributeCache::statistics()));
+      result->add ("stalls", JsonObject::newString (StallDetector::sharedDetector().statistics()));
+      mTrafficMeter.reset();
+      AttributeCache::resetStatistics();
+      StallDetector::sharedDetector().reset();
+      sendApiResult(aJsonRpcId, result);
+      return;
+    }
+
   // For now, we just reject all request with error
-  mJsonRpcAPI.sendError(aJsonRpcId, JsonRpcError::InvalidRequest, "TODO: implement methods");
+  sendApiError(aJsonRpcId, JsonRpcError::InvalidRequest, "TODO: implement methods");
 
 }
 
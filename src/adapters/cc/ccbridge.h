@@ -28,6 +28,30 @@
 #if CC_ADAPTERS
 
 #include "jsonrpccomm.hpp"
+#include "adapters/connectionsupervisor.h"
+#include "adapters/apicapture.h"
+#include "adapters/dispatchqueue.h"
+#include "adapters/trafficmeter.h"
+#include "adapters/outgoingqueue.h"
+
+#ifndef CC_COMMAND_BURST_WINDOW
+  #define CC_COMMAND_BURST_WINDOW (50*MilliSecond) ///< time window for collecting device commands to send as a burst
+#endif
+#ifndef CC_DEVICE_ARRIVAL_WINDOW
+  #define CC_DEVICE_ARRIVAL_WINDOW (100*MilliSecond) ///< time window for collecting created items, to query their info in one call
+#endif
+#ifndef CC_BULK_QUERY_MIN_ITEMS
+  #define CC_BULK_QUERY_MIN_ITEMS 5 ///< min number of created items for querying all items' info in one call instead of one by one
+#endif
+#ifndef CC_BULK_QUERY_MIN_FRACTION
+  #define CC_BULK_QUERY_MIN_FRACTION 0.2 ///< min ratio of created items to all known items for querying all items' info in one call
+#endif
+#ifndef CC_MAX_REQUESTS_IN_FLIGHT
+  #define CC_MAX_REQUESTS_IN_FLIGHT 8 ///< max number of unanswered requests before further requests are queued
+#endif
+#ifndef CC_MAX_QUEUED_REQUESTS
+  #define CC_MAX_QUEUED_REQUESTS 200 ///< max number of requests waiting in the outgoing queue
+#endif
 
 // MARK: - CC_BridgeImpl
 
@@ -37,7 +61,35 @@ class CC_BridgeImpl : public BridgeAdapter, public P44LoggingObj
   typedef BridgeAdapter inherited;
 
   JsonRpcComm mJsonRpcAPI;
-  MLTicket mApiRetryTicket;
+  ConnectionSupervisor mSupervisor;
+  DispatchQueue mDispatchQueue;
+  TrafficMeter mTrafficMeter; ///< accounts requests/notifications received from the bridge API
+  OutgoingQueue mOutgoingQueue; ///< prioritized queue for requests to the bridge API
+  /// a request sent but not yet answered
+  typedef struct {
+    long mSerial; ///< local serial number of the request (JsonRpcComm does not expose the JSON-RPC id)
+    string mMethod;
+    JsonRpcResponseCB mResponseCB;
+  } PendingRequest;
+  typedef std::list<PendingRequest> PendingRequestsList;
+  PendingRequestsList mRequestsInFlight; ///< requests sent but not yet answered
+  long mRequestSerial; ///< serial number of the last request sent
+
+  /// a request collected for sending in a burst
+  typedef struct {
+    string mMethod;
+    JsonObjectPtr mParams;
+    JsonRpcResponseCB mResponseCB;
+  } BurstRequest;
+  typedef std::list<BurstRequest> BurstRequestsList;
+  BurstRequestsList mBurstRequests; ///< requests collected for sending in a burst
+  MLTicket mBurstTicket; ///< timer for sending collected requests
+
+  typedef std::list<int> ItemIdsList;
+  ItemIdsList mArrivingItems; ///< ids of created items, info not yet queried
+  MLTicket mArrivingItemsTicket; ///< timer for querying info of the created items
+  int mPendingItemQueries; ///< number of item_get_info queries for created items not yet answered
+  JsonObjectPtr mQueriedItems; ///< array of infos of created items queried one by one, bridged together when all are answered
 
   /// private constructor because we must use the adapter() singleton getter/factory
   CC_BridgeImpl();
@@ -64,6 +116,12 @@ public:
   /// @return the CC JSON RPC API for this adapter
   JsonRpcComm& api() { return mJsonRpcAPI; };
 
+  /// @return the queue for handing off received requests/notifications to processing (for setting budget, statistics)
+  DispatchQueue& dispatchQueue() { return mDispatchQueue; }
+
+  /// @return the meter for received message volume and processing cost (for enabling size metering)
+  TrafficMeter& trafficMeter() { return mTrafficMeter; }
+
   /// @brief Set up connection parameters for the CC bridge API
   /// @param aApiHost the host name of the CC bridge API server
   /// @param aApiService the "service name" (at this time: port number only) of the CC bridge API server
@@ -124,19 +182,59 @@ public:
 
   /// @}
 
+  /// @brief send a request as part of a burst with other requests issued within CC_COMMAND_BURST_WINDOW
+  /// @param aMethod the JSON-RPC method
+  /// @param aParams the params
+  /// @param aResponseCB the response handler
+  /// @note the CC API has no way to address multiple items in one command (except pre-configured group items),
+  ///   so collecting requests and sending them back-to-back is the best way to make multiple motors start together.
+  void sendRequestInBurst(const string aMethod, JsonObjectPtr aParams, JsonRpcResponseCB aResponseCB);
+
+  /// @brief send a request, or queue it by priority when the CC API has too many requests unanswered
+  /// @param aMethod the JSON-RPC method
+  /// @param aParams the params
+  /// @param aResponseCB the response handler, can be NULL (notification)
+  /// @param aPriority priority class for when the request must be queued
+  void sendRequest(const string aMethod, JsonObjectPtr aParams, JsonRpcResponseCB aResponseCB, OutgoingQueue::Priority aPriority = OutgoingQueue::interactive);
+
 private:
 
+  bool canSend();
+  void requestDiscarded(const string aMethod, JsonRpcResponseCB aResponseCB, ErrorPtr aReason);
+  void sendQueuedRequest(const string aMethod, JsonObjectPtr aParams, JsonRpcResponseCB aResponseCB);
+  void requestAnswered(long aSerial, int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData);
+  void failPendingRequests(const char* aReason);
+
+  ErrorPtr apiRequest(const string aMethod, JsonObjectPtr aParams, JsonRpcResponseCB aResponseCB);
+  void capturedAnswer(const string aMethod, JsonRpcResponseCB aResponseCB, int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData);
+  void sendApiResult(const JsonObjectPtr aJsonRpcId, JsonObjectPtr aResult);
+  void sendApiError(const JsonObjectPtr aJsonRpcId, int32_t aErrorCode, const char* aErrorMessage);
+  void captureRpcMessage(ApiCapture::Direction aDirection, const char* aMethod, const JsonObjectPtr aJsonRpcId, JsonObjectPtr aParams, JsonObjectPtr aResult, JsonObjectPtr aError, const char* aAnsweredMethod = nullptr);
+
+  void sendBurst();
   void createDeviceForData(JsonObjectPtr item, bool in_init);
 
   void jsonRpcConnectionOpen();
   void jsonRpcConnectionStatusHandler(ErrorPtr aError);
+  void jsonRpcConnectionLost(ErrorPtr aError);
+  void probe(StatusCB aProbeResultCB);
+  void probeAnswer(StatusCB aProbeResultCB, int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData);
   void jsonRpcRequestHandler(const char *aMethod, const JsonObjectPtr aJsonRpcId, JsonObjectPtr aParams);
+  void meteredRequest(const string aMethod, const JsonObjectPtr aJsonRpcId, JsonObjectPtr aParams);
+  void processRequest(const string aMethod, const JsonObjectPtr aJsonRpcId, JsonObjectPtr aParams);
 
   void client_subscribed(int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData);
   void client_registered(int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData);
   void deviceListReceived(int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData);
   void ignoreLogResponse(int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData);
-  void itemInfoReceived(int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData);
+  void itemCreated(int aItemId);
+  void queryArrivingItems();
+  void arrivingItemInfoReceived(int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData);
+  /// bridge created items, all in one installation
+  /// @param aItemInfos array of item infos
+  /// @param aItemIdsP if not NULL, only items with these ids are bridged
+  void bridgeArrivingItems(JsonObjectPtr aItemInfos, ItemIdsList* aItemIdsP);
+  void arrivingItemsInfoReceived(ItemIdsList aItemIds, int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData);
 
 };
 
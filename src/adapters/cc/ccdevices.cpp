@@ -85,12 +85,13 @@ bool CC_DeviceImpl::changeName(const string aNewName)
 {
   if (aNewName!=mName) {
     mName = aNewName;
+    device().invalidateLogContextPrefix();
 #if 0
     /* do not propagate back to deviced */
     JsonObjectPtr params = JsonObject::newObj();
     params->add("item_id", JsonObject::newInt32(CC_DeviceImpl::get_item_id ()));
     params->add("name", JsonObject::newString(aNewName));
-    CC_BridgeImpl::adapter().api().sendRequest("item_set_name", params);
+    CC_BridgeImpl::adapter().sendRequest("item_set_name", params, NULL, OutgoingQueue::sync);
 #endif
 
     updateBridgedInfo(NULL);
@@ -127,7 +128,7 @@ void CC_IdentifiableImpl::identify(int aDurationS)
   params->add("command", JsonObject::newString ("clack"));
   params->add("value", JsonObject::newInt32 (3));
   DLOG(LOG_INFO, "sending deviced.group_send_command with params = %s", JsonObject::text(params));
-  CC_BridgeImpl::adapter().api().sendRequest("deviced.group_send_command", params, boost::bind(&CC_IdentifiableImpl::onIdentifyResponse, this, _1, _2, _3));
+  CC_BridgeImpl::adapter().sendRequest("deviced.group_send_command", params, boost::bind(&CC_IdentifiableImpl::onIdentifyResponse, this, _1, _2, _3));
 }
 
 
@@ -157,7 +158,7 @@ void CC_OnOffImpl::setOnOffState(bool aOn)
   params->add("command", JsonObject::newString ("switch"));
   params->add("value", JsonObject::newInt32 (aOn ? 1 : 0));
   DLOG(LOG_INFO, "sending deviced.group_send_command with params = %s", JsonObject::text(params));
-  CC_BridgeImpl::adapter().api().sendRequest("deviced.group_send_command", params, boost::bind(&CC_OnOffImpl::onOffResponse, this, _1, _2, _3));
+  CC_BridgeImpl::adapter().sendRequest("deviced.group_send_command", params, boost::bind(&CC_OnOffImpl::onOffResponse, this, _1, _2, _3));
 
 }
 
@@ -206,7 +207,7 @@ void CC_LevelControlImpl::setLevel(double aNewLevel, uint16_t aTransitionTimeDS)
   params->add ("value", JsonObject::newDouble (aNewLevel));
 
   DLOG(LOG_INFO, "sending deviced.group_send_command with params = %s", JsonObject::text(params));
-  CC_BridgeImpl::adapter().api().sendRequest("deviced.group_send_command", params, boost::bind(&CC_LevelControlImpl::levelControlResponse, this, _1, _2, _3));
+  CC_BridgeImpl::adapter().sendRequest("deviced.group_send_command", params, boost::bind(&CC_LevelControlImpl::levelControlResponse, this, _1, _2, _3));
 }
 
 void CC_LevelControlImpl::dim(int8_t aDirection, uint8_t aRate)
@@ -217,7 +218,7 @@ void CC_LevelControlImpl::dim(int8_t aDirection, uint8_t aRate)
   params->add ("value", JsonObject::newDouble (aDirection ? 1.0 : -1.0));
 
   DLOG(LOG_INFO, "sending deviced.group_send_command with params = %s", JsonObject::text(params));
-  CC_BridgeImpl::adapter().api().sendRequest("deviced.group_send_command", params, boost::bind(&CC_LevelControlImpl::levelControlResponse, this, _1, _2, _3));
+  CC_BridgeImpl::adapter().sendRequest("deviced.group_send_command", params, boost::bind(&CC_LevelControlImpl::levelControlResponse, this, _1, _2, _3));
 }
 
 
@@ -363,7 +364,7 @@ void CC_WindowCoveringImpl::startMovement(WindowCovering::WindowCoveringType aMo
           params->add ("value", JsonObject::newDouble (matter2bridge(lift.Value(), mode.Has(WindowCovering::Mode::kMotorDirectionReversed)) > 0.01 ? 1 : -1));
         }
       DLOG(LOG_INFO, "sending deviced.group_send_command with params = %s", JsonObject::text(params));
-      CC_BridgeImpl::adapter().api().sendRequest("deviced.group_send_command", params, boost::bind(&CC_WindowCoveringImpl::windowCoveringResponse, this, _1, _2, _3));
+      CC_BridgeImpl::adapter().sendRequestInBurst("deviced.group_send_command", params, boost::bind(&CC_WindowCoveringImpl::windowCoveringResponse, this, _1, _2, _3));
     }
 
   if (!tilt.IsNull() &&
@@ -375,7 +376,7 @@ void CC_WindowCoveringImpl::startMovement(WindowCovering::WindowCoveringType aMo
       params->add ("command", JsonObject::newString ("tilt"));
       params->add ("value", JsonObject::newDouble (matter2bridge(tilt.Value(), mode.Has(WindowCovering::Mode::kMotorDirectionReversed))));
       DLOG(LOG_INFO, "sending deviced.group_send_command with params = %s", JsonObject::text(params));
-      CC_BridgeImpl::adapter().api().sendRequest("deviced.group_send_command", params, boost::bind(&CC_WindowCoveringImpl::windowCoveringResponse, this, _1, _2, _3));
+      CC_BridgeImpl::adapter().sendRequestInBurst("deviced.group_send_command", params, boost::bind(&CC_WindowCoveringImpl::windowCoveringResponse, this, _1, _2, _3));
     }
 }
 
@@ -393,7 +394,7 @@ void CC_WindowCoveringImpl::simpleStartMovement(WindowCovering::WindowCoveringTy
       params->add ("command", JsonObject::newString ("move"));
       params->add ("value", JsonObject::newDouble (matter2bridge(aUpOrOpen ? 0.0 : 10000.0, mode.Has(WindowCovering::Mode::kMotorDirectionReversed)) > 0.01 ? 1 : -1));
       DLOG(LOG_INFO, "sending deviced.group_send_command with params = %s", JsonObject::text(params));
-      CC_BridgeImpl::adapter().api().sendRequest("deviced.group_send_command", params, boost::bind(&CC_WindowCoveringImpl::windowCoveringResponse, this, _1, _2, _3));
+      CC_BridgeImpl::adapter().sendRequestInBurst("deviced.group_send_command", params, boost::bind(&CC_WindowCoveringImpl::windowCoveringResponse, this, _1, _2, _3));
     }
   else if (aMovementType == WindowCovering::WindowCoveringType::Tilt)
     {
@@ -402,7 +403,7 @@ void CC_WindowCoveringImpl::simpleStartMovement(WindowCovering::WindowCoveringTy
       params->add ("command", JsonObject::newString ("tilt"));
       params->add ("value", JsonObject::newDouble (matter2bridge(aUpOrOpen ? 0.0 : 10000.0, mode.Has(WindowCovering::Mode::kMotorDirectionReversed))));
       DLOG(LOG_INFO, "sending deviced.group_send_command with params = %s", JsonObject::text(params));
-      CC_BridgeImpl::adapter().api().sendRequest("deviced.group_send_command", params, boost::bind(&CC_WindowCoveringImpl::windowCoveringResponse, this, _1, _2, _3));
+      CC_BridgeImpl::adapter().sendRequestInBurst("deviced.group_send_command", params, boost::bind(&CC_WindowCoveringImpl::windowCoveringResponse, this, _1, _2, _3));
     }
 }
 
@@ -422,7 +423,7 @@ void CC_WindowCoveringImpl::stopMovement()
   params->add ("command", JsonObject::newString ("move"));
   params->add ("value", JsonObject::newInt32 (0));
   DLOG(LOG_INFO, "sending deviced.group_send_command with params = %s", JsonObject::text(params));
-  CC_BridgeImpl::adapter().api().sendRequest("deviced.group_send_command", params, boost::bind(&CC_WindowCoveringImpl::windowCoveringResponse, this, _1, _2, _3));
+  CC_BridgeImpl::adapter().sendRequestInBurst("deviced.group_send_command", params, boost::bind(&CC_WindowCoveringImpl::windowCoveringResponse, this, _1, _2, _3));
 }
 
 
@@ -464,14 +465,24 @@ void CC_WindowCoveringImpl::handle_state_changed(JsonObjectPtr aParams)
       //   variants how to handle this, so we directly access the attributes:
       // luz: Assumptions:
       // - this is the current position
-      WindowCovering::Attributes::CurrentPositionLiftPercent100ths::Set(endpointId(), bridge2matter(vo->doubleValue(), mode.Has(WindowCovering::Mode::kMotorDirectionReversed)));
+      // - still moving as long as target is not reached, let motion model predict further progress
+      Percent100ths current = bridge2matter(vo->doubleValue(), mode.Has(WindowCovering::Mode::kMotorDirectionReversed));
+      DataModel::Nullable<Percent100ths> target;
+      WindowCovering::Attributes::TargetPositionLiftPercent100ths::Get(endpointId(), target);
+      // Note: target and current are rounded differently, so they might never match exactly
+      bool moving = !target.IsNull() && abs((int)target.Value()-(int)current)>DeviceWindowCovering::kTargetTolerance;
+      deviceP<DeviceWindowCovering>()->updateActualMotion(WindowCovering::WindowCoveringType::Lift, target.IsNull() ? current : target.Value(), WindowCovering::NPercent100ths(current), moving);
     }
     if (o->get("value-tilt", vo) && mHasTilt) {
       // roughly something like this?
       // deviceP<DeviceWindowCovering>()->updateTilt(vo->doubleValue(), UpdateMode(UpdateFlags::matter));
       // luz: Assumptions:
       // - this is the current position
-      WindowCovering::Attributes::CurrentPositionTiltPercent100ths::Set(endpointId(), bridge2matter(vo->doubleValue(), mode.Has(WindowCovering::Mode::kMotorDirectionReversed)));
+      Percent100ths current = bridge2matter(vo->doubleValue(), mode.Has(WindowCovering::Mode::kMotorDirectionReversed));
+      DataModel::Nullable<Percent100ths> target;
+      WindowCovering::Attributes::TargetPositionTiltPercent100ths::Get(endpointId(), target);
+      bool moving = !target.IsNull() && abs((int)target.Value()-(int)current)>DeviceWindowCovering::kTargetTolerance;
+      deviceP<DeviceWindowCovering>()->updateActualMotion(WindowCovering::WindowCoveringType::Tilt, target.IsNull() ? current : target.Value(), WindowCovering::NPercent100ths(current), moving);
     }
 
   if (aParams->get("error_flags", o)) {
@@ -89,7 +89,7 @@ public:
   bool mFeedback;
   bool mUnresponsive;
 
-  void initialize_name(const string _name) { mName = _name; }
+  void initialize_name(const string _name) { mName = _name; device().invalidateLogContextPrefix(); }
   void initialize_feedback(const bool _feedback) { mFeedback = _feedback; }
   void initialize_unresponsive() { mUnresponsive = false; }
 
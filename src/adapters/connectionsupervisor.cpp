@@ -0,0 +1,215 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "connectionsupervisor.h"
+
+#include <random>
+#include <unistd.h>
+#include <time.h>
+
+using namespace p44;
+
+// MARK: - ConnectionSupervisor
+
+ConnectionSupervisor::ConnectionSupervisor(const string aName) :
+  mName(aName),
+  mConnected(false),
+  mRetryInterval(CONNECTION_MIN_RETRY_INTERVAL),
+  mLastActivity(Never),
+  mProbeSentAt(Never),
+  mProbeSerial(0),
+  mNumConnects(0),
+  mNumFailures(0),
+  mNumStalls(0),
+  mNumProbes(0),
+  mLastRtt(0),
+  mMinRtt(0),
+  mMaxRtt(0),
+  mTotalRtt(0)
+{
+}
+
+
+void ConnectionSupervisor::setHandlers(SimpleCB aConnectCB, ProbeCB aProbeCB, StatusCB aConnectionLostCB)
+{
+  mConnectCB = aConnectCB;
+  mProbeCB = aProbeCB;
+  mConnectionLostCB = aConnectionLostCB;
+}
+
+
+void ConnectionSupervisor::connect()
+{
+  mRetryTicket.cancel();
+  if (mConnectCB) mConnectCB();
+}
+
+
+void ConnectionSupervisor::reconnect()
+{
+  mRetryTicket.cancel();
+  OLOG(LOG_NOTICE, "trying to reconnect");
+  if (mConnectCB) mConnectCB();
+}
+
+
+void ConnectionSupervisor::stop()
+{
+  mRetryTicket.cancel();
+  mKeepAliveTicket.cancel();
+  mConnected = false;
+  mProbeSentAt = Never;
+}
+
+
+void ConnectionSupervisor::connectionEstablished()
+{
+  mRetryTicket.cancel();
+  mConnected = true;
+  mNumConnects++;
+  mRetryInterval = CONNECTION_MIN_RETRY_INTERVAL;
+  mLastActivity = MainLoop::now();
+  mProbeSentAt = Never;
+  mProbeSerial++; // invalidate probes from previous connection
+  if (mNumConnects>1) {
+    OLOG(LOG_NOTICE, "re-established, statistics: %s", statistics().c_str());
+  }
+  scheduleKeepAlive();
+}
+
+
+void ConnectionSupervisor::connectionFailed(ErrorPtr aError)
+{
+  bool wasConnected = mConnected;
+  if (!wasConnected && mRetryTicket) return; // already waiting for reconnect (e.g. close after stall detection)
+  mConnected = false;
+  mNumFailures++;
+  mKeepAliveTicket.cancel();
+  mProbeSentAt = Never;
+  OLOG(LOG_WARNING, "%s: %s", wasConnected ? "lost" : "failed", Error::text(aError));
+  scheduleReconnect();
+  if (wasConnected && mConnectionLostCB) mConnectionLostCB(aError);
+}
+
+
+/// random generator for the reconnect jitter, seeded per process, so bridges started at
+/// the same time (e.g. after a power failure) do not all get the same jitter sequence
+static std::mt19937& jitterGenerator()
+{
+  static std::mt19937* sGeneratorP = nullptr;
+  if (!sGeneratorP) {
+    std::seed_seq seed{ static_cast<unsigned>(std::random_device()()), static_cast<unsigned>(getpid()), static_cast<unsigned>(time(NULL)) };
+    sGeneratorP = new std::mt19937(seed);
+  }
+  return *sGeneratorP;
+}
+
+
+void ConnectionSupervisor::scheduleReconnect()
+{
+  // exponential backoff with jitter, so many clients do not hammer a restarting server all at the same time
+  std::uniform_real_distribution<double> jitterDistribution(-1.0, 1.0);
+  double jitter = CONNECTION_RETRY_JITTER*jitterDistribution(jitterGenerator());
+  MLMicroSeconds delay = static_cast<MLMicroSeconds>(mRetryInterval*(1.0+jitter));
+  OLOG(LOG_INFO, "reconnecting in %.1f seconds", (double)delay/Second);
+  mRetryTicket.executeOnce(boost::bind(&ConnectionSupervisor::reconnect, this), delay);
+  mRetryInterval *= 2;
+  if (mRetryInterval>CONNECTION_MAX_RETRY_INTERVAL) mRetryInterval = CONNECTION_MAX_RETRY_INTERVAL;
+}
+
+
+void ConnectionSupervisor::activity()
+{
+  // Note: just note the time, keepAliveCheck() will derive the next check from it
+  mLastActivity = MainLoop::now();
+}
+
+
+void ConnectionSupervisor::scheduleKeepAlive()
+{
+  if (!mProbeCB) return; // no probing possible
+  mKeepAliveTicket.executeOnce(boost::bind(&ConnectionSupervisor::keepAliveCheck, this), CONNECTION_KEEPALIVE_INTERVAL);
+}
+
+
+void ConnectionSupervisor::keepAliveCheck()
+{
+  if (!mConnected) return;
+  MLMicroSeconds now = MainLoop::now();
+  if (mProbeSentAt!=Never) {
+    // probe pending
+    if (now-mProbeSentAt>=CONNECTION_PROBE_TIMEOUT) {
+      // peer did not answer in time
+      mNumStalls++;
+      mNumFailures++;
+      mConnected = false;
+      mProbeSentAt = Never;
+      mProbeSerial++; // ignore late answer
+      OLOG(LOG_WARNING, "peer did not answer probe within %lld seconds -> considered stalled", (long long)(CONNECTION_PROBE_TIMEOUT/Second));
+      scheduleReconnect(); // before reporting, so closing the connection in the handler does not schedule again
+      if (mConnectionLostCB) mConnectionLostCB(TextError::err("%s peer stalled", mName.c_str()));
+      return;
+    }
+    mKeepAliveTicket.executeOnce(boost::bind(&ConnectionSupervisor::keepAliveCheck, this), mProbeSentAt+CONNECTION_PROBE_TIMEOUT-now);
+    return;
+  }
+  if (now-mLastActivity>=CONNECTION_KEEPALIVE_INTERVAL) {
+    // idle for too long, probe
+    mProbeSentAt = now;
+    uint32_t serial = ++mProbeSerial;
+    mKeepAliveTicket.executeOnce(boost::bind(&ConnectionSupervisor::keepAliveCheck, this), CONNECTION_PROBE_TIMEOUT);
+    OLOG(LOG_DEBUG, "idle, sending probe #%u", serial);
+    mProbeCB(boost::bind(&ConnectionSupervisor::probeAnswered, this, serial, _1));
+    return;
+  }
+  // recent activity, check again when keepalive interval since last activity has passed
+  mKeepAliveTicket.executeOnce(boost::bind(&ConnectionSupervisor::keepAliveCheck, this), mLastActivity+CONNECTION_KEEPALIVE_INTERVAL-now);
+}
+
+
+void ConnectionSupervisor::probeAnswered(uint32_t aProbeSerial, ErrorPtr aError)
+{
+  if (aProbeSerial!=mProbeSerial || mProbeSentAt==Never) return; // outdated
+  MLMicroSeconds now = MainLoop::now();
+  mLastRtt = now-mProbeSentAt;
+  if (mNumProbes==0 || mLastRtt<mMinRtt) mMinRtt = mLastRtt;
+  if (mLastRtt>mMaxRtt) mMaxRtt = mLastRtt;
+  mTotalRtt += mLastRtt;
+  mNumProbes++;
+  mProbeSentAt = Never;
+  mLastActivity = now;
+  OLOG(LOG_DEBUG, "probe #%u answered after %.1f mS (%s)", aProbeSerial, (double)mLastRtt/MilliSecond, Error::text(aError));
+  scheduleKeepAlive();
+}
+
+
+string ConnectionSupervisor::statistics()
+{
+  return string_format(
+    "%s, connects: %ld, failures: %ld, stalls: %ld, probes: %ld, probe RTT last/min/avg/max: %.1f/%.1f/%.1f/%.1f mS",
+    mConnected ? "connected" : "disconnected",
+    mNumConnects, mNumFailures, mNumStalls, mNumProbes,
+    (double)mLastRtt/MilliSecond, (double)mMinRtt/MilliSecond,
+    mNumProbes>0 ? (double)mTotalRtt/mNumProbes/MilliSecond : 0.0,
+    (double)mMaxRtt/MilliSecond
+  );
+}
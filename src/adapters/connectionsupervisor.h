@@ -0,0 +1,134 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include "p44mbrd_common.h"
+
+using namespace p44;
+
+#ifndef CONNECTION_MIN_RETRY_INTERVAL
+  #define CONNECTION_MIN_RETRY_INTERVAL (1*Second) ///< first reconnect attempt after this time
+#endif
+#ifndef CONNECTION_MAX_RETRY_INTERVAL
+  #define CONNECTION_MAX_RETRY_INTERVAL (60*Second) ///< reconnect interval doubles up to this limit
+#endif
+#ifndef CONNECTION_RETRY_JITTER
+  #define CONNECTION_RETRY_JITTER 0.25 ///< relative random variation of reconnect intervals
+#endif
+#ifndef CONNECTION_KEEPALIVE_INTERVAL
+  #define CONNECTION_KEEPALIVE_INTERVAL (30*Second) ///< probe the peer when nothing was received for this time
+#endif
+#ifndef CONNECTION_PROBE_TIMEOUT
+  #define CONNECTION_PROBE_TIMEOUT (10*Second) ///< peer is considered stalled when it does not answer a probe within this time
+#endif
+
+
+/// @brief supervises a bridge API connection
+/// Handles reconnecting with exponential backoff and jitter, and detects stalled peers
+/// (half-open connections, or peers that accept data but do not process it any more)
+/// by probing with application level requests when the connection has been idle.
+class ConnectionSupervisor : public P44LoggingObj
+{
+  typedef P44LoggingObj inherited;
+
+public:
+
+  /// @brief probe handler, must send an application level request to the peer and call
+  ///   aProbeResultCB when the answer (or an error) arrives.
+  /// @note any answer, even an error answer from the peer, proves the peer is alive.
+  typedef boost::function<void (StatusCB aProbeResultCB)> ProbeCB;
+
+private:
+
+  string mName; ///< name of the connection for logging
+  SimpleCB mConnectCB; ///< called to (re)initiate the connection
+  ProbeCB mProbeCB; ///< called to send a probe
+  StatusCB mConnectionLostCB; ///< called when an established connection is lost or the peer is stalled
+
+  bool mConnected; ///< set while connection is established
+  MLMicroSeconds mRetryInterval; ///< current reconnect interval (before jitter)
+  MLMicroSeconds mLastActivity; ///< last time data was received from the peer
+  MLMicroSeconds mProbeSentAt; ///< time the pending probe was sent, Never if none
+  uint32_t mProbeSerial; ///< serial number to identify answers to the current probe
+  MLTicket mRetryTicket; ///< timer for reconnecting
+  MLTicket mKeepAliveTicket; ///< timer for keepalive probes
+
+  /// @name statistics
+  /// @{
+  long mNumConnects; ///< number of successful connects
+  long mNumFailures; ///< number of failed connection attempts and connection losses
+  long mNumStalls; ///< number of stalled peer detections
+  long mNumProbes; ///< number of probes answered
+  MLMicroSeconds mLastRtt; ///< round trip time of the last answered probe
+  MLMicroSeconds mMinRtt; ///< minimal probe round trip time
+  MLMicroSeconds mMaxRtt; ///< maximal probe round trip time
+  MLMicroSeconds mTotalRtt; ///< sum of all probe round trip times (for average)
+  /// @}
+
+public:
+
+  /// @param aName name of the supervised connection (for logging)
+  ConnectionSupervisor(const string aName);
+
+  virtual string logContextPrefix() override { return mName + " connection"; }
+
+  /// @brief set up the handlers
+  /// @param aConnectCB will be called to initiate (or re-initiate) the connection. The connection
+  ///   implementation must report the outcome via connectionEstablished() or connectionFailed()
+  /// @param aProbeCB will be called to probe the peer while the connection is idle
+  /// @param aConnectionLostCB will be called when an established connection is lost or the peer stalled.
+  ///   When the peer stalled, the handler must close the connection (without reporting connectionFailed()).
+  void setHandlers(SimpleCB aConnectCB, ProbeCB aProbeCB, StatusCB aConnectionLostCB);
+
+  /// @brief initiate the connection now
+  void connect();
+
+  /// @brief must be called by the connection implementation when the connection is established
+  void connectionEstablished();
+
+  /// @brief must be called by the connection implementation when connecting failed or an established
+  ///   connection was closed
+  /// @param aError the reason
+  void connectionFailed(ErrorPtr aError);
+
+  /// @brief should be called by the connection implementation whenever data was received from the peer
+  void activity();
+
+  /// @brief stop supervision and reconnecting (e.g. when cleaning up)
+  void stop();
+
+  /// @return true if connection is established
+  bool isConnected() const { return mConnected; }
+
+  /// @return statistics (reconnects, stalls, probe round trip times) as a single line of text
+  string statistics();
+
+private:
+
+  void scheduleReconnect();
+  void reconnect();
+  void scheduleKeepAlive();
+  void keepAliveCheck();
+  void probeAnswered(uint32_t aProbeSerial, ErrorPtr aError);
+
+};
@@ -0,0 +1,90 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "dispatchqueue.h"
+
+using namespace p44;
+
+// MARK: - DispatchQueue
+
+DispatchQueue::DispatchQueue(const string aName) :
+  mName(aName),
+  mBudget(0),
+  mNumDispatched(0),
+  mNumYields(0),
+  mMaxQueueLength(0)
+{
+}
+
+
+void DispatchQueue::dispatch(SimpleCB aWork)
+{
+  if (mBudget==0 && mQueue.empty()) {
+    // no queueing
+    mNumDispatched++;
+    aWork();
+    return;
+  }
+  mQueue.push_back(aWork);
+  if (mQueue.size()>mMaxQueueLength) mMaxQueueLength = mQueue.size();
+  if (!mDispatchTicket) {
+    // process in next mainloop cycle, after pending I/O has been handled
+    mDispatchTicket.executeOnce(boost::bind(&DispatchQueue::process, this), 0);
+  }
+}
+
+
+void DispatchQueue::clear()
+{
+  mDispatchTicket.cancel();
+  mQueue.clear();
+}
+
+
+void DispatchQueue::process()
+{
+  mDispatchTicket.cancel();
+  MLMicroSeconds start = MainLoop::now();
+  while (!mQueue.empty()) {
+    // Note: pop before calling, work might dispatch more work
+    SimpleCB work = mQueue.front();
+    mQueue.pop_front();
+    mNumDispatched++;
+    work();
+    if (!mQueue.empty() && MainLoop::now()-start>=mBudget) {
+      // budget exhausted, let mainloop handle other events first
+      mNumYields++;
+      OLOG(LOG_DEBUG, "budget exhausted, yielding with %zu items still queued", mQueue.size());
+      mDispatchTicket.executeOnce(boost::bind(&DispatchQueue::process, this), 0);
+      return;
+    }
+  }
+}
+
+
+string DispatchQueue::statistics()
+{
+  return string_format(
+    "budget: %lld mS, dispatched: %ld, yields: %ld, currently queued: %zu, max queued: %zu",
+    (long long)(mBudget/MilliSecond), mNumDispatched, mNumYields, mQueue.size(), mMaxQueueLength
+  );
+}
@@ -0,0 +1,80 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include "p44mbrd_common.h"
+
+#include <deque>
+
+using namespace p44;
+
+#ifndef BULK_WORK_SLICE
+  #define BULK_WORK_SLICE (20*MilliSecond) ///< default max time per mainloop cycle for bulk work such as processing device lists at startup
+#endif
+
+
+/// @brief queue for handing off incoming bridge API messages to processing on the mainloop
+/// When a time budget is set, queued messages are processed in slices not exceeding that budget,
+/// with the mainloop (and thus the CHIP stack sharing it) getting a chance to handle its own
+/// I/O between slices. Without a budget, messages are processed immediately.
+class DispatchQueue : public P44LoggingObj
+{
+  typedef P44LoggingObj inherited;
+
+  string mName; ///< name for logging
+  std::deque<SimpleCB> mQueue; ///< queued work
+  MLMicroSeconds mBudget; ///< max time to spend processing queued work per mainloop cycle, 0 = process immediately
+  MLTicket mDispatchTicket; ///< for processing queued work in next mainloop cycle
+
+  /// @name statistics
+  /// @{
+  long mNumDispatched; ///< number of items processed
+  long mNumYields; ///< number of times processing yielded to the mainloop with work still queued
+  size_t mMaxQueueLength; ///< max number of queued items seen
+  /// @}
+
+public:
+
+  /// @param aName name of the queue (for logging)
+  DispatchQueue(const string aName);
+
+  virtual string logContextPrefix() override { return mName + " dispatch"; }
+
+  /// @param aBudget max time to spend processing queued work per mainloop cycle, 0 = no queueing
+  void setBudget(MLMicroSeconds aBudget) { mBudget = aBudget; }
+
+  /// @brief process work, immediately or queued
+  /// @param aWork the work to process
+  void dispatch(SimpleCB aWork);
+
+  /// @brief discard all queued work
+  void clear();
+
+  /// @return statistics as a single line of text
+  string statistics();
+
+private:
+
+  void process();
+
+};
@@ -0,0 +1,444 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "jsoniothread.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+using namespace p44;
+
+// MARK: - JsonIoThread
+
+JsonIoThread::JsonIoThread(const string aName) :
+  mName(aName),
+  mReceived(JSON_IO_QUEUE_SIZE),
+  mToSend(JSON_IO_QUEUE_SIZE),
+  mRxFull(false),
+  mTxFull(false),
+  mStop(false),
+  mRunning(false),
+  mGeneration(0),
+  mFd(-1),
+  mBinarySend(false),
+  mNumReceived(0),
+  mNumSent(0),
+  mMaxBacklog(0),
+  mBytesSent(0),
+  mBytesReceived(0)
+{
+  mRxWakeFds[0] = -1; mRxWakeFds[1] = -1;
+  mIoWakeFds[0] = -1; mIoWakeFds[1] = -1;
+  for (int e=0; e<numEncodings; e++) {
+    mNumEncoded[e] = 0;
+    mEncodeTime[e] = 0;
+    mNumDecoded[e] = 0;
+    mDecodeTime[e] = 0;
+  }
+}
+
+
+JsonIoThread::~JsonIoThread()
+{
+  stop();
+}
+
+
+static bool makeWakePipe(int aFds[2])
+{
+  if (pipe(aFds)!=0) return false;
+  fcntl(aFds[0], F_SETFL, fcntl(aFds[0], F_GETFL) | O_NONBLOCK);
+  fcntl(aFds[1], F_SETFL, fcntl(aFds[1], F_GETFL) | O_NONBLOCK);
+  return true;
+}
+
+
+static void closeWakePipe(int aFds[2])
+{
+  if (aFds[0]>=0) close(aFds[0]);
+  if (aFds[1]>=0) close(aFds[1]);
+  aFds[0] = -1; aFds[1] = -1;
+}
+
+
+static void wake(int aFds[2])
+{
+  char c = 0;
+  // Note: a full pipe means the other side has not yet processed earlier wakeups, which is fine
+  if (write(aFds[1], &c, 1)<0) { /* ignore */ }
+}
+
+
+static void drain(int aFd)
+{
+  char buf[64];
+  while (read(aFd, buf, sizeof(buf))>0);
+}
+
+
+ErrorPtr JsonIoThread::start(int aSocketFd, JSonMessageCB aMessageCB)
+{
+  stop();
+  mMessageCB = aMessageCB;
+  mFd = dup(aSocketFd);
+  if (mFd<0) return SysError::errNo("cannot dup socket for I/O thread: ");
+  if (!makeWakePipe(mRxWakeFds) || !makeWakePipe(mIoWakeFds)) {
+    ErrorPtr err = SysError::errNo("cannot create wakeup pipes for I/O thread: ");
+    closeWakePipe(mRxWakeFds);
+    closeWakePipe(mIoWakeFds);
+    close(mFd);
+    mFd = -1;
+    return err;
+  }
+  MainLoop::currentMainLoop().registerPollHandler(mRxWakeFds[0], POLLIN, boost::bind(&JsonIoThread::rxWakeHandler, this, _1, _2));
+  mStop = false;
+  mBinarySend = false; // peer must agree again on every new connection
+  mRunning = true;
+  mGeneration++;
+  mThread = std::thread(&JsonIoThread::ioThread, this);
+  OLOG(LOG_INFO, "started");
+  return ErrorPtr();
+}
+
+
+void JsonIoThread::stop()
+{
+  if (!mRunning) return;
+  mStop = true;
+  wake(mIoWakeFds);
+  if (mThread.joinable()) mThread.join();
+  mRunning = false;
+  mDeliverTicket.cancel();
+  MainLoop::currentMainLoop().unregisterPollHandler(mRxWakeFds[0]);
+  closeWakePipe(mRxWakeFds);
+  closeWakePipe(mIoWakeFds);
+  close(mFd);
+  mFd = -1;
+  // I/O thread has terminated, so queues are ours now
+  mReceived.clear();
+  mToSend.clear();
+  mRxPending.clear();
+  mTxPending.clear();
+  mRxFull = false;
+  mTxFull = false;
+  OLOG(LOG_INFO, "stopped");
+}
+
+
+ErrorPtr JsonIoThread::sendMessage(JsonObjectPtr aMessage)
+{
+  if (!mRunning) return TextError::err("%s: not connected", mName.c_str());
+  MLMicroSeconds start = MainLoop::now();
+  string msg;
+  int encoding = mBinarySend ? binary : json;
+  if (encoding==binary) {
+    MsgPack::encode(aMessage, msg);
+  }
+  else {
+    msg = aMessage->json_str();
+    msg.append("\n");
+  }
+  mNumEncoded[encoding]++;
+  mEncodeTime[encoding] += MainLoop::now()-start;
+  mTxPending.push_back(string());
+  mTxPending.back().swap(msg);
+  handOverToSend();
+  mNumSent++;
+  return ErrorPtr();
+}
+
+
+// MARK: I/O thread
+
+void JsonIoThread::ioThread()
+{
+  string rx; // received data not yet parsed
+  size_t scanPos = 0; // position in rx up to which data was scanned for message boundaries
+  size_t msgStart = 0; // start of the current message in rx
+  int depth = 0; // object/array nesting depth, 0=between messages
+  bool inString = false;
+  bool escaped = false;
+  bool inBinary = false; // set while receiving a MessagePack message
+  MsgPackScanner scanner;
+  string tx; // message currently being sent
+  size_t txPos = 0;
+  bool closed = false; // set when connection is closed or cannot be used any more
+  int closeErrNo = 0; // reason for closing, 0 if closed by peer
+  char buf[JSON_IO_READ_CHUNK];
+  while (!mStop && !closed) {
+    // while the mainloop has not made space for earlier messages, do not read more
+    bool rxBlocked = !handOverReceived();
+    if (tx.empty() && mToSend.pop(tx)) {
+      txPos = 0;
+      if (mTxFull.exchange(false)) wake(mRxWakeFds); // mainloop has more to send
+    }
+    struct pollfd fds[2];
+    // Note: while neither reading nor writing, the socket must not be polled at all, as POLLHUP would be reported continuously
+    fds[0].fd = rxBlocked && tx.empty() ? -1 : mFd;
+    fds[0].events = (short)((rxBlocked ? 0 : POLLIN) | (tx.empty() ? 0 : POLLOUT));
+    fds[0].revents = 0;
+    fds[1].fd = mIoWakeFds[0];
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+    if (poll(fds, 2, -1)<0) {
+      if (errno==EINTR) continue;
+      closeErrNo = errno;
+      closed = true;
+      break;
+    }
+    if (fds[1].revents & POLLIN) drain(mIoWakeFds[0]);
+    if (mStop) break;
+    if (!rxBlocked && (fds[0].revents & (POLLIN|POLLHUP|POLLERR))) {
+      ssize_t n = read(mFd, buf, sizeof(buf));
+      if (n==0 || (n<0 && errno!=EAGAIN && errno!=EINTR)) {
+        closeErrNo = n==0 ? 0 : errno;
+        closed = true;
+        break;
+      }
+      if (n>0) {
+        mBytesReceived += (uint64_t)n;
+        rx.append(buf, (size_t)n);
+        // split into messages: MessagePack by scanning its structure, JSON text by tracking nesting depth outside of strings
+        while (scanPos<rx.size()) {
+          if (inBinary) {
+            MsgPackScanner::Result res = scanner.scan(rx, scanPos);
+            if (res==MsgPackScanner::incomplete) break; // need more data
+            if (res==MsgPackScanner::invalid) {
+              // cannot find the end of the message, so no way to resynchronize
+              closeErrNo = EPROTO;
+              closed = true;
+              break;
+            }
+            // complete message, decode it here in the I/O thread
+            MLMicroSeconds start = MainLoop::now();
+            JsonObjectPtr msg = MsgPack::decode(rx.substr(msgStart, scanPos-msgStart));
+            decoded(binary, start);
+            received(msg);
+            inBinary = false;
+            continue;
+          }
+          char c = rx[scanPos];
+          if (inString) {
+            if (escaped) escaped = false;
+            else if (c=='\\') escaped = true;
+            else if (c=='"') inString = false;
+            scanPos++;
+            continue;
+          }
+          if (depth==0) {
+            if (MsgPack::isMessageStart((uint8_t)c)) {
+              // start of a MessagePack message (never the case for JSON text)
+              inBinary = true;
+              msgStart = scanPos;
+              scanner.reset();
+              continue;
+            }
+            if (c!='{' && c!='[') {
+              // whitespace or delimiters between messages
+              scanPos++;
+              continue;
+            }
+          }
+          if (c=='"') inString = true;
+          else if (c=='{' || c=='[') {
+            if (depth++==0) msgStart = scanPos;
+          }
+          else if (c=='}' || c==']') {
+            if (--depth==0) {
+              // complete message, parse it here in the I/O thread
+              MLMicroSeconds start = MainLoop::now();
+              JsonObjectPtr msg = JsonObject::objFromText(rx.substr(msgStart, scanPos+1-msgStart).c_str());
+              decoded(json, start);
+              received(msg);
+            }
+          }
+          scanPos++;
+        }
+        if (closed) break;
+        // forget what has been processed
+        if (depth==0 && !inBinary) {
+          rx.clear();
+          scanPos = 0;
+        }
+        else if (msgStart>0) {
+          rx.erase(0, msgStart);
+          scanPos -= msgStart;
+          msgStart = 0;
+        }
+      }
+    }
+    if (!tx.empty() && (fds[0].revents & POLLOUT)) {
+      // Note: send() with MSG_NOSIGNAL, so a peer closing the connection cannot raise SIGPIPE in this thread
+      ssize_t n = send(mFd, tx.c_str()+txPos, tx.size()-txPos, MSG_NOSIGNAL);
+      if (n<0 && errno!=EAGAIN && errno!=EINTR) {
+        closeErrNo = errno;
+        closed = true;
+        break;
+      }
+      if (n>0) {
+        mBytesSent += (uint64_t)n;
+        txPos += (size_t)n;
+        if (txPos>=tx.size()) tx.clear();
+      }
+    }
+  }
+  if (closed) {
+    // report closing as the last item, after all messages received before
+    Received r;
+    r.mClosed = true;
+    r.mErrNo = closeErrNo;
+    mRxPending.push_back(r);
+    while (!mStop && !handOverReceived()) {
+      // wait for the mainloop to make space
+      struct pollfd fds[1];
+      fds[0].fd = mIoWakeFds[0];
+      fds[0].events = POLLIN;
+      fds[0].revents = 0;
+      if (poll(fds, 1, -1)>0) drain(mIoWakeFds[0]);
+    }
+  }
+}
+
+
+void JsonIoThread::received(JsonObjectPtr& aMessage)
+{
+  Received r;
+  r.mClosed = false;
+  r.mErrNo = 0;
+  // the message is passed over without keeping a reference in this thread
+  r.mMessage.swap(aMessage);
+  mRxPending.push_back(r);
+}
+
+
+bool JsonIoThread::handOverReceived()
+{
+  bool any = false;
+  while (!mRxPending.empty()) {
+    if (!mReceived.push(mRxPending.front())) {
+      // queue full: ask the mainloop to wake us when it has made space, and try once more
+      // in case it did so before seeing the flag
+      mRxFull = true;
+      if (!mReceived.push(mRxPending.front())) break;
+    }
+    mRxPending.pop_front();
+    any = true;
+  }
+  if (any) wake(mRxWakeFds);
+  return mRxPending.empty();
+}
+
+
+void JsonIoThread::decoded(int aEncoding, MLMicroSeconds aStart)
+{
+  mNumDecoded[aEncoding]++;
+  mDecodeTime[aEncoding] += MainLoop::now()-aStart;
+}
+
+
+// MARK: mainloop side
+
+bool JsonIoThread::rxWakeHandler(int aFD, int aPollFlags)
+{
+  drain(aFD);
+  // deliver from a timer rather than from within the poll handler, as handlers might stop() us
+  if (!mDeliverTicket) {
+    mDeliverTicket.executeOnce(boost::bind(&JsonIoThread::deliver, this), 0);
+  }
+  return true;
+}
+
+
+void JsonIoThread::handOverToSend()
+{
+  bool any = false;
+  while (!mTxPending.empty()) {
+    if (!mToSend.push(mTxPending.front())) {
+      // queue full: ask the I/O thread to wake us when it has made space, and try once more
+      // in case it did so before seeing the flag
+      mTxFull = true;
+      if (!mToSend.push(mTxPending.front())) break;
+    }
+    mTxPending.pop_front();
+    any = true;
+  }
+  if (any) wake(mIoWakeFds);
+}
+
+
+void JsonIoThread::deliver()
+{
+  mDeliverTicket.cancel();
+  if (!mRunning) return;
+  handOverToSend();
+  size_t backlog = mReceived.size();
+  if (backlog>mMaxBacklog) mMaxBacklog = backlog;
+  JSonMessageCB cb = mMessageCB;
+  uint32_t generation = mGeneration;
+  // Note: only deliver what is queued now, the I/O thread wakes us again for messages arriving meanwhile.
+  // Message handlers might stop (and restart) the I/O thread, remaining messages are obsolete then
+  Received r;
+  while (backlog>0 && mRunning && mGeneration==generation && mReceived.pop(r)) {
+    backlog--;
+    if (mRxFull.exchange(false)) wake(mIoWakeFds); // I/O thread has more
+    if (r.mClosed) {
+      ErrorPtr err = r.mErrNo ? SysError::err(r.mErrNo, "connection error: ") : TextError::err("connection closed by peer");
+      OLOG(LOG_WARNING, "%s", err->text());
+      stop();
+      if (cb) cb(err, JsonObjectPtr());
+      return;
+    }
+    if (!r.mMessage) {
+      if (cb) cb(TextError::err("%s: received invalid JSON message", mName.c_str()), JsonObjectPtr());
+      continue;
+    }
+    mNumReceived++;
+    JsonObjectPtr msg;
+    msg.swap(r.mMessage);
+    if (cb) cb(ErrorPtr(), msg);
+  }
+}
+
+
+string JsonIoThread::statistics()
+{
+  string s = string_format(
+    "%s, messages received: %ld, sent: %ld, max backlog: %zu, bytes received: %llu, sent: %llu",
+    mRunning ? "running" : "stopped", mNumReceived, mNumSent, mMaxBacklog,
+    (unsigned long long)mBytesReceived, (unsigned long long)mBytesSent
+  );
+  static const char* encodingNames[numEncodings] = { "JSON", "MessagePack" };
+  for (int e=0; e<numEncodings; e++) {
+    long nd = mNumDecoded[e];
+    int64_t td = mDecodeTime[e];
+    if (nd==0 && mNumEncoded[e]==0) continue;
+    string_format_append(s,
+      ", %s: %ld parsed (avg %lld uS), %ld encoded (avg %lld uS)",
+      encodingNames[e],
+      nd, (long long)(nd>0 ? td/nd : 0),
+      mNumEncoded[e], (long long)(mNumEncoded[e]>0 ? mEncodeTime[e]/mNumEncoded[e] : 0)
+    );
+  }
+  return s;
+}
@@ -0,0 +1,159 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "p44mbrd_common.h"
+
+#include "jsoncomm.hpp" // for JSonMessageCB
+#include "adapters/msgpack.h"
+#include "adapters/spscqueue.h"
+
+#include <deque>
+#include <thread>
+#include <atomic>
+
+using namespace p44;
+
+#ifndef JSON_IO_READ_CHUNK
+  #define JSON_IO_READ_CHUNK 16384 ///< number of bytes read from the socket at once
+#endif
+#ifndef JSON_IO_QUEUE_SIZE
+  #define JSON_IO_QUEUE_SIZE 256 ///< number of messages the queues between I/O thread and mainloop can hold
+#endif
+
+
+/// @brief performs socket I/O and JSON parsing of a connected bridge API socket in a separate thread
+/// Received data is split into messages and parsed in the I/O thread, so even multi-megabyte
+/// messages do not block the mainloop (and the CHIP stack sharing it). Parsed messages are
+/// handed to the mainloop via a lock-free single producer/single consumer queue, outgoing
+/// message text is handed to the I/O thread via another one. When a queue is full, the producer
+/// keeps further messages on its own side, and the consumer wakes it up when it has made space.
+/// So while the mainloop cannot keep up, the I/O thread stops reading from the socket.
+/// Received messages can be JSON text or MessagePack, which can be told apart by their first byte.
+/// Outgoing messages are JSON text unless binary sending is enabled (after the peer has agreed to it).
+/// @note the JsonObjects created by the I/O thread are passed over exclusively, i.e. the
+///   I/O thread does not keep any reference once a message is queued.
+/// @note only the P44 bridge API uses this so far. The CC bridge API still reads and parses in
+///   p44utils' JsonRpcComm on the mainloop, because JsonRpcComm does not allow replacing its transport.
+class JsonIoThread : public P44LoggingObj
+{
+  typedef P44LoggingObj inherited;
+
+  /// an item passed from the I/O thread to the mainloop
+  typedef struct {
+    JsonObjectPtr mMessage; ///< the parsed message, NULL if parsing failed or connection closed
+    bool mClosed; ///< set if the connection was closed (last item)
+    int mErrNo; ///< errno when the connection was closed because of an error, 0 if closed by peer
+  } Received;
+  typedef SpscQueue<Received> ReceivedQueue;
+  typedef SpscQueue<string> SendQueue;
+
+  enum {
+    json, ///< JSON text
+    binary, ///< MessagePack
+    numEncodings
+  };
+
+  string mName; ///< name for logging
+  JSonMessageCB mMessageCB; ///< called on the mainloop for every received message, or with error
+  std::thread mThread; ///< the I/O thread
+  ReceivedQueue mReceived; ///< I/O thread -> mainloop
+  SendQueue mToSend; ///< mainloop -> I/O thread
+  std::deque<Received> mRxPending; ///< received messages waiting for space in mReceived (only accessed by I/O thread)
+  std::deque<string> mTxPending; ///< messages to send waiting for space in mToSend (only accessed from mainloop)
+  std::atomic<bool> mRxFull; ///< set by I/O thread when waiting for space in mReceived
+  std::atomic<bool> mTxFull; ///< set by mainloop when waiting for space in mToSend
+  std::atomic<bool> mStop; ///< set to make I/O thread terminate
+  bool mRunning; ///< set while I/O thread is running (only accessed from mainloop)
+  uint32_t mGeneration; ///< incremented on every start, to detect restarts while delivering
+  int mFd; ///< the I/O thread's own (dup'ed) socket fd
+  int mRxWakeFds[2]; ///< pipe to wake the mainloop when messages are received or there is space for sending again
+  int mIoWakeFds[2]; ///< pipe to wake the I/O thread when messages are to be sent, there is space for receiving again, or to stop
+  MLTicket mDeliverTicket; ///< for delivering received messages outside the poll handler
+  bool mBinarySend; ///< if set, messages are sent MessagePack encoded
+
+  /// @name statistics
+  /// @{
+  long mNumReceived; ///< number of messages received
+  long mNumSent; ///< number of messages sent
+  size_t mMaxBacklog; ///< max number of received messages waiting in the queue for the mainloop
+  long mNumEncoded[numEncodings]; ///< number of messages sent, per encoding
+  MLMicroSeconds mEncodeTime[numEncodings]; ///< accumulated time for encoding sent messages, per encoding
+  std::atomic<uint64_t> mBytesSent; ///< bytes written to the socket (by I/O thread)
+  std::atomic<uint64_t> mBytesReceived; ///< bytes read from the socket (by I/O thread)
+  std::atomic<long> mNumDecoded[numEncodings]; ///< number of messages received, per encoding (by I/O thread)
+  std::atomic<int64_t> mDecodeTime[numEncodings]; ///< accumulated time for parsing received messages, per encoding (by I/O thread)
+  /// @}
+
+public:
+
+  /// @param aName name of the connection (for logging)
+  JsonIoThread(const string aName);
+  virtual ~JsonIoThread();
+
+  virtual string logContextPrefix() override { return mName + " I/O"; }
+
+  /// @brief start I/O thread on a connected socket
+  /// @param aSocketFd the connected socket. It is dup'ed, and the original fd must no longer
+  ///   be read from or written to by the caller while the I/O thread is running. In particular,
+  ///   it must not be registered with the mainloop's poll handling any more.
+  /// @param aMessageCB will be called on the mainloop with every received message, with an error
+  ///   for messages that cannot be parsed, and with a SysError or TextError when the connection closes.
+  /// @return ok or error if I/O thread could not be started
+  ErrorPtr start(int aSocketFd, JSonMessageCB aMessageCB);
+
+  /// @brief stop the I/O thread, discarding not yet delivered received and not yet sent messages
+  void stop();
+
+  /// @return true if the I/O thread is running
+  bool isRunning() const { return mRunning; }
+
+  /// @brief enable or disable sending MessagePack encoded messages
+  /// @param aBinary if set, messages are sent MessagePack encoded, otherwise as JSON text
+  /// @note must only be enabled after the peer has agreed to receive MessagePack. Is reset to JSON at start().
+  void setBinarySend(bool aBinary) { mBinarySend = aBinary; }
+
+  /// @return true if messages are sent MessagePack encoded
+  bool binarySend() const { return mBinarySend; }
+
+  /// @brief send a message
+  /// @param aMessage the message to send
+  /// @return ok or error if I/O thread is not running
+  ErrorPtr sendMessage(JsonObjectPtr aMessage);
+
+  /// @return statistics as a single line of text, including bytes on the wire and
+  ///   encoding/parsing time per message for each encoding
+  string statistics();
+
+private:
+
+  void ioThread();
+  void received(JsonObjectPtr& aMessage);
+  bool handOverReceived();
+  void decoded(int aEncoding, MLMicroSeconds aStart);
+  bool rxWakeHandler(int aFD, int aPollFlags);
+  void deliver();
+  void handOverToSend();
+
+};
@@ -0,0 +1,327 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "msgpack.h"
+
+#include <stdint.h>
+#include <string.h>
+
+using namespace p44;
+
+// MARK: - item headers
+
+typedef enum {
+  mp_nil,
+  mp_false,
+  mp_true,
+  mp_uint,
+  mp_int,
+  mp_float32,
+  mp_float64,
+  mp_str,
+  mp_array,
+  mp_map
+} ItemType;
+
+typedef struct {
+  ItemType mType;
+  size_t mHeaderLen; ///< size of the item header, including fixed size values
+  uint64_t mLen; ///< str: number of bytes following the header, array/map: number of elements
+  uint64_t mValue; ///< numbers: the raw value bits
+} ItemHeader;
+
+
+static uint64_t getBE(const string& aData, size_t aPos, size_t aBytes)
+{
+  uint64_t v = 0;
+  for (size_t i=0; i<aBytes; i++) v = (v<<8) | (uint8_t)aData[aPos+i];
+  return v;
+}
+
+
+static void putBE(uint64_t aValue, size_t aBytes, string& aOutput)
+{
+  for (size_t i=aBytes; i>0; i--) aOutput += static_cast<char>((aValue>>(8*(i-1))) & 0xFF);
+}
+
+
+/// @return 1 if header is complete and valid, 0 if more data is needed, -1 if invalid
+static int getHeader(const string& aData, size_t aPos, ItemHeader& aHeader)
+{
+  if (aPos>=aData.size()) return 0;
+  uint8_t b = (uint8_t)aData[aPos];
+  size_t extra = 0; // number of bytes following the type byte
+  aHeader.mLen = 0;
+  aHeader.mValue = 0;
+  if (b<=0x7F) { aHeader.mType = mp_uint; aHeader.mValue = b; }
+  else if (b<=0x8F) { aHeader.mType = mp_map; aHeader.mLen = b & 0x0F; }
+  else if (b<=0x9F) { aHeader.mType = mp_array; aHeader.mLen = b & 0x0F; }
+  else if (b<=0xBF) { aHeader.mType = mp_str; aHeader.mLen = b & 0x1F; }
+  else if (b>=0xE0) { aHeader.mType = mp_int; aHeader.mValue = static_cast<uint64_t>(static_cast<int64_t>(static_cast<int8_t>(b))); }
+  else {
+    switch (b) {
+      case 0xC0: aHeader.mType = mp_nil; break;
+      case 0xC2: aHeader.mType = mp_false; break;
+      case 0xC3: aHeader.mType = mp_true; break;
+      case 0xCA: aHeader.mType = mp_float32; extra = 4; break;
+      case 0xCB: aHeader.mType = mp_float64; extra = 8; break;
+      case 0xCC: case 0xCD: case 0xCE: case 0xCF: aHeader.mType = mp_uint; extra = (size_t)1<<(b-0xCC); break;
+      case 0xD0: case 0xD1: case 0xD2: case 0xD3: aHeader.mType = mp_int; extra = (size_t)1<<(b-0xD0); break;
+      case 0xD9: case 0xDA: case 0xDB: aHeader.mType = mp_str; extra = (size_t)1<<(b-0xD9); break;
+      case 0xDC: case 0xDD: aHeader.mType = mp_array; extra = (size_t)2<<(b-0xDC); break;
+      case 0xDE: case 0xDF: aHeader.mType = mp_map; extra = (size_t)2<<(b-0xDE); break;
+      default: return -1; // bin, ext and never used types are not part of the JSON data model
+    }
+  }
+  aHeader.mHeaderLen = 1+extra;
+  if (aPos+aHeader.mHeaderLen>aData.size()) return 0;
+  if (extra>0) {
+    uint64_t v = getBE(aData, aPos+1, extra);
+    if (aHeader.mType==mp_str || aHeader.mType==mp_array || aHeader.mType==mp_map) {
+      aHeader.mLen = v;
+    }
+    else if (aHeader.mType==mp_int) {
+      // sign extend
+      if (extra<8 && (v & ((uint64_t)1<<(8*extra-1)))) v |= ~(((uint64_t)1<<(8*extra))-1);
+      aHeader.mValue = v;
+    }
+    else {
+      aHeader.mValue = v;
+    }
+  }
+  return 1;
+}
+
+
+// MARK: - MsgPack
+
+bool MsgPack::isMessageStart(uint8_t aByte)
+{
+  // fixmap, fixarray, array16/32, map16/32
+  return (aByte>=0x80 && aByte<=0x9F) || (aByte>=0xDC && aByte<=0xDF);
+}
+
+
+static void putInt(int64_t aValue, string& aOutput)
+{
+  if (aValue>=0) {
+    if (aValue<=0x7F) { aOutput += static_cast<char>(aValue); return; }
+    if (aValue<=0xFF) { aOutput += '\xCC'; putBE(static_cast<uint64_t>(aValue), 1, aOutput); return; }
+    if (aValue<=0xFFFF) { aOutput += '\xCD'; putBE(static_cast<uint64_t>(aValue), 2, aOutput); return; }
+    if (aValue<=0xFFFFFFFFLL) { aOutput += '\xCE'; putBE(static_cast<uint64_t>(aValue), 4, aOutput); return; }
+    aOutput += '\xCF'; putBE(static_cast<uint64_t>(aValue), 8, aOutput);
+    return;
+  }
+  if (aValue>=-32) { aOutput += static_cast<char>(aValue); return; }
+  if (aValue>=-128) { aOutput += '\xD0'; putBE(static_cast<uint64_t>(aValue), 1, aOutput); return; }
+  if (aValue>=-32768) { aOutput += '\xD1'; putBE(static_cast<uint64_t>(aValue), 2, aOutput); return; }
+  if (aValue>=-2147483648LL) { aOutput += '\xD2'; putBE(static_cast<uint64_t>(aValue), 4, aOutput); return; }
+  aOutput += '\xD3'; putBE(static_cast<uint64_t>(aValue), 8, aOutput);
+}
+
+
+static void putHeader(size_t aLen, uint8_t aFixType, size_t aFixLimit, uint8_t aType16, string& aOutput)
+{
+  if (aLen<aFixLimit) {
+    aOutput += static_cast<char>(aFixType | aLen);
+  }
+  else if (aFixLimit==32 && aLen<=0xFF) {
+    aOutput += '\xD9'; // str8 (there is no array8/map8)
+    putBE(aLen, 1, aOutput);
+  }
+  else if (aLen<=0xFFFF) {
+    aOutput += static_cast<char>(aType16);
+    putBE(aLen, 2, aOutput);
+  }
+  else {
+    aOutput += static_cast<char>(aType16+1);
+    putBE(aLen, 4, aOutput);
+  }
+}
+
+
+void MsgPack::encode(JsonObjectPtr aObj, string& aOutput)
+{
+  if (!aObj) {
+    aOutput += '\xC0';
+    return;
+  }
+  switch (aObj->type()) {
+    case json_type_null:
+      aOutput += '\xC0';
+      break;
+    case json_type_boolean:
+      aOutput += aObj->boolValue() ? '\xC3' : '\xC2';
+      break;
+    case json_type_int:
+      putInt(aObj->int64Value(), aOutput);
+      break;
+    case json_type_double: {
+      double v = aObj->doubleValue();
+      float f = static_cast<float>(v);
+      if (static_cast<double>(f)==v) {
+        // float32 is lossless
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        aOutput += '\xCA';
+        putBE(bits, 4, aOutput);
+      }
+      else {
+        uint64_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        aOutput += '\xCB';
+        putBE(bits, 8, aOutput);
+      }
+      break;
+    }
+    case json_type_string: {
+      string s = aObj->stringValue();
+      putHeader(s.size(), 0xA0, 32, 0xDA, aOutput);
+      aOutput += s;
+      break;
+    }
+    case json_type_array: {
+      int n = aObj->arrayLength();
+      putHeader(static_cast<size_t>(n), 0x90, 16, 0xDC, aOutput);
+      for (int i=0; i<n; i++) encode(aObj->arrayGet(i), aOutput);
+      break;
+    }
+    case json_type_object: {
+      // count first, the header precedes the elements
+      size_t n = 0;
+      string key;
+      JsonObjectPtr val;
+      aObj->resetKeyIteration();
+      while (aObj->nextKeyValue(key, val)) n++;
+      putHeader(n, 0x80, 16, 0xDE, aOutput);
+      aObj->resetKeyIteration();
+      while (aObj->nextKeyValue(key, val)) {
+        putHeader(key.size(), 0xA0, 32, 0xDA, aOutput);
+        aOutput += key;
+        encode(val, aOutput);
+      }
+      break;
+    }
+  }
+}
+
+
+static bool decodeItem(const string& aData, size_t& aPos, int aNesting, JsonObjectPtr& aObj)
+{
+  ItemHeader h;
+  if (getHeader(aData, aPos, h)!=1) return false;
+  aPos += h.mHeaderLen;
+  switch (h.mType) {
+    case mp_nil: aObj = JsonObject::newNull(); return true;
+    case mp_false: aObj = JsonObject::newBool(false); return true;
+    case mp_true: aObj = JsonObject::newBool(true); return true;
+    case mp_uint:
+      if (h.mValue>(uint64_t)INT64_MAX) aObj = JsonObject::newDouble(static_cast<double>(h.mValue));
+      else aObj = JsonObject::newInt64(static_cast<int64_t>(h.mValue));
+      return true;
+    case mp_int:
+      aObj = JsonObject::newInt64(static_cast<int64_t>(h.mValue));
+      return true;
+    case mp_float32: {
+      uint32_t bits = static_cast<uint32_t>(h.mValue);
+      float f;
+      memcpy(&f, &bits, sizeof(f));
+      aObj = JsonObject::newDouble(static_cast<double>(f));
+      return true;
+    }
+    case mp_float64: {
+      double d;
+      memcpy(&d, &h.mValue, sizeof(d));
+      aObj = JsonObject::newDouble(d);
+      return true;
+    }
+    case mp_str:
+      if (h.mLen>aData.size()-aPos) return false;
+      aObj = JsonObject::newString(aData.substr(aPos, static_cast<size_t>(h.mLen)));
+      aPos += static_cast<size_t>(h.mLen);
+      return true;
+    case mp_array:
+      if (aNesting>=MSGPACK_MAX_NESTING) return false;
+      aObj = JsonObject::newArray();
+      for (uint64_t i=0; i<h.mLen; i++) {
+        JsonObjectPtr elem;
+        if (!decodeItem(aData, aPos, aNesting+1, elem)) return false;
+        aObj->arrayAppend(elem);
+      }
+      return true;
+    case mp_map:
+      if (aNesting>=MSGPACK_MAX_NESTING) return false;
+      aObj = JsonObject::newObj();
+      for (uint64_t i=0; i<h.mLen; i++) {
+        JsonObjectPtr key, val;
+        if (!decodeItem(aData, aPos, aNesting+1, key) || !key->isType(json_type_string)) return false;
+        if (!decodeItem(aData, aPos, aNesting+1, val)) return false;
+        aObj->add(key->stringValue().c_str(), val);
+      }
+      return true;
+  }
+  return false;
+}
+
+
+JsonObjectPtr MsgPack::decode(const string& aData)
+{
+  size_t pos = 0;
+  JsonObjectPtr obj;
+  if (!decodeItem(aData, pos, 0, obj) || pos!=aData.size()) return JsonObjectPtr();
+  return obj;
+}
+
+
+// MARK: - MsgPackScanner
+
+MsgPackScanner::Result MsgPackScanner::scan(const string& aData, size_t& aPos)
+{
+  while (true) {
+    ItemHeader h;
+    int res = getHeader(aData, aPos, h);
+    if (res<0) return invalid;
+    if (res==0) return incomplete;
+    if (h.mType==mp_str) {
+      // wait until the string is complete, and only then skip it
+      if (h.mLen>aData.size()-aPos-h.mHeaderLen) return incomplete;
+      aPos += h.mHeaderLen+static_cast<size_t>(h.mLen);
+    }
+    else {
+      aPos += h.mHeaderLen;
+    }
+    uint64_t children = h.mType==mp_map ? 2*h.mLen : (h.mType==mp_array ? h.mLen : 0);
+    if (children>0) {
+      // container with elements: these follow
+      if (children>UINT32_MAX || mRemaining.size()>=MSGPACK_MAX_NESTING) return invalid;
+      mRemaining.push_back(static_cast<uint32_t>(children));
+      continue;
+    }
+    // item is complete, count it in its container(s)
+    while (true) {
+      if (mRemaining.empty()) return complete; // top level item done
+      if (--mRemaining.back()>0) break;
+      mRemaining.pop_back(); // container is complete, counts as an item of the enclosing one
+    }
+  }
+}
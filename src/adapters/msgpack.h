@@ -0,0 +1,86 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "p44mbrd_common.h"
+
+#include "jsonobject.hpp"
+
+#include <vector>
+
+using namespace p44;
+
+#ifndef MSGPACK_MAX_NESTING
+  #define MSGPACK_MAX_NESTING 64 ///< max nesting depth of arrays/maps accepted in received messages
+#endif
+
+
+/// @brief MessagePack encoding and decoding of JSON messages
+/// Covers the JSON data model only: nil, bool, int, float, str, array and map with string keys.
+/// Floating point values are encoded as float32 when this is lossless, as float64 otherwise.
+class MsgPack
+{
+public:
+
+  /// @param aByte first byte of a message
+  /// @return true if this byte starts a MessagePack encoded message (map or array), which can never
+  ///   be the case for JSON text, so both encodings can be told apart on a per-message basis
+  static bool isMessageStart(uint8_t aByte);
+
+  /// @param aObj the object to encode (NULL is encoded as nil)
+  /// @param aOutput the encoded object is appended to this string
+  static void encode(JsonObjectPtr aObj, string& aOutput);
+
+  /// @param aData the data containing exactly one complete message
+  /// @return the decoded object, or NULL if the data is not a valid MessagePack message
+  static JsonObjectPtr decode(const string& aData);
+
+};
+
+
+/// @brief finds the end of MessagePack encoded messages in a stream
+/// Scans incrementally, so data can be fed as it arrives without scanning any byte more than once.
+class MsgPackScanner
+{
+  std::vector<uint32_t> mRemaining; ///< number of items still missing in each open array/map
+
+public:
+
+  typedef enum {
+    incomplete, ///< more data is needed
+    complete, ///< a message ends at the returned position
+    invalid ///< the data is not a valid MessagePack message
+  } Result;
+
+  /// @brief start scanning a new message
+  void reset() { mRemaining.clear(); }
+
+  /// @brief scan message data
+  /// @param aData the data, with the message starting at the position of the last reset()
+  /// @param aPos position to continue scanning at, updated to the end of what could be scanned
+  ///   (i.e. just after the message when complete)
+  /// @return scanning status
+  Result scan(const string& aData, size_t& aPos);
+
+};
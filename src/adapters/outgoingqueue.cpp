@@ -0,0 +1,175 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "outgoingqueue.h"
+
+using namespace p44;
+
+// MARK: - OutgoingQueue
+
+OutgoingQueue::OutgoingQueue(const string aName) :
+  mName(aName),
+  mMaxQueued(500),
+  mSending(false),
+  mNumSent(0),
+  mNumQueued(0),
+  mNumMerged(0),
+  mNumDropped(0),
+  mMaxDepth(0),
+  mNumDequeued(0),
+  mTotalWait(0),
+  mMaxWait(0)
+{
+}
+
+
+bool OutgoingQueue::canSend()
+{
+  return !mCanSendCB || mCanSendCB();
+}
+
+
+size_t OutgoingQueue::depth()
+{
+  size_t n = 0;
+  for (int p=0; p<numPriorities; p++) n += mQueues[p].size();
+  return n;
+}
+
+
+bool OutgoingQueue::send(Priority aPriority, SimpleCB aSender, const string aMergeKey, StatusCB aDiscardedCB)
+{
+  if (depth()==0 && !mSending && canSend()) {
+    // nothing waiting and peer keeps up: send right now
+    mNumSent++;
+    aSender();
+    return true;
+  }
+  MessageQueue& queue = mQueues[aPriority];
+  if (!aMergeKey.empty()) {
+    for (MessageQueue::iterator pos = queue.begin(); pos!=queue.end(); ++pos) {
+      if (pos->mMergeKey==aMergeKey) {
+        // replace the message in place, keeping its position and original queuing time
+        OLOG(LOG_DEBUG, "merging message '%s' into already queued one", aMergeKey.c_str());
+        QueuedMessage replaced = *pos;
+        pos->mSender = aSender;
+        pos->mDiscardedCB = aDiscardedCB;
+        mNumMerged++;
+        discarded(replaced, TextError::err("replaced by newer message '%s'", aMergeKey.c_str()));
+        return true;
+      }
+    }
+  }
+  if (depth()>=mMaxQueued && !dropLowerPriority(aPriority)) {
+    mNumDropped++;
+    OLOG(LOG_WARNING, "queue full (%zu messages), dropping new message of priority %d", depth(), (int)aPriority);
+    return false;
+  }
+  QueuedMessage msg;
+  msg.mSender = aSender;
+  msg.mDiscardedCB = aDiscardedCB;
+  msg.mMergeKey = aMergeKey;
+  msg.mQueuedAt = MainLoop::now();
+  queue.push_back(msg);
+  mNumQueued++;
+  size_t d = depth();
+  if (d>mMaxDepth) mMaxDepth = d;
+  OLOG(LOG_DEBUG, "peer busy, queued message of priority %d, %zu messages waiting", (int)aPriority, d);
+  return true;
+}
+
+
+bool OutgoingQueue::dropLowerPriority(Priority aPriority)
+{
+  for (int p=numPriorities-1; p>aPriority; p--) {
+    if (!mQueues[p].empty()) {
+      // drop the oldest message of the lowest priority
+      QueuedMessage dropped = mQueues[p].front();
+      mQueues[p].pop_front();
+      mNumDropped++;
+      OLOG(LOG_WARNING, "queue full, dropped oldest message of priority %d", p);
+      discarded(dropped, TextError::err("%s outgoing queue full, message dropped", mName.c_str()));
+      return true;
+    }
+  }
+  return false;
+}
+
+
+void OutgoingQueue::resume()
+{
+  if (mSending) return; // prevent recursion when sending causes resume()
+  mSending = true;
+  MLMicroSeconds now = MainLoop::now();
+  for (int p=0; p<numPriorities; p++) {
+    while (!mQueues[p].empty()) {
+      if (!canSend()) {
+        mSending = false;
+        return;
+      }
+      QueuedMessage msg = mQueues[p].front();
+      mQueues[p].pop_front();
+      MLMicroSeconds wait = now-msg.mQueuedAt;
+      mNumDequeued++;
+      mTotalWait += wait;
+      if (wait>mMaxWait) mMaxWait = wait;
+      mNumSent++;
+      msg.mSender();
+    }
+  }
+  mSending = false;
+}
+
+
+void OutgoingQueue::discarded(QueuedMessage& aMsg, ErrorPtr aReason)
+{
+  if (aMsg.mDiscardedCB) aMsg.mDiscardedCB(aReason);
+}
+
+
+void OutgoingQueue::clear(ErrorPtr aReason)
+{
+  size_t n = depth();
+  if (n==0) return;
+  OLOG(LOG_WARNING, "discarding %zu queued messages", n);
+  if (Error::isOK(aReason)) aReason = TextError::err("%s outgoing queue cleared, message discarded", mName.c_str());
+  // take the messages out first, discard callbacks might send new messages
+  MessageQueue discardedQueues[numPriorities];
+  for (int p=0; p<numPriorities; p++) discardedQueues[p].swap(mQueues[p]);
+  for (int p=0; p<numPriorities; p++) {
+    for (MessageQueue::iterator pos = discardedQueues[p].begin(); pos!=discardedQueues[p].end(); ++pos) {
+      discarded(*pos, aReason);
+    }
+  }
+}
+
+
+string OutgoingQueue::statistics()
+{
+  return string_format(
+    "sent: %ld, queued: %ld (avg wait %lld mS, max wait %lld mS), merged: %ld, dropped: %ld, currently queued: %zu, max queued: %zu",
+    mNumSent, mNumQueued,
+    (long long)(mNumDequeued>0 ? mTotalWait/mNumDequeued/MilliSecond : 0), (long long)(mMaxWait/MilliSecond),
+    mNumMerged, mNumDropped, depth(), mMaxDepth
+  );
+}
@@ -0,0 +1,129 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "p44mbrd_common.h"
+
+#include <deque>
+
+using namespace p44;
+
+
+/// @brief bounded, prioritized queue for outgoing bridge API messages
+/// Messages are sent immediately as long as the peer keeps up (as determined by the flow control
+/// callback, usually based on the number of unanswered calls). Otherwise, they are queued by
+/// priority, and sent when resume() is called (usually when an answer arrives). Queued messages
+/// with the same merge key are replaced by newer ones. When the queue is full, lower priority
+/// messages are dropped first. Messages that are never sent (dropped, replaced or discarded) get
+/// their discard callback called with an error, so callers waiting for an answer are not left hanging.
+class OutgoingQueue : public P44LoggingObj
+{
+  typedef P44LoggingObj inherited;
+
+public:
+
+  /// priority classes, highest first
+  typedef enum {
+    interactive, ///< user initiated commands
+    sync, ///< state synchronisation, queries, property updates
+    diagnostics, ///< logging and other diagnostic traffic
+    numPriorities
+  } Priority;
+
+  /// @return true if the peer can accept another message now
+  typedef boost::function<bool ()> CanSendCB;
+
+private:
+
+  typedef struct {
+    SimpleCB mSender; ///< actually sends the message
+    StatusCB mDiscardedCB; ///< called with an error when the message is discarded without being sent
+    string mMergeKey; ///< queued messages with same non-empty merge key are replaced by newer ones
+    MLMicroSeconds mQueuedAt; ///< when the message was queued
+  } QueuedMessage;
+  typedef std::deque<QueuedMessage> MessageQueue;
+
+  string mName; ///< name for logging
+  MessageQueue mQueues[numPriorities]; ///< one queue per priority
+  size_t mMaxQueued; ///< max number of messages queued in total
+  CanSendCB mCanSendCB; ///< flow control
+  bool mSending; ///< set while sending, to prevent recursion
+
+  /// @name statistics
+  /// @{
+  long mNumSent; ///< number of messages sent
+  long mNumQueued; ///< number of messages that had to be queued
+  long mNumMerged; ///< number of queued messages replaced by a newer one
+  long mNumDropped; ///< number of messages dropped because the queue was full
+  size_t mMaxDepth; ///< max number of queued messages seen
+  long mNumDequeued; ///< number of queued messages sent later
+  MLMicroSeconds mTotalWait; ///< accumulated wait time of queued messages sent later
+  MLMicroSeconds mMaxWait; ///< max wait time of a queued message
+  /// @}
+
+public:
+
+  /// @param aName name of the queue (for logging)
+  OutgoingQueue(const string aName);
+
+  virtual string logContextPrefix() override { return mName + " outgoing"; }
+
+  /// @param aCanSendCB flow control callback, returns true when the peer can accept another message now
+  void setFlowControl(CanSendCB aCanSendCB) { mCanSendCB = aCanSendCB; }
+
+  /// @param aMaxQueued max number of messages queued in total
+  void setMaxQueued(size_t aMaxQueued) { mMaxQueued = aMaxQueued; }
+
+  /// @brief send a message, immediately or queued
+  /// @param aPriority the priority class of the message
+  /// @param aSender callback that actually sends the message
+  /// @param aMergeKey if not empty, a still queued message with the same key is replaced by this one.
+  ///   Only use this for messages where only the latest one matters (e.g. setting the same property).
+  /// @param aDiscardedCB if set, this is called with an error when the message, once queued, is discarded
+  ///   without being sent (dropped for a higher priority message, replaced by a newer one, or cleared)
+  /// @return false if the message was dropped because the queue is full
+  /// @note when returning false, aDiscardedCB is NOT called, the caller must handle the error itself
+  bool send(Priority aPriority, SimpleCB aSender, const string aMergeKey = "", StatusCB aDiscardedCB = StatusCB());
+
+  /// @brief send queued messages as far as flow control permits
+  /// @note must be called when the peer might be able to accept messages again
+  void resume();
+
+  /// @brief discard all queued messages
+  /// @param aReason the error passed to the discard callbacks of the queued messages
+  void clear(ErrorPtr aReason = ErrorPtr());
+
+  /// @return number of messages currently queued
+  size_t depth();
+
+  /// @return statistics as a single line of text
+  string statistics();
+
+private:
+
+  bool canSend();
+  bool dropLowerPriority(Priority aPriority);
+  void discarded(QueuedMessage& aMsg, ErrorPtr aReason);
+
+};
@@ -26,6 +26,12 @@
 #if P44_ADAPTERS
 
 #include "p44devices.h"
+#include "adapters/apisocket.h"
+#include "stalldetector.h"
+#include "eventtrace.h"
+#include "adapters/apicapture.h"
+
+#include <algorithm>
 
 using namespace p44;
 
@@ -54,12 +60,14 @@ void P44_BridgeImpl::startup()
 
 void P44_BridgeImpl::reportCommissionable(bool aIsCommissionable)
 {
+  if (shardIndex()>0) return; // only the first shard represents the bridge in the API server
   api().setProperty("root", "x-p44-bridge.commissionable", JsonObject::newBool(aIsCommissionable));
 }
 
 
 void P44_BridgeImpl::updateCommissioningInfo(const string aQRCodeData, const string aManualPairingCode)
 {
+  if (shardIndex()>0) return; // only the first shard represents the bridge in the API server
   api().setProperty("root", "x-p44-bridge.qrcodedata", JsonObject::newString(aQRCodeData));
   api().setProperty("root", "x-p44-bridge.manualpairingcode", JsonObject::newString(aManualPairingCode));
 }
@@ -67,6 +75,7 @@ void P44_BridgeImpl::updateCommissioningInfo(const string aQRCodeData, const str
 
 void P44_BridgeImpl::setBridgeRunning(bool aRunning)
 {
+  if (shardIndex()>0) return; // only the first shard represents the bridge in the API server
   api().setProperty("root", "x-p44-bridge.started", JsonObject::newBool(aRunning));
 }
 
@@ -93,7 +102,13 @@ void P44_BridgeImpl::identifyBridge(int aDurationS)
 
 void P44_BridgeImpl::cleanup()
 {
-  api().closeConnection();
+  api().supervisor().stop();
+  api().dispatchQueue().clear();
+  mGroupedNotificationsTicket.cancel();
+  mGroupedNotifications.clear();
+  mArrivingDevicesTicket.cancel();
+  mArrivingDSUIDs.clear();
+  api().disconnectBridgeApi();
   inherited::cleanup();
 }
 
@@ -114,6 +129,63 @@ bool P44_BridgeImpl::hasModelFeature(JsonObjectPtr aDeviceInfo, const char* aMod
 }
 
 
+// MARK: grouped notifications
+
+void P44_BridgeImpl::notifyGrouped(const string aNotification, JsonObjectPtr aParams, const string aDSUID)
+{
+  if (!aParams) aParams = JsonObject::newObj();
+  string key = aParams->json_str();
+  // find the last group with identical notification the device can join without changing
+  // the order of notifications for that device (must not be before any notification already queued for the device)
+  GroupedNotificationsList::iterator joinPos = mGroupedNotifications.end();
+  for (GroupedNotificationsList::iterator pos = mGroupedNotifications.begin(); pos!=mGroupedNotifications.end(); ++pos) {
+    if (std::find(pos->mDSUIDs.begin(), pos->mDSUIDs.end(), aDSUID)!=pos->mDSUIDs.end()) {
+      // device already has a notification here, can only join later groups
+      joinPos = mGroupedNotifications.end();
+    }
+    else if (pos->mNotification==aNotification && pos->mParamsKey==key) {
+      joinPos = pos;
+    }
+  }
+  if (joinPos!=mGroupedNotifications.end()) {
+    joinPos->mDSUIDs.push_back(aDSUID);
+  }
+  else {
+    GroupedNotification gn;
+    gn.mNotification = aNotification;
+    gn.mParamsKey = key;
+    gn.mParams = aParams;
+    gn.mDSUIDs.push_back(aDSUID);
+    mGroupedNotifications.push_back(gn);
+  }
+  if (!mGroupedNotificationsTicket) {
+    mGroupedNotificationsTicket.executeOnce(boost::bind(&P44_BridgeImpl::sendGroupedNotifications, this), P44_NOTIFICATION_GROUPING_WINDOW);
+  }
+}
+
+
+void P44_BridgeImpl::sendGroupedNotifications()
+{
+  mGroupedNotificationsTicket.cancel();
+  while (!mGroupedNotifications.empty()) {
+    GroupedNotification& gn = mGroupedNotifications.front();
+    if (gn.mDSUIDs.size()==1) {
+      gn.mParams->add("dSUID", JsonObject::newString(gn.mDSUIDs.front()));
+    }
+    else {
+      JsonObjectPtr dsuids = JsonObject::newArray();
+      for (std::list<string>::iterator pos = gn.mDSUIDs.begin(); pos!=gn.mDSUIDs.end(); ++pos) {
+        dsuids->arrayAppend(JsonObject::newString(*pos));
+      }
+      gn.mParams->add("dSUID", dsuids);
+      OLOG(LOG_INFO, "sending '%s' to %zu devices at once", gn.mNotification.c_str(), gn.mDSUIDs.size());
+    }
+    api().notify(gn.mNotification, gn.mParams);
+    mGroupedNotifications.pop_front();
+  }
+}
+
+
 // MARK: zone handling
 
 void P44_BridgeImpl::addOrUpdateZone(DsZoneID aZoneID, const string aZoneName, bool aOverwriteName, UpdateMode aUpdateMode)
@@ -130,7 +202,9 @@ void P44_BridgeImpl::addOrUpdateZone(DsZoneID aZoneID, const string aZoneName, b
 // MARK: P44_BridgeImpl internals
 
 P44_BridgeImpl::P44_BridgeImpl() :
-  mConnectedOnce(false)
+  mConnectedOnce(false),
+  mOutputCommandInterval(P44_OUTPUT_COMMAND_INTERVAL),
+  mNumSupersededOutputCommands(0)
 {
   mBridgeApi.isMemberVariable();
 }
@@ -138,7 +212,7 @@ P44_BridgeImpl::P44_BridgeImpl() :
 
 void P44_BridgeImpl::setAPIParams(const string aApiHost, const string aApiService)
 {
-  api().setConnectionParams(aApiHost.c_str(), aApiService.c_str(), SOCK_STREAM);
+  setApiConnectionParams(api(), aApiHost, aApiService);
   api().setNotificationHandler(boost::bind(&P44_BridgeImpl::bridgeApiNotificationHandler, this, _1, _2));
 }
 
@@ -147,9 +221,9 @@ void P44_BridgeImpl::setAPIParams(const string aApiHost, const string aApiServic
 void P44_BridgeImpl::bridgeApiConnectedHandler(ErrorPtr aStatus)
 {
   if (Error::notOK(aStatus)) {
-    OLOG(LOG_WARNING, "bridge API connection error: %s", aStatus->text());
-    // TODO: better handling
-    // - re-enable all known devices for "bridged", disable those not found
+    OLOG(LOG_WARNING, "bridge API connection lost: %s", aStatus->text());
+    // all devices are unreachable now, until reconnect resyncs them
+    updateAllDevicesReachability(false);
     return;
   }
   else {
@@ -169,6 +243,7 @@ void P44_BridgeImpl::bridgeApiConnectedHandler(ErrorPtr aStatus)
 
 void P44_BridgeImpl::updateBridgeStatus(bool aStarted)
 {
+  if (shardIndex()>0) return; // only the first shard represents the bridge in the API server
   api().setProperty("root", "x-p44-bridge.bridgetype", JsonObject::newString("matter"));
   api().setProperty("root", "x-p44-bridge.qrcodedata", JsonObject::newString(""));
   api().setProperty("root", "x-p44-bridge.manualpairingcode", JsonObject::newString(""));
@@ -231,6 +306,13 @@ DevicePtr P44_BridgeImpl::bridgedDeviceFromJSON(JsonObjectPtr aDeviceJSON)
         std::list<DevicePtr> devices;
         // determine basic parameters for single or composed device
         string dsuid = o->stringValue();
+        if (isSharded()) {
+          int zoneId = aDeviceJSON->get("zoneID", o) ? o->int32Value() : -1;
+          if (!isInShard(dsuid, zoneId)) {
+            OLOG(LOG_INFO, "device '%s' belongs to another shard, not bridged by this instance", dsuid.c_str());
+            return mainDevice; // none
+          }
+        }
         string name;
         if (aDeviceJSON->get("name", o)) name = o->stringValue(); // optional
         // extract mappable devices
@@ -558,6 +640,13 @@ void P44_BridgeImpl::bridgeApiCollectQueryHandler(ErrorPtr aError, JsonObjectPtr
     if (result->get("x-p44-deviceHardwareId", o)) {
       mSerial = o->stringValue();
     }
+    if (isSharded()) {
+      // each shard is a separate matter bridge, so it needs a distinct identity
+      string suffix = string_format("-shard%d", shardIndex());
+      mUID += suffix;
+      mSerial += suffix;
+      mLabel += string_format(" (%d)", shardIndex()+1);
+    }
     // process device list
     JsonObjectPtr vdcs;
     // devices
@@ -572,8 +661,8 @@ void P44_BridgeImpl::bridgeApiCollectQueryHandler(ErrorPtr aError, JsonObjectPtr
           string dn;
           JsonObjectPtr device;
           while(devices->nextKeyValue(dn, device)) {
-            // examine device
-            DevicePtr dev = bridgedDeviceFromJSON(device);
+            // examine device (in chunks, giving the mainloop a chance to do other things in between)
+            mBulkWork.dispatch(boost::bind(&P44_BridgeImpl::bridgedDeviceFromJSON, this, device));
           }
         }
       }
@@ -601,8 +690,8 @@ void P44_BridgeImpl::bridgeApiCollectQueryHandler(ErrorPtr aError, JsonObjectPtr
   );
   addOrReplaceAction(testAction, UpdateMode());
   */
-  // report started (ONCE!)
-  startupComplete(ErrorPtr());
+  // report started (ONCE!), after all devices are processed
+  mBulkWork.dispatch(boost::bind(&P44_BridgeImpl::startupComplete, this, ErrorPtr()));
 }
 
 
@@ -611,7 +700,7 @@ void P44_BridgeImpl::bridgeApiCollectQueryHandler(ErrorPtr aError, JsonObjectPtr
 void P44_BridgeImpl::updateAllZoneDependencies(UpdateMode aUpdateMode)
 {
   for (ZoneMap::iterator zpos = mZoneMap.begin(); zpos!=mZoneMap.end(); ++zpos) {
-    updateZoneDependencies(zpos->first, aUpdateMode);
+    mBulkWork.dispatch(boost::bind(&P44_BridgeImpl::updateZoneDependencies, this, zpos->first, aUpdateMode));
   }
 }
 
@@ -675,9 +764,12 @@ void P44SceneAction::invoke(Optional<uint16_t> aTransitionTime)
 
 // MARK: - reconnect bridge API
 
+// Note: the bridge API has no way to query only what has changed since a given point in time,
+//   so we query the minimal set of properties that determine bridging/reachability/naming for all
+//   devices, and then only act on the differences to what we know (delta resync).
 #define RECONNECT_DEVICE_PROPERTIES \
   "{\"dSUID\":null, " \
-  "\"active\":null, " \
+  "\"active\":null, \"name\":null, \"zoneID\":null, \"x-p44-zonename\":null, " \
   "\"x-p44-bridgeable\":null, \"x-p44-bridged\":null, }"
 
 void P44_BridgeImpl::reconnectBridgedDevices()
@@ -697,53 +789,104 @@ void P44_BridgeImpl::reconnectBridgedDevices()
 void P44_BridgeImpl::bridgeApiReconnectQueryHandler(ErrorPtr aError, JsonObjectPtr aJsonMsg)
 {
   OLOG(LOG_DEBUG, "bridgeapi query after reconnect: status=%s, answer:\n%s", Error::text(aError), JsonObject::text(aJsonMsg));
-  JsonObjectPtr o;
   JsonObjectPtr result;
-  if (aJsonMsg && aJsonMsg->get("result", result)) {
-    // process device list
-    JsonObjectPtr vdcs;
-    if (result->get("x-p44-vdcs", vdcs)) {
-      vdcs->resetKeyIteration();
-      string vn;
-      JsonObjectPtr vdc;
-      while(vdcs->nextKeyValue(vn, vdc)) {
-        JsonObjectPtr devices;
-        if (vdc->get("x-p44-devices", devices)) {
-          devices->resetKeyIteration();
-          string dn;
-          JsonObjectPtr device;
-          while(devices->nextKeyValue(dn, device)) {
-            if (device->get("dSUID", o, true)) {
-              string dsuid = o->stringValue();
-              if (device->get("x-p44-bridgeable", o) && o->boolValue()) {
-                // is a bridgeable device, look it up
-                DeviceUIDMap::iterator devpos = mDeviceUIDMap.find(dsuid);
-                if (devpos!=mDeviceUIDMap.end()) {
-                  POLOG(devpos->second, LOG_NOTICE, "Continuing operation after API server reconnect");
-                  // we have that device registered, re-enable for bridging
-                  JsonObjectPtr params = JsonObject::newObj();
-                  params->add("dSUID", JsonObject::newString(dsuid));
-                  JsonObjectPtr props = JsonObject::newObj();
-                  props->add("x-p44-bridged", JsonObject::newBool(true));
-                  params->add("properties", props);
-                  api().call("setProperty", params, NoOP);
-                }
-                else {
-                  // we don't know this yet, add separately
-                  OLOG(LOG_NOTICE, "New device '%s' encountered after API server reconnect", dsuid.c_str());
-                  newDeviceGotBridgeable(dsuid);
-                }
-              }
-            }
-          }
+  if (!aJsonMsg || !aJsonMsg->get("result", result)) {
+    OLOG(LOG_ERR, "no valid answer for device status query after API server reconnect");
+    return;
+  }
+  mResyncStats = { 0, 0, 0, 0 };
+  // mark: process device list, check all devices we know (in chunks)
+  JsonObjectPtr vdcs;
+  if (result->get("x-p44-vdcs", vdcs)) {
+    vdcs->resetKeyIteration();
+    string vn;
+    JsonObjectPtr vdc;
+    while(vdcs->nextKeyValue(vn, vdc)) {
+      JsonObjectPtr devices;
+      if (vdc->get("x-p44-devices", devices)) {
+        devices->resetKeyIteration();
+        string dn;
+        JsonObjectPtr device;
+        while(devices->nextKeyValue(dn, device)) {
+          mBulkWork.dispatch(boost::bind(&P44_BridgeImpl::resyncDevice, this, device));
         }
       }
     }
-    // update status
-    updateBridgeStatus(hasBridgeableDevices()); // bridge is running when it has any bridgeable devices now
   }
-  // TODO: maybe find and disable those that are no longer visible in the brige API
-  OLOG(LOG_WARNING, "Reconnected devices after API server reconnect");
+  // sweep when all devices are processed
+  mBulkWork.dispatch(boost::bind(&P44_BridgeImpl::resyncComplete, this));
+}
+
+
+void P44_BridgeImpl::resyncDevice(JsonObjectPtr aDeviceJSON)
+{
+  JsonObjectPtr o;
+  if (aDeviceJSON->get("dSUID", o, true)) {
+    string dsuid = o->stringValue();
+    bool bridgeable = aDeviceJSON->get("x-p44-bridgeable", o) && o->boolValue();
+    DeviceUIDMap::iterator devpos = mDeviceUIDMap.find(dsuid);
+    if (devpos!=mDeviceUIDMap.end()) {
+      DevicePtr dev = devpos->second;
+      P44_DeviceImpl* impl = P44_DeviceImpl::impl(dev);
+      impl->markSeen();
+      if (bridgeable && (dev->endpointId()==kInvalidEndpointId || !isEndpointEnabled(dev->endpointId()))) {
+        // device had vanished before, but is back now -> re-add
+        POLOG(dev, LOG_NOTICE, "Re-appeared after API server reconnect");
+        newDeviceGotBridgeable(dsuid);
+        mResyncStats.mNew++;
+        return;
+      }
+      // apply changes in reachability, bridgeability, name and zone (only actual changes get reported to matter)
+      impl->handleBridgePushProperties(aDeviceJSON);
+      if (bridgeable && !(aDeviceJSON->get("x-p44-bridged", o) && o->boolValue())) {
+        // API server does not know it is bridged (e.g. after restart) -> re-enable for bridging
+        POLOG(dev, LOG_NOTICE, "Continuing operation after API server reconnect");
+        JsonObjectPtr params = JsonObject::newObj();
+        params->add("dSUID", JsonObject::newString(dsuid));
+        JsonObjectPtr props = JsonObject::newObj();
+        props->add("x-p44-bridged", JsonObject::newBool(true));
+        params->add("properties", props);
+        api().call("setProperty", params, NoOP);
+        mResyncStats.mRebridged++;
+      }
+      else {
+        mResyncStats.mUnchanged++;
+      }
+    }
+    else if (bridgeable && isInShard(dsuid, aDeviceJSON->get("zoneID", o) ? o->int32Value() : -1)) {
+      // we don't know this yet, add separately
+      OLOG(LOG_NOTICE, "New device '%s' encountered after API server reconnect", dsuid.c_str());
+      newDeviceGotBridgeable(dsuid);
+      mResyncStats.mNew++;
+    }
+  }
+}
+
+
+void P44_BridgeImpl::resyncComplete()
+{
+  if (!api().supervisor().isConnected()) {
+    // connection lost again while resynchronizing, next reconnect will resync again
+    OLOG(LOG_WARNING, "API server connection lost during resynchronisation, not sweeping");
+    return;
+  }
+  // sweep: disable devices that are no longer present in the bridge API
+  for (DeviceUIDMap::iterator pos = mDeviceUIDMap.begin(); pos!=mDeviceUIDMap.end(); ++pos) {
+    DevicePtr dev = pos->second;
+    if (!P44_DeviceImpl::impl(dev)->checkAndClearSeen()) {
+      if (dev->endpointId()!=kInvalidEndpointId && isEndpointEnabled(dev->endpointId())) {
+        POLOG(dev, LOG_NOTICE, "Vanished while API server was disconnected");
+        P44_DeviceImpl::impl(dev)->handleBridgeNotification("vanish", JsonObjectPtr());
+        mResyncStats.mVanished++;
+      }
+    }
+  }
+  // update status
+  updateBridgeStatus(hasBridgeableDevices()); // bridge is running when it has any bridgeable devices now
+  OLOG(LOG_WARNING,
+    "Resynchronized devices after API server reconnect: %d unchanged, %d re-bridged, %d new, %d vanished",
+    mResyncStats.mUnchanged, mResyncStats.mRebridged, mResyncStats.mNew, mResyncStats.mVanished
+  );
 }
 
 
@@ -765,6 +908,18 @@ void P44_BridgeImpl::bridgeApiNotificationHandler(ErrorPtr aError, JsonObjectPtr
         if (aJsonMsg->get("notification", o, true)) {
           string notification = o->stringValue();
           POLOG(devpos->second, LOG_INFO, "Notification '%s' received: %s", notification.c_str(), JsonObject::text(aJsonMsg));
+          DevicePtr dev = devpos->second;
+          JsonObjectPtr props;
+          if (
+            notification=="pushNotification" &&
+            aJsonMsg->get("changedproperties", props, true) && props->get("x-p44-bridgeable", o) && o->boolValue() &&
+            dev->endpointId()!=kInvalidEndpointId && !isEndpointEnabled(dev->endpointId())
+          ) {
+            // device had vanished before, but is bridgeable again -> re-add with current info
+            POLOG(dev, LOG_NOTICE, "Re-appeared");
+            newDeviceGotBridgeable(targetDSUID);
+            return;
+          }
           bool handled = P44_DeviceImpl::impl(devpos->second)->handleBridgeNotification(notification, aJsonMsg);
           if (handled) {
             POLOG(devpos->second, LOG_INFO, "processed notification");
@@ -791,7 +946,8 @@ void P44_BridgeImpl::bridgeApiNotificationHandler(ErrorPtr aError, JsonObjectPtr
             }
           }
         }
-        OLOG(LOG_ERR, "request targeting unknown device %s", targetDSUID.c_str());
+        // Note: when sharded, devices of other shards are unknown here, which is normal
+        OLOG(isSharded() ? LOG_DEBUG : LOG_ERR, "request targeting unknown device %s", targetDSUID.c_str());
       }
     }
     else {
@@ -837,6 +993,19 @@ void P44_BridgeImpl::handleGlobalNotification(const string notification, JsonObj
         LOG(LOG_NOTICE, "\n========== requested showing statistics");
         LOG(LOG_NOTICE, "\n%s", MainLoop::currentMainLoop().description().c_str());
         MainLoop::currentMainLoop().statistics_reset();
+        LOG(LOG_NOTICE, "memory usage: %s", memoryUsageInfo().c_str());
+        LOG(LOG_NOTICE, "bridge API connection: %s", api().supervisor().statistics().c_str());
+        LOG(LOG_NOTICE, "bridge API message dispatch: %s", api().dispatchQueue().statistics().c_str());
+        LOG(LOG_NOTICE, "bridge API I/O thread: %s", api().ioThread().statistics().c_str());
+        LOG(LOG_NOTICE, "bridge API traffic: %s", api().trafficMeter().statistics().c_str());
+        LOG(LOG_NOTICE, "bridge API outgoing queue: %s", api().outgoingQueue().statistics().c_str());
+        LOG(LOG_NOTICE, "output commands superseded by newer values: %ld", mNumSupersededOutputCommands);
+        mNumSupersededOutputCommands = 0;
+        LOG(LOG_NOTICE, "external attribute cache: %s", AttributeCache::statistics().c_str());
+        AttributeCache::resetStatistics();
+        LOG(LOG_NOTICE, "mainloop stalls: %s", StallDetector::sharedDetector().statistics().c_str());
+        StallDetector::sharedDetector().reset();
+        api().trafficMeter().reset();
         LOG(LOG_NOTICE, "========== statistics shown\n");
       }
       else if (newAppLogLevel>=0 && newAppLogLevel<=7) {
@@ -853,6 +1022,8 @@ void P44_BridgeImpl::handleGlobalNotification(const string notification, JsonObj
       LOG(LOG_NOTICE, "\n\n========== changing CHIP log level from %d to %d ===============", (int)chip::Logging::GetLogFilter(), newChipLogLevel);
       chip::Logging::SetLogFilter((uint8_t)newChipLogLevel);
     }
+    if ((o = aJsonMsg->get("trace"))) EventTrace::sharedTrace().enable(o->boolValue());
+    if ((o = aJsonMsg->get("capture"))) ApiCapture::sharedCapture().enable(o->boolValue());
     if ((o = aJsonMsg->get("deltas"))) SETDELTATIME(o->boolValue());
     #if ENABLE_LOG_COLORS
     if ((o = aJsonMsg->get("symbols"))) SETLOGSYMBOLS(o->boolValue());
@@ -865,13 +1036,80 @@ void P44_BridgeImpl::handleGlobalNotification(const string notification, JsonObj
 
 void P44_BridgeImpl::newDeviceGotBridgeable(string aNewDeviceDSUID)
 {
-  JsonObjectPtr params = JsonObject::objFromText(
-    "{ \"query\": "
-    NEEDED_DEVICE_PROPERTIES
-    "}"
-  );
-  params->add("dSUID", JsonObject::newString(aNewDeviceDSUID));
-  api().call("getProperty", params, boost::bind(&P44_BridgeImpl::newDeviceInfoQueryHandler, this, _1, _2));
+  // collect devices getting bridgeable in bulk (e.g. after a bus scan) to query their info in one call
+  for (std::list<string>::iterator pos = mArrivingDSUIDs.begin(); pos!=mArrivingDSUIDs.end(); ++pos) {
+    if (*pos==aNewDeviceDSUID) return; // already waiting for query
+  }
+  mArrivingDSUIDs.push_back(aNewDeviceDSUID);
+  if (!mArrivingDevicesTicket) {
+    mArrivingDevicesTicket.executeOnce(boost::bind(&P44_BridgeImpl::queryArrivingDevices, this), P44_DEVICE_ARRIVAL_WINDOW);
+  }
+}
+
+
+void P44_BridgeImpl::queryArrivingDevices()
+{
+  mArrivingDevicesTicket.cancel();
+  if (mArrivingDSUIDs.empty()) return;
+  if (mArrivingDSUIDs.size()==1) {
+    // single device, query it directly
+    JsonObjectPtr params = JsonObject::objFromText(
+      "{ \"query\": "
+      NEEDED_DEVICE_PROPERTIES
+      "}"
+    );
+    params->add("dSUID", JsonObject::newString(mArrivingDSUIDs.front()));
+    api().call("getProperty", params, boost::bind(&P44_BridgeImpl::newDeviceInfoQueryHandler, this, _1, _2));
+  }
+  else {
+    // multiple devices, query them all at once from root, by dSUID
+    OLOG(LOG_NOTICE, "%zu devices got bridgeable, querying their info in one call", mArrivingDSUIDs.size());
+    JsonObjectPtr devices = JsonObject::newObj();
+    for (std::list<string>::iterator pos = mArrivingDSUIDs.begin(); pos!=mArrivingDSUIDs.end(); ++pos) {
+      devices->add(pos->c_str(), JsonObject::objFromText(NEEDED_DEVICE_PROPERTIES));
+    }
+    JsonObjectPtr vdc = JsonObject::newObj();
+    vdc->add("x-p44-devices", devices);
+    JsonObjectPtr vdcs = JsonObject::newObj();
+    vdcs->add("*", vdc);
+    JsonObjectPtr query = JsonObject::newObj();
+    query->add("x-p44-vdcs", vdcs);
+    JsonObjectPtr params = JsonObject::newObj();
+    params->add("dSUID", JsonObject::newString("root"));
+    params->add("query", query);
+    api().call("getProperty", params, boost::bind(&P44_BridgeImpl::arrivingDevicesQueryHandler, this, _1, _2));
+  }
+  mArrivingDSUIDs.clear();
+}
+
+
+void P44_BridgeImpl::arrivingDevicesQueryHandler(ErrorPtr aError, JsonObjectPtr aJsonMsg)
+{
+  OLOG(LOG_INFO, "bridgeapi query for multiple additional devices: status=%s", Error::text(aError));
+  JsonObjectPtr result;
+  if (aJsonMsg && aJsonMsg->get("result", result)) {
+    JsonObjectPtr vdcs;
+    if (result->get("x-p44-vdcs", vdcs)) {
+      vdcs->resetKeyIteration();
+      string vn;
+      JsonObjectPtr vdc;
+      while(vdcs->nextKeyValue(vn, vdc)) {
+        JsonObjectPtr devices;
+        if (vdc->get("x-p44-devices", devices)) {
+          devices->resetKeyIteration();
+          string dn;
+          JsonObjectPtr device;
+          while(devices->nextKeyValue(dn, device)) {
+            // Note: all devices bridged from this call stack get installed together
+            DevicePtr dev = bridgedDeviceFromJSON(device);
+            if (dev) {
+              bridgeAdditionalDevice(dev);
+            }
+          }
+        }
+      }
+    }
+  }
 }
 
 
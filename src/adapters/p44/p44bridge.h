@@ -29,6 +29,19 @@
 
 #include "adapters/p44/p44bridgeapi.h"
 
+#ifndef P44_NOTIFICATION_GROUPING_WINDOW
+  #define P44_NOTIFICATION_GROUPING_WINDOW (50*MilliSecond) ///< time window for collecting identical notifications to multiple devices
+#endif
+#ifndef P44_OUTPUT_COMMAND_INTERVAL
+  #define P44_OUTPUT_COMMAND_INTERVAL (100*MilliSecond) ///< default min interval between output value commands to the same device channel
+#endif
+#ifndef P44_DEVICE_ARRIVAL_WINDOW
+  #define P44_DEVICE_ARRIVAL_WINDOW (100*MilliSecond) ///< time window for collecting devices getting bridgeable, to query their info in one call
+#endif
+#ifndef P44_TRANSITION_NEARLY_DONE
+  #define P44_TRANSITION_NEARLY_DONE (300*MilliSecond) ///< a transition ending within this time is not interrupted by a throttled command
+#endif
+
 
 // MARK: - P44_BridgeImpl
 
@@ -49,6 +62,32 @@ class P44_BridgeImpl : public BridgeAdapter, public P44LoggingObj
   string mModel;
   string mSerial;
 
+  /// a notification to be sent to one or multiple devices at once
+  typedef struct {
+    string mNotification; ///< the notification
+    string mParamsKey; ///< the JSON text of the params (without dSUID), for identifying identical notifications
+    JsonObjectPtr mParams; ///< the params
+    std::list<string> mDSUIDs; ///< the devices to send the notification to
+  } GroupedNotification;
+  typedef std::list<GroupedNotification> GroupedNotificationsList;
+  GroupedNotificationsList mGroupedNotifications; ///< notifications collected for sending in groups
+  MLTicket mGroupedNotificationsTicket; ///< timer for sending collected notifications
+
+  std::list<string> mArrivingDSUIDs; ///< devices that got bridgeable, info not yet queried
+  MLTicket mArrivingDevicesTicket; ///< timer for querying info of the arriving devices
+
+  /// counters for resynchronisation after reconnect
+  typedef struct {
+    int mUnchanged;
+    int mRebridged;
+    int mNew;
+    int mVanished;
+  } ResyncStats;
+  ResyncStats mResyncStats;
+
+  MLMicroSeconds mOutputCommandInterval; ///< min interval between output value commands to the same device channel, 0=no throttling
+  long mNumSupersededOutputCommands; ///< number of output value commands dropped because a newer value superseded them
+
 public:
 
   typedef std::map<DsZoneID, string> ZoneMap;
@@ -139,6 +178,24 @@ public:
   /// utility function to check model feature presence
   static bool hasModelFeature(JsonObjectPtr aDeviceInfo, const char* aModelFeature);
 
+  /// @brief send a notification to a device, grouped with identical notifications to other devices
+  /// @param aNotification the notification name
+  /// @param aParams the notification params (without dSUID)
+  /// @param aDSUID the dSUID of the device to send the notification to
+  /// @note notifications are collected for P44_NOTIFICATION_GROUPING_WINDOW, and then sent as a single
+  ///   notification addressing all devices with identical params (bridge API accepts dSUID arrays for notifications).
+  ///   Per-device order of notifications is preserved.
+  void notifyGrouped(const string aNotification, JsonObjectPtr aParams, const string aDSUID);
+
+  /// @param aInterval min interval between output value commands to the same device channel, 0=no throttling
+  void setOutputCommandInterval(MLMicroSeconds aInterval) { mOutputCommandInterval = aInterval; }
+
+  /// @return min interval between output value commands to the same device channel
+  MLMicroSeconds outputCommandInterval() { return mOutputCommandInterval; }
+
+  /// count an output value command dropped because a newer value superseded it
+  void countSupersededOutputCommand() { mNumSupersededOutputCommands++; }
+
 
 private:
 
@@ -150,9 +207,14 @@ private:
   void bridgeApiCollectQueryHandler(ErrorPtr aError, JsonObjectPtr aJsonMsg);
   void reconnectBridgedDevices();
   void bridgeApiReconnectQueryHandler(ErrorPtr aError, JsonObjectPtr aJsonMsg);
+  void resyncDevice(JsonObjectPtr aDeviceJSON);
+  void resyncComplete();
   void handleGlobalNotification(const string notification, JsonObjectPtr aJsonMsg);
   void newDeviceGotBridgeable(string aNewDeviceDSUID);
   void newDeviceInfoQueryHandler(ErrorPtr aError, JsonObjectPtr aJsonMsg);
+  void queryArrivingDevices();
+  void arrivingDevicesQueryHandler(ErrorPtr aError, JsonObjectPtr aJsonMsg);
+  void sendGroupedNotifications();
 
 };
 
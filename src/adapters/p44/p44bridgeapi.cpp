@@ -22,52 +22,186 @@
 //
 
 #include "p44bridgeapi.h"
+#include "adapters/apisocket.h"
+#include "stalldetector.h"
+#include "eventtrace.h"
+#include "adapters/apicapture.h"
 
 #if P44_ADAPTERS
 
 using namespace p44;
 
 P44BridgeApi::P44BridgeApi() :
-  mBridgeCallCounter(0)
+  mIoThread("bridge API"),
+  mSupervisor("bridge API"),
+  mDispatchQueue("bridge API"),
+  mOutgoingQueue("bridge API"),
+  mBridgeCallCounter(0),
+  mOfferBinary(false)
 {
+  mOutgoingQueue.setMaxQueued(P44_MAX_QUEUED_MESSAGES);
+  mOutgoingQueue.setFlowControl(boost::bind(&P44BridgeApi::canSend, this));
 }
   
 void P44BridgeApi::connectBridgeApi(StatusCB aConnectedCB)
 {
   mConnectedCB = aConnectedCB;
-  tryConnection();
+  mSupervisor.setHandlers(
+    boost::bind(&P44BridgeApi::tryConnection, this),
+    boost::bind(&P44BridgeApi::probe, this, _1),
+    boost::bind(&P44BridgeApi::connectionLost, this, _1)
+  );
+  mSupervisor.connect();
+}
+
+
+void P44BridgeApi::disconnectBridgeApi()
+{
+  mIoStartTicket.cancel();
+  mIoThread.stop();
+  closeConnection();
 }
 
 
 void P44BridgeApi::tryConnection()
 {
+  // Note: the socket is only used for connecting, reading and writing is done by the I/O thread
   setConnectionStatusHandler(boost::bind(&P44BridgeApi::connectionStatusHandler, this, _2));
-  setMessageHandler(boost::bind(&P44BridgeApi::messageHandler, this, _1, _2));
   initiateConnection();
 }
 
 void P44BridgeApi::connectionStatusHandler(ErrorPtr aStatus)
 {
-  if (Error::notOK(aStatus)) {
-    LOG(LOG_WARNING, "Could not reach bridge API: %s -> trying again in 5 seconds", aStatus->text());
-    mApiRetryTicket.executeOnce(boost::bind(&P44BridgeApi::tryConnection, this), 5*Second);
+  if (Error::isOK(aStatus)) {
+    aStatus = checkApiPeerCredentials(*this);
+    if (Error::notOK(aStatus)) {
+      LOG(LOG_ERR, "bridge API: rejecting connection: %s", aStatus->text());
+      closeConnection();
+    }
+    else {
+      // SocketComm sets up its own poll handling for the connected socket around calling this handler,
+      // so take over the socket only afterwards (zero delay timers run before the next poll)
+      mIoStartTicket.executeOnce(boost::bind(&P44BridgeApi::startIo, this), 0);
+      return;
+    }
+  }
+  mIoStartTicket.cancel();
+  // supervisor will retry with backoff
+  mSupervisor.connectionFailed(aStatus);
+}
+
+
+void P44BridgeApi::startIo()
+{
+  mIoStartTicket.cancel();
+  // from now on, only the I/O thread may react to data on the socket, so the mainloop must not poll it any more
+  MainLoop::currentMainLoop().unregisterPollHandler(getFd());
+  ErrorPtr err = mIoThread.start(getFd(), boost::bind(&P44BridgeApi::ioHandler, this, _1, _2));
+  if (Error::notOK(err)) {
+    closeConnection();
+    // supervisor will retry with backoff
+    mSupervisor.connectionFailed(err);
     return;
   }
-  else {
-    // connection ok
-    if (mConnectedCB) {
-      StatusCB cb = mConnectedCB;
-      cb(aStatus);
+  // connection ok
+  mSupervisor.connectionEstablished();
+  if (mOfferBinary) negotiateEncoding();
+  if (mConnectedCB) {
+    StatusCB cb = mConnectedCB;
+    cb(err);
+  }
+}
+
+
+void P44BridgeApi::connectionLost(ErrorPtr aError)
+{
+  // make sure connection is closed (peer might just be stalled)
+  disconnectBridgeApi();
+  // received messages not yet processed are from the lost connection
+  mDispatchQueue.clear();
+  // answers to pending calls will never arrive
+  if (!mPendingBridgeCalls.empty()) {
+    LOG(LOG_WARNING, "bridge API: discarding %zu pending calls", mPendingBridgeCalls.size());
+    // take the calls out first, callbacks might issue new calls
+    PendingBridgeCalls lostCalls;
+    lostCalls.swap(mPendingBridgeCalls);
+    for (PendingBridgeCalls::iterator pos = lostCalls.begin(); pos!=lostCalls.end(); ++pos) {
+      if (pos->mCallback) pos->mCallback(TextError::err("bridge API connection lost, no answer to call '%s'", pos->mMethod.c_str()), JsonObjectPtr());
     }
+  }
+  // queued messages are outdated, resync after reconnect will take care
+  mOutgoingQueue.clear(TextError::err("bridge API connection lost, queued message discarded"));
+  if (mConnectedCB) {
+    StatusCB cb = mConnectedCB;
+    cb(aError);
+  }
+}
+
+
+void P44BridgeApi::negotiateEncoding()
+{
+  JsonObjectPtr params = JsonObject::newObj();
+  params->add("encoding", JsonObject::newString("msgpack"));
+  call("x-p44-setEncoding", params, boost::bind(&P44BridgeApi::encodingAnswer, this, _1, _2), OutgoingQueue::interactive);
+}
+
+
+void P44BridgeApi::encodingAnswer(ErrorPtr aError, JsonObjectPtr aJsonMsg)
+{
+  JsonObjectPtr result, o;
+  if (Error::isOK(aError) && aJsonMsg && aJsonMsg->get("result", result) && result->get("encoding", o) && o->stringValue()=="msgpack") {
+    LOG(LOG_NOTICE, "bridge API: peer agreed to MessagePack encoding, sending binary messages from now on");
+    mIoThread.setBinarySend(true);
+  }
+  else {
+    LOG(LOG_INFO, "bridge API: peer does not support MessagePack encoding, continuing with JSON");
+  }
+}
+
+
+void P44BridgeApi::probe(StatusCB aProbeResultCB)
+{
+  JsonObjectPtr params = JsonObject::objFromText("{ \"dSUID\":\"root\", \"query\":{ \"dSUID\":null } }");
+  call("getProperty", params, boost::bind(&P44BridgeApi::probeAnswer, this, aProbeResultCB, _1, _2), OutgoingQueue::interactive);
+}
+
+
+void P44BridgeApi::probeAnswer(StatusCB aProbeResultCB, ErrorPtr aError, JsonObjectPtr aJsonMsg)
+{
+  // only actual answers from the peer count, not local sending errors
+  if (Error::isOK(aError) && aProbeResultCB) aProbeResultCB(aError);
+}
+
+void P44BridgeApi::ioHandler(ErrorPtr aError, JsonObjectPtr aJsonObject)
+{
+  if (Error::notOK(aError) && !mIoThread.isRunning()) {
+    // I/O thread has terminated because connection was closed
+    closeConnection();
+    mSupervisor.connectionFailed(aError);
     return;
   }
+  messageHandler(aError, aJsonObject);
 }
 
+
 void P44BridgeApi::messageHandler(ErrorPtr aError, JsonObjectPtr aJsonObject)
 {
   if (Error::isOK(aError)) {
+    mSupervisor.activity();
+    mTrafficMeter.received(aJsonObject);
+    if (ApiCapture::enabled()) ApiCapture::sharedCapture().capture(ApiCapture::p44, ApiCapture::received, aJsonObject);
+  }
+  mDispatchQueue.dispatch(boost::bind(&P44BridgeApi::processMessage, this, aError, aJsonObject));
+}
+
+
+void P44BridgeApi::processMessage(ErrorPtr aError, JsonObjectPtr aJsonObject)
+{
+  if (Error::isOK(aError)) {
+    MLMicroSeconds start = MainLoop::now();
     //LOG(LOG_DEBUG, "msg = %s", aJsonObject->json_c_str());
     JsonObjectPtr o;
+    string method; // method of the call answered, empty for notifications
     if (aJsonObject && aJsonObject->get("id", o)) {
       // this IS a method answer
       string callid = o->stringValue();
@@ -76,16 +210,41 @@ void P44BridgeApi::messageHandler(ErrorPtr aError, JsonObjectPtr aJsonObject)
         if (pos->mCallId==callid) {
           // answer matching pending call
           cb = pos->mCallback;
+          method = pos->mMethod;
           mPendingBridgeCalls.erase(pos);
           break;
         }
       }
+      // peer has capacity for another call now
+      mOutgoingQueue.resume();
       if (cb) cb(ErrorPtr(), aJsonObject);
     }
     else {
       // must be notification
       if (mNotificationCB) mNotificationCB(ErrorPtr(), aJsonObject);
     }
+    mTrafficMeter.processed(MainLoop::now()-start);
+    if (EventTrace::enabled()) {
+      if (!method.empty()) {
+        EventTrace::sharedTrace().span("bridge", "answer", start, method);
+      }
+      else {
+        JsonObjectPtr n = aJsonObject ? aJsonObject->get("notification") : JsonObjectPtr();
+        JsonObjectPtr d = aJsonObject ? aJsonObject->get("dSUID") : JsonObjectPtr();
+        EventTrace::sharedTrace().span("bridge", "notification", start, (n ? n->stringValue() : "") + (d ? " - " + d->stringValue() : ""));
+      }
+    }
+    MLMicroSeconds stall = StallDetector::sharedDetector().handled(start);
+    if (stall) {
+      if (!method.empty()) {
+        StallDetector::sharedDetector().stalled(stall, "answer to '" + method + "'", "");
+      }
+      else {
+        string notification = aJsonObject && aJsonObject->get("notification", o) ? o->stringValue() : "<unknown>";
+        string dsuid = aJsonObject && aJsonObject->get("dSUID", o) ? o->stringValue() : "";
+        StallDetector::sharedDetector().stalled(stall, "notification '" + notification + "'", dsuid);
+      }
+    }
   }
   else {
     LOG(LOG_ERR, "Bridge API data error: %s", aError->text());
@@ -94,17 +253,53 @@ void P44BridgeApi::messageHandler(ErrorPtr aError, JsonObjectPtr aJsonObject)
 }
 
 
-void P44BridgeApi::call(const string aMethod, JsonObjectPtr aParams, JSonMessageCB aResponseCB)
+bool P44BridgeApi::canSend()
+{
+  return mPendingBridgeCalls.size()<P44_MAX_CALLS_IN_FLIGHT;
+}
+
+
+void P44BridgeApi::call(const string aMethod, JsonObjectPtr aParams, JSonMessageCB aResponseCB, OutgoingQueue::Priority aPriority)
+{
+  queueCall(aMethod, aParams, aResponseCB, aPriority, "");
+}
+
+
+void P44BridgeApi::queueCall(const string aMethod, JsonObjectPtr aParams, JSonMessageCB aResponseCB, OutgoingQueue::Priority aPriority, const string aMergeKey)
+{
+  if (!mOutgoingQueue.send(
+    aPriority,
+    boost::bind(&P44BridgeApi::sendCall, this, aMethod, aParams, aResponseCB),
+    aMergeKey,
+    boost::bind(&P44BridgeApi::callDiscarded, this, aMethod, aResponseCB, _1)
+  )) {
+    if (aResponseCB) aResponseCB(TextError::err("bridge API outgoing queue full, call '%s' dropped", aMethod.c_str()), JsonObjectPtr());
+  }
+}
+
+
+void P44BridgeApi::callDiscarded(const string aMethod, JSonMessageCB aResponseCB, ErrorPtr aReason)
+{
+  LOG(LOG_INFO, "bridge API: call '%s' not sent: %s", aMethod.c_str(), Error::text(aReason));
+  if (aResponseCB) aResponseCB(aReason, JsonObjectPtr());
+}
+
+
+void P44BridgeApi::sendCall(const string aMethod, JsonObjectPtr aParams, JSonMessageCB aResponseCB)
 {
   if (!aParams) aParams = JsonObject::newObj();
   aParams->add("method", JsonObject::newString(aMethod));
   PendingBridgeCall call;
   call.mCallId = string_format("%ld", ++mBridgeCallCounter);
+  call.mMethod = aMethod;
   call.mCallback = aResponseCB;
   aParams->add("id", JsonObject::newString(call.mCallId));
   LOG(LOG_DEBUG, "Calling method '%s' in bridge, params:\n%s", aMethod.c_str(), JsonObject::text(aParams));
-  ErrorPtr err = sendMessage(aParams);
+  TRACE_EVENT("bridge", "call", aMethod);
+  ErrorPtr err = mIoThread.sendMessage(aParams);
   if (Error::isOK(err)) {
+    mTrafficMeter.sent(aParams);
+    if (ApiCapture::enabled()) ApiCapture::sharedCapture().capture(ApiCapture::p44, ApiCapture::sent, aParams);
     mPendingBridgeCalls.push_back(call);
   }
   else {
@@ -123,6 +318,15 @@ void P44BridgeApi::setProperties(const string aDSUID, JsonObjectPtr aProperties)
 }
 
 
+void P44BridgeApi::setPropertiesMerged(const string aDSUID, JsonObjectPtr aProperties, const string aMergeKey)
+{
+  JsonObjectPtr params = JsonObject::newObj();
+  params->add("dSUID", JsonObject::newString(aDSUID));
+  params->add("properties", aProperties);
+  queueCall("setProperty", params, NoOP, OutgoingQueue::sync, aMergeKey);
+}
+
+
 void P44BridgeApi::setProperty(const string aDSUID, const string aPropertyPath, JsonObjectPtr aValue)
 {
   string path = aPropertyPath;
@@ -135,17 +339,34 @@ void P44BridgeApi::setProperty(const string aDSUID, const string aPropertyPath,
     if (p==string::npos) break;
     path.erase(p);
   } while(true);
-  setProperties(aDSUID, aValue);
+  // setting the same property again supersedes a still queued previous setting
+  setPropertiesMerged(aDSUID, aValue, "setProperty:" + aDSUID + ":" + aPropertyPath);
 }
 
 
-ErrorPtr P44BridgeApi::notify(const string aNotification, JsonObjectPtr aParams)
+ErrorPtr P44BridgeApi::notify(const string aNotification, JsonObjectPtr aParams, OutgoingQueue::Priority aPriority)
+{
+  if (!mOutgoingQueue.send(aPriority, boost::bind(&P44BridgeApi::sendNotification, this, aNotification, aParams))) {
+    return TextError::err("bridge API outgoing queue full, notification '%s' dropped", aNotification.c_str());
+  }
+  return ErrorPtr();
+}
+
+
+ErrorPtr P44BridgeApi::sendNotification(const string aNotification, JsonObjectPtr aParams)
 {
   if (!aParams) aParams = JsonObject::newObj();
-  aParams->add("notification", JsonObject::newString(aNotification));
+  JsonObjectPtr& name = mNotificationNames[aNotification];
+  if (!name) name = JsonObject::newString(aNotification);
+  aParams->add("notification", name);
   LOG(LOG_DEBUG, "Sending notification '%s' to bridge, params:\n%s", aNotification.c_str(), JsonObject::text(aParams));
-  ErrorPtr err = sendMessage(aParams);
-  if (Error::notOK(err)) {
+  TRACE_EVENT("bridge", "notify", aNotification);
+  ErrorPtr err = mIoThread.sendMessage(aParams);
+  if (Error::isOK(err)) {
+    mTrafficMeter.sent(aParams);
+    if (ApiCapture::enabled()) ApiCapture::sharedCapture().capture(ApiCapture::p44, ApiCapture::sent, aParams);
+  }
+  else {
     LOG(LOG_ERR, "bridge API: sending notification '%s' failed: %s", aNotification.c_str(), err->text());
   }
   return err;
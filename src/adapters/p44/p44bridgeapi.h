@@ -27,40 +27,92 @@
 
 #if P44_ADAPTERS
 
-#include "jsoncomm.hpp"
+#include "socketcomm.hpp"
 #include "adapters/p44/p44bridgeapi_defs.h"
+#include "adapters/jsoniothread.h"
+#include "adapters/connectionsupervisor.h"
+#include "adapters/dispatchqueue.h"
+#include "adapters/trafficmeter.h"
+#include "adapters/outgoingqueue.h"
 
 using namespace p44;
 
-class P44BridgeApi : public JsonComm
+#ifndef P44_MAX_CALLS_IN_FLIGHT
+  #define P44_MAX_CALLS_IN_FLIGHT 8 ///< max number of unanswered calls before further messages are queued
+#endif
+#ifndef P44_MAX_QUEUED_MESSAGES
+  #define P44_MAX_QUEUED_MESSAGES 500 ///< max number of messages waiting in the outgoing queue
+#endif
+
+/// @brief connection to the P44 bridge API
+/// Messages are JSON text by default. When enabled with setOfferBinary(), the transport encoding is
+/// negotiated after connecting: p44mbrd calls `x-p44-setEncoding` with `{ "encoding":"msgpack" }`.
+/// A peer supporting it answers with `{ "result": { "encoding":"msgpack" } }`, and from then on both
+/// sides may send MessagePack encoded messages. Any other answer (usually a "method not found" error)
+/// means the peer only speaks JSON, which remains in use. Receivers accept both encodings per message,
+/// as a MessagePack message (a map) never starts with a byte that can start JSON text.
+class P44BridgeApi : public SocketComm
 {
-  MLTicket mApiRetryTicket;
+  JsonIoThread mIoThread; ///< socket I/O and JSON parsing, off the mainloop
+  MLTicket mIoStartTicket; ///< for handing over the connected socket to the I/O thread
+  ConnectionSupervisor mSupervisor;
+  DispatchQueue mDispatchQueue;
+  TrafficMeter mTrafficMeter;
+  OutgoingQueue mOutgoingQueue;
   long mBridgeCallCounter;
   typedef struct {
     string mCallId;
+    string mMethod;
     JSonMessageCB mCallback;
   } PendingBridgeCall;
   typedef std::list<PendingBridgeCall> PendingBridgeCalls;
   PendingBridgeCalls mPendingBridgeCalls;
   StatusCB mConnectedCB;
   JSonMessageCB mNotificationCB;
+  bool mOfferBinary; ///< if set, MessagePack encoding is offered to the peer after connecting
+  typedef std::map<string, JsonObjectPtr> NotificationNamesMap;
+  NotificationNamesMap mNotificationNames; ///< shared JSON strings for notification names, created on first use
 
 public:
 
   P44BridgeApi();
 
   /// connect to the bridge API
-  /// @param aConnectedCB will be called when connection is established or error occurs
+  /// @param aConnectedCB will be called when connection is established, or with an error when an
+  ///   established connection gets lost (reconnecting is automatic)
   void connectBridgeApi(StatusCB aConnectedCB);
 
+  /// disconnect from the bridge API (no reconnect, supervisor must be stopped before)
+  void disconnectBridgeApi();
+
+  /// @param aOfferBinary if set, MessagePack encoding is offered to the peer on every (re)connect
+  void setOfferBinary(bool aOfferBinary) { mOfferBinary = aOfferBinary; }
+
+  /// @return the I/O thread (for statistics)
+  JsonIoThread& ioThread() { return mIoThread; }
+
+  /// @return the connection supervisor (for statistics, and for stopping it)
+  ConnectionSupervisor& supervisor() { return mSupervisor; }
+
+  /// @return the queue for handing off received messages to processing (for setting budget, statistics)
+  DispatchQueue& dispatchQueue() { return mDispatchQueue; }
+
+  /// @return the meter for message volume and processing cost (for enabling size metering, statistics)
+  TrafficMeter& trafficMeter() { return mTrafficMeter; }
+
+  /// @return the outgoing message queue (for statistics)
+  OutgoingQueue& outgoingQueue() { return mOutgoingQueue; }
+
   /// set a handler to be called when a notification arrives via bridge API
   void setNotificationHandler(JSonMessageCB aNotificationCB) { mNotificationCB = aNotificationCB; };
 
   /// call method via bridge API
   /// @param aMethod the method name
   /// @param aParams method parameters
-  /// @param aResponseCB will be called with method response or transport/encoding level error
-  void call(const string aMethod, JsonObjectPtr aParams, JSonMessageCB aResponseCB);
+  /// @param aResponseCB will be called with method response or transport/encoding level error, including
+  ///   when the call is dropped from the outgoing queue or the connection is lost before an answer arrives
+  /// @param aPriority priority class for when the call must be queued because the bridge API is busy
+  void call(const string aMethod, JsonObjectPtr aParams, JSonMessageCB aResponseCB, OutgoingQueue::Priority aPriority = OutgoingQueue::sync);
 
   /// convenience method to set properties
   /// @param aDSUID the dsuid
@@ -76,14 +128,29 @@ public:
   /// send notification via bridge API
   /// @param aNotification the notification name
   /// @param aParams method parameters
-  /// @return ok or error when sending fails
-  ErrorPtr notify(const string aNotification, JsonObjectPtr aParams);
+  /// @param aPriority priority class for when the notification must be queued because the bridge API is busy
+  /// @return ok or error when the notification could not be sent or queued
+  ErrorPtr notify(const string aNotification, JsonObjectPtr aParams, OutgoingQueue::Priority aPriority = OutgoingQueue::interactive);
 
 private:
 
   void tryConnection();
   void connectionStatusHandler(ErrorPtr aStatus);
+  void startIo();
+  void connectionLost(ErrorPtr aError);
+  void negotiateEncoding();
+  void encodingAnswer(ErrorPtr aError, JsonObjectPtr aJsonMsg);
+  void probe(StatusCB aProbeResultCB);
+  void probeAnswer(StatusCB aProbeResultCB, ErrorPtr aError, JsonObjectPtr aJsonMsg);
+  void ioHandler(ErrorPtr aError, JsonObjectPtr aJsonObject);
   void messageHandler(ErrorPtr aError, JsonObjectPtr aJsonObject);
+  void processMessage(ErrorPtr aError, JsonObjectPtr aJsonObject);
+  bool canSend();
+  void queueCall(const string aMethod, JsonObjectPtr aParams, JSonMessageCB aResponseCB, OutgoingQueue::Priority aPriority, const string aMergeKey);
+  void setPropertiesMerged(const string aDSUID, JsonObjectPtr aProperties, const string aMergeKey);
+  void callDiscarded(const string aMethod, JSonMessageCB aResponseCB, ErrorPtr aReason);
+  void sendCall(const string aMethod, JsonObjectPtr aParams, JSonMessageCB aResponseCB);
+  ErrorPtr sendNotification(const string aNotification, JsonObjectPtr aParams);
 
 };
 
@@ -39,7 +39,8 @@ using namespace Clusters;
 P44_DeviceImpl::P44_DeviceImpl() :
   mBridgeable(true), // assume bridgeable, otherwise device wouldn't be instantiated
   mActive(false), // not yet active
-  mZoneId(zoneId_global) // no zoneID known yet
+  mZoneId(zoneId_global), // no zoneID known yet
+  mSeen(false)
 {
 }
 
@@ -58,9 +59,9 @@ const string P44_DeviceImpl::endpointUID() const
 void P44_DeviceImpl::deviceDidGetInstalled()
 {
   // update configuration that could not be set before device was installed (especially: attributes) from bridged info
-  updateBridgedInfo(mTempDeviceInfo);
+  updateBridgedInfo(mInstallInfo.mStateInfo);
   // we do not need it any more
-  mTempDeviceInfo.reset();
+  mInstallInfo = InstallInfo();
 }
 
 
@@ -81,6 +82,7 @@ bool P44_DeviceImpl::changeName(const string aNewName)
 {
   if (aNewName!=mName) {
     mName = aNewName;
+    device().invalidateLogContextPrefix();
     JsonObjectPtr params = JsonObject::newObj();
     JsonObjectPtr props = JsonObject::newObj();
     props->add("name", JsonObject::newString(mName));
@@ -111,9 +113,11 @@ void P44_DeviceImpl::initBridgedInfo(JsonObjectPtr aDeviceInfo, const char* aInp
   // Assign infos we need from start and are NOT stored in attributes
   // - dSUID
   mBridgedDSUID = o->stringValue();
+  mBridgedDSUIDJson = JsonObject::newString(mBridgedDSUID);
   // - default name
   if (aDeviceInfo->get("name", o)) {
     mName = o->stringValue();
+    device().invalidateLogContextPrefix();
     // Note: propagate only after device is installed
   }
   // - initial reachability
@@ -121,8 +125,24 @@ void P44_DeviceImpl::initBridgedInfo(JsonObjectPtr aDeviceInfo, const char* aInp
     mActive = o->boolValue();
     // Note: propagate only after device is installed
   }
-  // - some of the information will go directly to attributes, which are NOT YET AVAILABLE here
-  mTempDeviceInfo = aDeviceInfo;
+  // - some of the information will go directly to attributes, which are NOT YET AVAILABLE here,
+  //   so extract what we need now, but do not keep the entire device info
+  if (aDeviceInfo->get("displayId", o)) mInstallInfo.mSerialNumber = o->stringValue();
+  if (aDeviceInfo->get("vendorName", o)) mInstallInfo.mVendorName = o->stringValue();
+  if (aDeviceInfo->get("model", o)) mInstallInfo.mProductName = o->stringValue();
+  if (aDeviceInfo->get("configURL", o)) mInstallInfo.mProductURL = o->stringValue();
+  // - state related properties are parsed by the same code as pushed properties, so keep these as JSON
+  mInstallInfo.mStateInfo = JsonObject::newObj();
+  static const char* stateKeys[] = { "zoneID", "x-p44-zonename", "outputState", "channelStates" };
+  for (size_t i=0; i<sizeof(stateKeys)/sizeof(const char*); i++) {
+    if (aDeviceInfo->get(stateKeys[i], o)) mInstallInfo.mStateInfo->add(stateKeys[i], o);
+  }
+  if (aInputType) {
+    // only the states of this device's input type
+    // Note: not only aInputId, as multi-position buttons use the states of multiple inputs
+    string statesKey = string(aInputType)+"States";
+    if (aDeviceInfo->get(statesKey.c_str(), o)) mInstallInfo.mStateInfo->add(statesKey.c_str(), o);
+  }
 }
 
 
@@ -135,22 +155,22 @@ void P44_DeviceImpl::updateBridgedInfo(JsonObjectPtr aDeviceInfo)
     device().updateNodeLabel(mName, UpdateMode());
     device().updateReachable(isReachable(), UpdateMode());
     updateZoneInfo(aDeviceInfo, UpdateMode());
-    // get some more info, store in Attributes
-    if (aDeviceInfo->get("displayId", o)) {
-      SET_ATTR_STRING(BridgedDeviceBasicInformation, SerialNumber, endpointId(), o->stringValue());
+    // store more info extracted at initBridgedInfo() in Attributes
+    if (!mInstallInfo.mSerialNumber.empty()) {
+      SET_ATTR_STRING(BridgedDeviceBasicInformation, SerialNumber, endpointId(), mInstallInfo.mSerialNumber);
     }
     else {
       // use UID as serial number, MUST NOT BE >32 chars
       SET_ATTR_STRING_M(BridgedDeviceBasicInformation, SerialNumber, endpointId(), mBridgedDSUID); // abbreviate in the middle
     }
-    if (aDeviceInfo->get("vendorName", o)) {
-      SET_ATTR_STRING(BridgedDeviceBasicInformation, VendorName, endpointId(), o->stringValue());
+    if (!mInstallInfo.mVendorName.empty()) {
+      SET_ATTR_STRING(BridgedDeviceBasicInformation, VendorName, endpointId(), mInstallInfo.mVendorName);
     }
-    if (aDeviceInfo->get("model", o)) {
-      SET_ATTR_STRING(BridgedDeviceBasicInformation, ProductName, endpointId(), o->stringValue());
+    if (!mInstallInfo.mProductName.empty()) {
+      SET_ATTR_STRING(BridgedDeviceBasicInformation, ProductName, endpointId(), mInstallInfo.mProductName);
     }
-    if (aDeviceInfo->get("configURL", o)) {
-      SET_ATTR_STRING(BridgedDeviceBasicInformation, ProductURL, endpointId(), o->stringValue());
+    if (!mInstallInfo.mProductURL.empty()) {
+      SET_ATTR_STRING(BridgedDeviceBasicInformation, ProductURL, endpointId(), mInstallInfo.mProductURL);
     }
   }
 }
@@ -226,16 +246,24 @@ void P44_DeviceImpl::notify(const string aNotification, JsonObjectPtr aParams)
 {
   if (!aParams) aParams = JsonObject::newObj();
   DLOG(LOG_NOTICE, "mbr -> vdcd: sending notification '%s': %s", aNotification.c_str(), aParams->json_c_str());
-  aParams->add("dSUID", JsonObject::newString(mBridgedDSUID));
+  aParams->add("dSUID", mBridgedDSUIDJson);
   P44_BridgeImpl::adapter().api().notify(aNotification, aParams);
 }
 
 
+void P44_DeviceImpl::notifyGrouped(const string aNotification, JsonObjectPtr aParams)
+{
+  if (!aParams) aParams = JsonObject::newObj();
+  DLOG(LOG_NOTICE, "mbr -> vdcd: queuing grouped notification '%s': %s", aNotification.c_str(), aParams->json_c_str());
+  P44_BridgeImpl::adapter().notifyGrouped(aNotification, aParams, mBridgedDSUID);
+}
+
+
 void P44_DeviceImpl::call(const string aMethod, JsonObjectPtr aParams, JSonMessageCB aResponseCB)
 {
   if (!aParams) aParams = JsonObject::newObj();
   DLOG(LOG_NOTICE, "mbr -> vdcd: calling method '%s': %s", aMethod.c_str(), aParams->json_c_str());
-  aParams->add("dSUID", JsonObject::newString(mBridgedDSUID));
+  aParams->add("dSUID", mBridgedDSUIDJson);
   P44_BridgeImpl::adapter().api().call(aMethod, aParams, aResponseCB);
 }
 
@@ -272,20 +300,156 @@ void P44_IdentifiableImpl::identify(int aDurationS)
 }
 
 
-void P44_IdentifiableImpl::updateBridgedInfo(JsonObjectPtr aDeviceInfo)
+void P44_IdentifiableImpl::initBridgedInfo(JsonObjectPtr aDeviceInfo, const char* aInputType, const char* aInputId)
 {
   // basics first
-  inherited::updateBridgedInfo(aDeviceInfo);
+  inherited::initBridgedInfo(aDeviceInfo, aInputType, aInputId);
   // specifics
   mCanIdentifyToUser = P44_BridgeImpl::hasModelFeature(aDeviceInfo, "identification");
 }
 
 
 
+// MARK: - prebuilt message parts
+
+/// @brief prebuilt constant parts of frequently sent output messages
+/// @note JSON objects are reference counted and leaf objects are never modified once
+///   created, so these can be added to any number of messages without copying.
+/// @note the params object itself is still built per command: the per-channel throttle
+///   keeps it as the pending command, notifyGrouped() collects it, and traffic metering,
+///   API capture and the JSON/MessagePack encoding chosen by JsonIoThread::sendMessage()
+///   all work on the JSON object, not on prebuilt text.
+class MessageParts
+{
+  typedef std::map<string, JsonObjectPtr> StringsMap;
+  StringsMap mStrings;
+
+public:
+
+  JsonObjectPtr mTrue;
+  JsonObjectPtr mFalse;
+  JsonObjectPtr mZero; ///< int 0, for default channel index and zero transition time
+  JsonObjectPtr mDimModes[3]; ///< dimChannel modes -1, 0, 1
+
+  MessageParts() :
+    mTrue(JsonObject::newBool(true)),
+    mFalse(JsonObject::newBool(false)),
+    mZero(JsonObject::newInt32(0))
+  {
+    for (int i=0; i<3; i++) mDimModes[i] = JsonObject::newInt32(i-1);
+  }
+
+  JsonObjectPtr boolean(bool aValue) { return aValue ? mTrue : mFalse; }
+
+  JsonObjectPtr dimMode(int8_t aDirection) { return mDimModes[aDirection<0 ? 0 : (aDirection>0 ? 2 : 1)]; }
+
+  /// @return shared JSON string (created on first use)
+  JsonObjectPtr str(const char* aString)
+  {
+    StringsMap::iterator pos = mStrings.find(aString);
+    if (pos!=mStrings.end()) return pos->second;
+    JsonObjectPtr s = JsonObject::newString(aString);
+    mStrings[aString] = s;
+    return s;
+  }
+
+};
+
+static MessageParts& messageParts()
+{
+  static MessageParts sMessageParts;
+  return sMessageParts;
+}
+
+
 // MARK: - P44_OutputImpl
 
 // MARK: P44 internal implementation
 
+JsonObjectPtr P44_OutputImpl::channelValueParams(const char* aChannelId, JsonObjectPtr aValue, double aTransitionTime, bool aApply)
+{
+  MessageParts& parts = messageParts();
+  JsonObjectPtr params = JsonObject::newObj();
+  if (aChannelId) params->add("channelId", parts.str(aChannelId));
+  else params->add("channel", parts.mZero); // default channel
+  params->add("value", aValue);
+  if (aTransitionTime==0) params->add("transitionTime", parts.mZero);
+  else if (aTransitionTime>0) params->add("transitionTime", JsonObject::newDouble(aTransitionTime));
+  params->add("apply_now", parts.boolean(aApply));
+  return params;
+}
+
+
+void P44_OutputImpl::notifyChannelValue(const string aChannelKey, JsonObjectPtr aParams, MLMicroSeconds aTransitionEnd)
+{
+  MLMicroSeconds interval = P44_BridgeImpl::adapter().outputCommandInterval();
+  if (interval==0) {
+    notify("setOutputChannelValue", aParams);
+    return;
+  }
+  ChannelThrottle& ct = mChannelThrottles[aChannelKey];
+  if (ct.mPendingParams) {
+    // a command is already waiting to be sent: latest value wins
+    DLOG(LOG_DEBUG, "superseding pending command for channel '%s'", aChannelKey.c_str());
+    P44_BridgeImpl::adapter().countSupersededOutputCommand();
+    ct.mPendingParams = aParams;
+    return;
+  }
+  MLMicroSeconds now = MainLoop::now();
+  MLMicroSeconds sendAt = ct.mLastSent+interval;
+  if (aTransitionEnd>sendAt && aTransitionEnd-sendAt<P44_TRANSITION_NEARLY_DONE) {
+    // do not interrupt a transition that is nearly done
+    sendAt = aTransitionEnd;
+  }
+  if (sendAt<=now) {
+    sendChannelValue(aChannelKey, aParams);
+    return;
+  }
+  ct.mPendingParams = aParams;
+  ct.mSendTicket.executeOnce(boost::bind(&P44_OutputImpl::sendPendingChannelValue, this, aChannelKey), sendAt-now);
+}
+
+
+void P44_OutputImpl::sendPendingChannelValue(const string aChannelKey)
+{
+  ChannelThrottle& ct = mChannelThrottles[aChannelKey];
+  if (ct.mPendingParams) {
+    JsonObjectPtr params = ct.mPendingParams;
+    ct.mPendingParams.reset();
+    sendChannelValue(aChannelKey, params);
+  }
+}
+
+
+void P44_OutputImpl::sendChannelValue(const string aChannelKey, JsonObjectPtr aParams)
+{
+  // commands still pending for other channels are older, send them first to keep the
+  // order (channel values might be applied together, e.g. hue and saturation)
+  for (ChannelThrottleMap::iterator pos = mChannelThrottles.begin(); pos!=mChannelThrottles.end(); ++pos) {
+    if (pos->first!=aChannelKey && pos->second.mPendingParams) {
+      pos->second.mSendTicket.cancel();
+      pos->second.mLastSent = MainLoop::now();
+      JsonObjectPtr params = pos->second.mPendingParams;
+      pos->second.mPendingParams.reset();
+      notify("setOutputChannelValue", params);
+    }
+  }
+  mChannelThrottles[aChannelKey].mLastSent = MainLoop::now();
+  notify("setOutputChannelValue", aParams);
+}
+
+
+void P44_OutputImpl::dropPendingChannelValue(const string aChannelKey)
+{
+  ChannelThrottleMap::iterator pos = mChannelThrottles.find(aChannelKey);
+  if (pos!=mChannelThrottles.end() && pos->second.mPendingParams) {
+    P44_BridgeImpl::adapter().countSupersededOutputCommand();
+    pos->second.mSendTicket.cancel();
+    pos->second.mPendingParams.reset();
+  }
+}
+
+
 void P44_OutputImpl::initBridgedInfo(JsonObjectPtr aDeviceInfo, const char* aInputType, const char* aInputId)
 {
   inherited::initBridgedInfo(aDeviceInfo, aInputType, aInputId);
@@ -353,12 +517,7 @@ double P44_OutputImpl::percent2value(double aPercent)
 void P44_OnOffImpl::setOnOffState(bool aOn)
 {
   // call preset1 or off on the bridged device
-  JsonObjectPtr params = JsonObject::newObj();
-  params->add("channel", JsonObject::newInt32(0)); // default channel
-  params->add("value", JsonObject::newDouble(aOn ? mDefaultChannelMax : mDefaultChannelMin));
-  params->add("transitionTime", JsonObject::newDouble(0));
-  params->add("apply_now", JsonObject::newBool(true));
-  notify("setOutputChannelValue", params);
+  notifyChannelValue("", channelValueParams(nullptr, aOn ? mDefaultChannelMax : mDefaultChannelMin, 0, true));
 }
 
 // MARK: P44 internal implementation
@@ -392,12 +551,7 @@ void P44_LevelControlImpl::setLevel(double aNewLevel, uint16_t aTransitionTimeDS
   // adjust default channel
   // Note: transmit relative changes as such, although we already calculate the outcome above,
   //   but non-standard channels might arrive at another value (e.g. wrap around)
-  JsonObjectPtr params = JsonObject::newObj();
-  params->add("channel", JsonObject::newInt32(0)); // default channel
-  params->add("value", JsonObject::newDouble(percent2value(aNewLevel)));
-  params->add("transitionTime", JsonObject::newDouble((double)aTransitionTimeDS/10.0));
-  params->add("apply_now", JsonObject::newBool(true));
-  notify("setOutputChannelValue", params);
+  notifyChannelValue("", channelValueParams(nullptr, percent2value(aNewLevel), (double)aTransitionTimeDS/10.0, true), mEndOfLatestTransition);
   // calculate time when transition will be done
   mEndOfLatestTransition = MainLoop::now()+aTransitionTimeDS*(Second/10);
 }
@@ -405,10 +559,13 @@ void P44_LevelControlImpl::setLevel(double aNewLevel, uint16_t aTransitionTimeDS
 
 void P44_LevelControlImpl::dim(int8_t aDirection, uint8_t aRate)
 {
+  // dimming overrides any value still waiting to be sent
+  dropPendingChannelValue("");
+  MessageParts& parts = messageParts();
   JsonObjectPtr params = JsonObject::newObj();
-  params->add("channel", JsonObject::newInt32(0)); // default channel
-  params->add("mode", JsonObject::newInt32(aDirection));
-  params->add("autostop", JsonObject::newBool(false));
+  params->add("channel", parts.mZero); // default channel
+  params->add("mode", parts.dimMode(aDirection));
+  params->add("autostop", parts.mFalse);
   // matter rate is 0..0xFE units per second, p44 rate is 0..mDefaultChannelMax units per millisecond
   if (aDirection!=0 && aRate!=0xFF) params->add("dimPerMS", JsonObject::newDouble((double)aRate*mDefaultChannelMax/MATTER_DM_PLUGIN_LEVEL_CONTROL_MAXIMUM_LEVEL/1000));
   notify("dimChannel", params);
@@ -420,15 +577,16 @@ void P44_LevelControlImpl::dim(int8_t aDirection, uint8_t aRate)
 
 P44_LevelControlImpl::P44_LevelControlImpl() :
   mRecommendedTransitionTimeDS(5), // FIXME: for now: just dS default of full range in 7 seconds
-  mEndOfLatestTransition(Never)
+  mEndOfLatestTransition(Never),
+  mDefaultOnLevel(-1) // none
 {
 }
 
 
-void P44_LevelControlImpl::updateBridgedInfo(JsonObjectPtr aDeviceInfo)
+void P44_LevelControlImpl::initBridgedInfo(JsonObjectPtr aDeviceInfo, const char* aInputType, const char* aInputId)
 {
   // basics first
-  inherited::updateBridgedInfo(aDeviceInfo);
+  inherited::initBridgedInfo(aDeviceInfo, aInputType, aInputId);
   // specifics
   JsonObjectPtr o;
   JsonObjectPtr o2;
@@ -445,7 +603,8 @@ void P44_LevelControlImpl::updateBridgedInfo(JsonObjectPtr aDeviceInfo)
       if (o2->get("channels", o2)) {
         if (o2->get(mDefaultChannelId.c_str(), o2)) {
           if (o2->get("value", o2)) {
-            deviceP<LevelControlImplementationInterface>()->setDefaultOnLevel(value2percent(o2->doubleValue()));
+            // attributes not yet accessible, apply at updateBridgedInfo()
+            mDefaultOnLevel = value2percent(o2->doubleValue());
           }
         }
       }
@@ -454,6 +613,17 @@ void P44_LevelControlImpl::updateBridgedInfo(JsonObjectPtr aDeviceInfo)
 }
 
 
+void P44_LevelControlImpl::updateBridgedInfo(JsonObjectPtr aDeviceInfo)
+{
+  // basics first
+  inherited::updateBridgedInfo(aDeviceInfo);
+  // specifics
+  if (mDefaultOnLevel>=0) {
+    deviceP<LevelControlImplementationInterface>()->setDefaultOnLevel(mDefaultOnLevel);
+  }
+}
+
+
 void P44_LevelControlImpl::parseOutputState(JsonObjectPtr aOutputState, JsonObjectPtr aChannelStates, UpdateMode aUpdateMode)
 {
   // OnOff just sets on/off state when level>0
@@ -479,58 +649,31 @@ void P44_LevelControlImpl::parseOutputState(JsonObjectPtr aOutputState, JsonObje
 
 void P44_ColorControlImpl::setHue(uint8_t aHue, uint16_t aTransitionTimeDS, bool aApply)
 {
-  JsonObjectPtr params = JsonObject::newObj();
-  params->add("channelId", JsonObject::newString("hue"));
-  params->add("value", JsonObject::newDouble((double)aHue*360/0xFE));
-  params->add("transitionTime", JsonObject::newDouble((double)aTransitionTimeDS/10));
-  params->add("apply_now", JsonObject::newBool(aApply));
-  notify("setOutputChannelValue", params);
-
+  notifyChannelValue("hue", channelValueParams("hue", (double)aHue*360/0xFE, (double)aTransitionTimeDS/10, aApply));
 }
 
 
 void P44_ColorControlImpl::setSaturation(uint8_t aSaturation, uint16_t aTransitionTimeDS, bool aApply)
 {
-  JsonObjectPtr params = JsonObject::newObj();
-  params->add("channelId", JsonObject::newString("saturation"));
-  params->add("value", JsonObject::newDouble((double)aSaturation*100/0xFE));
-  params->add("transitionTime", JsonObject::newDouble((double)aTransitionTimeDS/10));
-  params->add("apply_now", JsonObject::newBool(aApply));
-  notify("setOutputChannelValue", params);
-
+  notifyChannelValue("saturation", channelValueParams("saturation", (double)aSaturation*100/0xFE, (double)aTransitionTimeDS/10, aApply));
 }
 
 
 void P44_ColorControlImpl::setCieX(uint16_t aX, uint16_t aTransitionTimeDS, bool aApply)
 {
-  JsonObjectPtr params = JsonObject::newObj();
-  params->add("channelId", JsonObject::newString("x"));
-  params->add("value", JsonObject::newDouble((double)aX/0xFFFE));
-  params->add("transitionTime", JsonObject::newDouble((double)aTransitionTimeDS/10));
-  params->add("apply_now", JsonObject::newBool(aApply));
-  notify("setOutputChannelValue", params);
+  notifyChannelValue("x", channelValueParams("x", (double)aX/0xFFFE, (double)aTransitionTimeDS/10, aApply));
 }
 
 
 void P44_ColorControlImpl::setCieY(uint16_t aY, uint16_t aTransitionTimeDS, bool aApply)
 {
-  JsonObjectPtr params = JsonObject::newObj();
-  params->add("channelId", JsonObject::newString("y"));
-  params->add("value", JsonObject::newDouble((double)aY/0xFFFE));
-  params->add("transitionTime", JsonObject::newDouble((double)aTransitionTimeDS/10));
-  params->add("apply_now", JsonObject::newBool(aApply));
-  notify("setOutputChannelValue", params);
+  notifyChannelValue("y", channelValueParams("y", (double)aY/0xFFFE, (double)aTransitionTimeDS/10, aApply));
 }
 
 
 void P44_ColorControlImpl::setColortemp(uint16_t aColortemp, uint16_t aTransitionTimeDS, bool aApply)
 {
-  JsonObjectPtr params = JsonObject::newObj();
-  params->add("channelId", JsonObject::newString("colortemp"));
-  params->add("value", JsonObject::newDouble(aColortemp)); // is in mireds
-  params->add("transitionTime", JsonObject::newDouble((double)aTransitionTimeDS/10));
-  params->add("apply_now", JsonObject::newBool(aApply));
-  notify("setOutputChannelValue", params);
+  notifyChannelValue("colortemp", channelValueParams("colortemp", aColortemp, (double)aTransitionTimeDS/10, aApply)); // is in mireds
 }
 
 
@@ -656,7 +799,7 @@ bool P44_WindowCoveringImpl::bridge2matter(JsonObjectPtr aBridgeValue, DataModel
 
 void P44_WindowCoveringImpl::startMovement(WindowCovering::WindowCoveringType aMovementType)
 {
-  JsonObjectPtr params, val;
+  JsonObjectPtr val;
   BitMask<WindowCovering::Mode> mode;
   WindowCovering::Attributes::Mode::Get(endpointId(), &mode);
   // set output values
@@ -666,19 +809,13 @@ void P44_WindowCoveringImpl::startMovement(WindowCovering::WindowCoveringType aM
     DataModel::Nullable<Percent100ths> tilt;
     WindowCovering::Attributes::TargetPositionTiltPercent100ths::Get(endpointId(), tilt);
     if (matter2bridge(tilt, val, mode.Has(WindowCovering::Mode::kMotorDirectionReversed), false)) {
-      params = JsonObject::newObj();
-      params->add("channelId", JsonObject::newString("shadeOpeningAngleOutside"));
-      params->add("value", val);
-      params->add("apply_now", JsonObject::newBool(lift.IsNull())); // wait for lift value, unless it is not provided
-      notify("setOutputChannelValue", params);
+      // wait for lift value, unless it is not provided
+      notifyGrouped("setOutputChannelValue", channelValueParams("shadeOpeningAngleOutside", val, -1, lift.IsNull()));
     }
   }
   if (matter2bridge(lift, val, mode.Has(WindowCovering::Mode::kMotorDirectionReversed), true)) {
-    params = JsonObject::newObj();
-    params->add("channelId", JsonObject::newString(mDefaultChannelId));
-    params->add("value", val);
-    params->add("apply_now", JsonObject::newBool(true)); // Apply now, together with tilt
-    notify("setOutputChannelValue", params);
+    // Apply now, together with tilt
+    notifyGrouped("setOutputChannelValue", channelValueParams(mDefaultChannelId.c_str(), val, -1, true));
   }
 }
 
@@ -687,13 +824,9 @@ void P44_WindowCoveringImpl::simpleStartMovement(WindowCovering::WindowCoveringT
 {
   BitMask<WindowCovering::Mode> mode;
   WindowCovering::Attributes::Mode::Get(endpointId(), &mode);
-  JsonObjectPtr params = JsonObject::newObj();
   bool isLift = aMovementType==WindowCovering::WindowCoveringType::Lift;
-  params->add("channelId", JsonObject::newString(isLift ? mDefaultChannelId : "shadeOpeningAngleOutside"));
-  double v = matter2bridge(aUpOrOpen ? 0 : 100*100, mode.Has(WindowCovering::Mode::kMotorDirectionReversed), isLift);
-  params->add("value", JsonObject::newDouble(v)); // dS standard: 100% = fully lifted/open
-  params->add("apply_now", JsonObject::newBool(true)); // Apply now, together with tilt
-  notify("setOutputChannelValue", params);
+  double v = matter2bridge(aUpOrOpen ? 0 : 100*100, mode.Has(WindowCovering::Mode::kMotorDirectionReversed), isLift); // dS standard: 100% = fully lifted/open
+  notifyGrouped("setOutputChannelValue", channelValueParams(isLift ? mDefaultChannelId.c_str() : "shadeOpeningAngleOutside", v, -1, true));
 }
 
 
@@ -703,7 +836,7 @@ void P44_WindowCoveringImpl::stopMovement()
   JsonObjectPtr params = JsonObject::newObj();
   params->add("scene", JsonObject::newInt32(15)); // S_STOP
   params->add("force", JsonObject::newBool(true));
-  notify("callScene", params);
+  notifyGrouped("callScene", params);
 }
 
 
@@ -716,14 +849,20 @@ P44_WindowCoveringImpl::P44_WindowCoveringImpl() :
 }
 
 
+void P44_WindowCoveringImpl::initBridgedInfo(JsonObjectPtr aDeviceInfo, const char* aInputType, const char* aInputId)
+{
+  // basics first
+  inherited::initBridgedInfo(aDeviceInfo, aInputType, aInputId);
+  // - rollershade or tiltblind?
+  mHasTilt = P44_BridgeImpl::hasModelFeature(aDeviceInfo, "shadebladeang");
+}
+
+
 void P44_WindowCoveringImpl::updateBridgedInfo(JsonObjectPtr aDeviceInfo)
 {
   // basics first
   inherited::updateBridgedInfo(aDeviceInfo);
   // init attributes
-  // - rollershade or tiltblind?
-  JsonObjectPtr o, o2;
-  mHasTilt = P44_BridgeImpl::hasModelFeature(aDeviceInfo, "shadebladeang");
   underlying_type_t<WindowCovering::Feature> featuremap = 0;
   featuremap |= to_underlying(WindowCovering::Feature::kLift) | to_underlying(WindowCovering::Feature::kPositionAwareLift);
   if (mHasTilt) {
@@ -788,18 +927,13 @@ void P44_WindowCoveringImpl::parseOutputState(JsonObjectPtr aOutputState, JsonOb
       Percent100ths targetvalue = bridge2matter(vo->doubleValue(), mode.Has(WindowCovering::Mode::kMotorDirectionReversed), true);
       // - always report target value, WindowCovering cluster relies on that
       WindowCovering::Attributes::TargetPositionLiftPercent100ths::Set(endpointId(), targetvalue);
+      WindowCovering::NPercent100ths currentvalue;
       if (moving && o->get("x-p44-transitional", vo, true)) {
         // we know the actual transitional current position value
-        Percent100ths currentvalue = bridge2matter(vo->doubleValue(), mode.Has(WindowCovering::Mode::kMotorDirectionReversed), true);
-        WindowCovering::LiftPositionSet(endpointId(), WindowCovering::NPercent100ths(currentvalue));
-      }
-      else {
-        // we do not know a transitional value
-        if (!moving) {
-          // not moving, assume target and current equal
-          WindowCovering::LiftPositionSet(endpointId(), WindowCovering::NPercent100ths(targetvalue));
-        }
+        currentvalue.SetNonNull(bridge2matter(vo->doubleValue(), mode.Has(WindowCovering::Mode::kMotorDirectionReversed), true));
       }
+      // current position is actual when known or not moving, predicted otherwise
+      deviceP<DeviceWindowCovering>()->updateActualMotion(WindowCovering::WindowCoveringType::Lift, targetvalue, currentvalue, moving!=0);
     }
   }
   if (aChannelStates->get("shadeOpeningAngleOutside", o)) {
@@ -809,18 +943,13 @@ void P44_WindowCoveringImpl::parseOutputState(JsonObjectPtr aOutputState, JsonOb
       Percent100ths targetvalue = bridge2matter(vo->doubleValue(), mode.Has(WindowCovering::Mode::kMotorDirectionReversed), false);
       // - always report target value, WindowCovering cluster relies on that
       WindowCovering::Attributes::TargetPositionTiltPercent100ths::Set(endpointId(), targetvalue);
+      WindowCovering::NPercent100ths currentvalue;
       if (moving && o->get("x-p44-transitional", vo, true)) {
         // we know the actual transitional current position value
-        Percent100ths currentvalue = bridge2matter(vo->doubleValue(), mode.Has(WindowCovering::Mode::kMotorDirectionReversed), false);
-        WindowCovering::TiltPositionSet(endpointId(), WindowCovering::NPercent100ths(currentvalue));
-      }
-      else {
-        // we do not know a transitional value
-        if (!moving) {
-          // not moving, assume target and current equal
-          WindowCovering::TiltPositionSet(endpointId(), WindowCovering::NPercent100ths(targetvalue));
-        }
+        currentvalue.SetNonNull(bridge2matter(vo->doubleValue(), mode.Has(WindowCovering::Mode::kMotorDirectionReversed), false));
       }
+      // current position is actual when known or not moving, predicted otherwise
+      deviceP<DeviceWindowCovering>()->updateActualMotion(WindowCovering::WindowCoveringType::Tilt, targetvalue, currentvalue, moving!=0);
     }
   }
 }
@@ -845,34 +974,49 @@ void P44_InputImpl::initBridgedInfo(JsonObjectPtr aDeviceInfo, const char* aInpu
 
 // MARK: - P44_SensorImpl
 
-void P44_SensorImpl::updateBridgedInfo(JsonObjectPtr aDeviceInfo)
+P44_SensorImpl::P44_SensorImpl() :
+  mHasSensorParams(false),
+  mHasMin(false),
+  mMin(0),
+  mHasMax(false),
+  mMax(0),
+  mTolerance(0) // unknown
 {
-  // basics first
-  inherited::updateBridgedInfo(aDeviceInfo);
+}
 
-  JsonObjectPtr o;
-  double min = 0;
-  double max = 0;
-  double tolerance = 0; // unknown
-  bool hasMin = false;
-  bool hasMax = false;
 
-  SensorDevice* dev = deviceP<SensorDevice>();
+void P44_SensorImpl::initBridgedInfo(JsonObjectPtr aDeviceInfo, const char* aInputType, const char* aInputId)
+{
+  // basics first
+  inherited::initBridgedInfo(aDeviceInfo, aInputType, aInputId);
+  // sensor parameters, to be applied at updateBridgedInfo()
+  JsonObjectPtr o;
   JsonObjectPtr descriptions;
   if (aDeviceInfo->get((mInputType+"Descriptions").c_str(), descriptions)) {
+    mHasSensorParams = true;
     if (descriptions->get("resolution", o)) {
       // tolerance is half of the resolution (when resolution is 1, true value might be max +/- 0.5 resolution away)
-      tolerance = o->doubleValue()/2;
+      mTolerance = o->doubleValue()/2;
     }
     if (descriptions->get("min", o)) {
-      hasMin = true;
-      min = o->doubleValue();
+      mHasMin = true;
+      mMin = o->doubleValue();
     }
     if (descriptions->get("max", o)) {
-      hasMax = true;
-      max = o->doubleValue();
+      mHasMax = true;
+      mMax = o->doubleValue();
     }
-    dev->setupSensorParams(hasMin, min, hasMax, max, tolerance);
+  }
+}
+
+
+void P44_SensorImpl::updateBridgedInfo(JsonObjectPtr aDeviceInfo)
+{
+  // basics first
+  inherited::updateBridgedInfo(aDeviceInfo);
+  // sensor parameters
+  if (mHasSensorParams) {
+    deviceP<SensorDevice>()->setupSensorParams(mHasMin, mMin, mHasMax, mMax, mTolerance);
   }
   // also get current value from xxxStates
   parseSensorValue(aDeviceInfo, UpdateMode());
@@ -50,6 +50,7 @@ class P44_DeviceImpl :
   /// @{
 
   string mBridgedDSUID; ///< dSUID of the bridged device (for making API calls)
+  JsonObjectPtr mBridgedDSUIDJson; ///< dSUID as immutable JSON string, shared by all outgoing messages
 
   /// @}
 
@@ -60,10 +61,20 @@ class P44_DeviceImpl :
   bool mActive; ///< device active (hardware reachable) from P44 side
   string mName; ///< current P44 side name of the device
   DsZoneID mZoneId; ///< P44 side zone ID
+  bool mSeen; ///< mark for mark-and-sweep of devices when resyncing after bridge API reconnect
 
   /// @}
 
-  JsonObjectPtr mTempDeviceInfo; ///< keeps device info temporarily until device is installed
+  /// @brief info extracted from bridge query results, needed only until device is installed
+  /// @note this avoids keeping the entire (large) device info JSON until installation
+  struct InstallInfo {
+    string mSerialNumber; ///< displayId, empty if none
+    string mVendorName; ///< vendorName, empty if none
+    string mProductName; ///< model, empty if none
+    string mProductURL; ///< configURL, empty if none
+    JsonObjectPtr mStateInfo; ///< only the state related properties (zone, output and input states)
+  };
+  InstallInfo mInstallInfo;
 
 public:
 
@@ -82,6 +93,13 @@ public:
 
   inline DsZoneID zoneId() { return mZoneId; }
 
+  /// @name mark-and-sweep support for resyncing after bridge API reconnect
+  /// @{
+  inline void markSeen() { mSeen = true; }
+  /// @return true if device was marked seen since last call (clears the mark)
+  inline bool checkAndClearSeen() { bool s = mSeen; mSeen = false; return s; }
+  /// @}
+
   /// @}
 
   /// @name P44 bridge API specific methods
@@ -95,6 +113,8 @@ public:
   virtual const string endpointUIDSuffix() const { return "output"; }
 
   void notify(const string aNotification, JsonObjectPtr aParams);
+  /// @brief send notification, possibly grouped with identical notifications to other devices into a single message
+  void notifyGrouped(const string aNotification, JsonObjectPtr aParams);
   void call(const string aMethod, JsonObjectPtr aParams, JSonMessageCB aResponseCB);
 
   /// @brief init device with information from bridge query results
@@ -115,7 +135,9 @@ protected:
 
   /// @brief update device with information from bridge query results now where the device is installed
   ///   and CAN ACCESS ATTRIBUTES.
-  /// @param aDeviceInfo the JSON object for the entire bridge-side device
+  /// @param aDeviceInfo JSON object containing only the state related properties of the bridge-side device
+  ///   (zone, outputState, channelStates, and the states of this device's input type, if any). Other information
+  ///   needed at installation must be extracted into member variables in initBridgedInfo().
   virtual void updateBridgedInfo(JsonObjectPtr aDeviceInfo);
 
   /// @param aDeviceInfo device-level properties
@@ -142,7 +164,7 @@ protected:
 
   P44_IdentifiableImpl() : mCanIdentifyToUser(false) {};
 
-  virtual void updateBridgedInfo(JsonObjectPtr aDeviceInfo) override;
+  virtual void initBridgedInfo(JsonObjectPtr aDeviceInfo, const char* aInputType = nullptr, const char* aInputId = nullptr) override;
 
 };
 
@@ -171,11 +193,52 @@ protected:
   double mDefaultChannelMin;
   double mDefaultChannelMax;
 
+  /// throttling state of a channel
+  class ChannelThrottle
+  {
+  public:
+    MLMicroSeconds mLastSent = Never; ///< when the last command was sent
+    JsonObjectPtr mPendingParams; ///< the command waiting to be sent, if any
+    MLTicket mSendTicket; ///< timer for sending the pending command
+  };
+  typedef std::map<string, ChannelThrottle> ChannelThrottleMap;
+  ChannelThrottleMap mChannelThrottles; ///< throttling state by channel id ("" for default channel)
+
   P44_OutputImpl() : mDefaultChannelMin(0), mDefaultChannelMax(100) {};
 
   double value2percent(double aValue);
   double percent2value(double aPercent);
 
+  /// @brief build parameters for a setOutputChannelValue notification
+  /// @param aChannelId channel id, or nullptr to address the default channel by index
+  /// @param aValue the new channel value
+  /// @param aTransitionTime transition time in seconds, or <0 to omit
+  /// @param aApply if set, apply the value now
+  /// @return new parameter object. Its constant members are prebuilt JSON objects shared among all messages.
+  JsonObjectPtr channelValueParams(const char* aChannelId, JsonObjectPtr aValue, double aTransitionTime, bool aApply);
+  JsonObjectPtr channelValueParams(const char* aChannelId, double aValue, double aTransitionTime, bool aApply)
+    { return channelValueParams(aChannelId, JsonObject::newDouble(aValue), aTransitionTime, aApply); }
+
+  /// @brief send a setOutputChannelValue notification, throttled per channel
+  /// @param aChannelKey the channel id, or empty string for the default channel
+  /// @param aParams the notification params
+  /// @param aTransitionEnd end time of a currently running transition on that channel, or Never
+  /// @note at most one command per P44_BridgeImpl::outputCommandInterval() is sent per channel.
+  ///   Commands arriving in between replace the pending one (latest value wins), superseded commands
+  ///   are dropped and counted. A transition that is nearly done is not interrupted.
+  void notifyChannelValue(const string aChannelKey, JsonObjectPtr aParams, MLMicroSeconds aTransitionEnd = Never);
+
+  /// @brief drop a pending throttled command, because another command for the channel is sent directly
+  /// @param aChannelKey the channel id, or empty string for the default channel
+  void dropPendingChannelValue(const string aChannelKey);
+
+private:
+
+  void sendPendingChannelValue(const string aChannelKey);
+  void sendChannelValue(const string aChannelKey, JsonObjectPtr aParams);
+
+protected:
+
   virtual void initBridgedInfo(JsonObjectPtr aDeviceInfo, const char* aInputType = nullptr, const char* aInputId = nullptr) override;
   virtual void updateBridgedInfo(JsonObjectPtr aDeviceInfo) override;
   virtual void handleBridgePushProperties(JsonObjectPtr aChangedProperties) override;
@@ -209,6 +272,7 @@ protected:
   /// the hardware recommended transition time (usually provided by the bridged hardware)
   uint16_t mRecommendedTransitionTimeDS;
   MLMicroSeconds mEndOfLatestTransition;
+  double mDefaultOnLevel; ///< default on level in percent (from preset1 scene) to be applied at installation, <0 if none
 
   /// @name LevelControlDelegate
   /// @{
@@ -217,6 +281,7 @@ protected:
   virtual MLMicroSeconds endOfLatestTransition() override { return mEndOfLatestTransition; };
   /// @}
 
+  virtual void initBridgedInfo(JsonObjectPtr aDeviceInfo, const char* aInputType = nullptr, const char* aInputId = nullptr) override;
   virtual void updateBridgedInfo(JsonObjectPtr aDeviceInfo) override;
   virtual void parseOutputState(JsonObjectPtr aOutputState, JsonObjectPtr aChannelStates, UpdateMode aUpdateMode) override;
 
@@ -272,6 +337,7 @@ protected:
   virtual Identify::IdentifyTypeEnum identifyType() override { return Identify::IdentifyTypeEnum::kActuator; }
   /// @}
 
+  virtual void initBridgedInfo(JsonObjectPtr aDeviceInfo, const char* aInputType = nullptr, const char* aInputId = nullptr) override;
   virtual void updateBridgedInfo(JsonObjectPtr aDeviceInfo) override;
   virtual void parseOutputState(JsonObjectPtr aOutputState, JsonObjectPtr aChannelStates, UpdateMode aUpdateMode) override;
 
@@ -332,8 +398,21 @@ class P44_SensorImpl : public P44_InputImpl
 {
   typedef P44_InputImpl inherited;
 
+  /// @name sensor parameters from bridge query results, applied at installation
+  /// @{
+  bool mHasSensorParams;
+  bool mHasMin;
+  double mMin;
+  bool mHasMax;
+  double mMax;
+  double mTolerance;
+  /// @}
+
 public:
 
+  P44_SensorImpl();
+
+  virtual void initBridgedInfo(JsonObjectPtr aDeviceInfo, const char* aInputType = nullptr, const char* aInputId = nullptr) override;
   virtual void updateBridgedInfo(JsonObjectPtr aDeviceInfo) override;
   virtual void handleBridgePushProperties(JsonObjectPtr aChangedProperties) override;
 
@@ -0,0 +1,101 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <stddef.h>
+
+
+/// @brief bounded lock-free single producer/single consumer queue
+/// One thread may push(), and one other thread may pop() concurrently, without any locking.
+/// Items are moved in and out, so a pushed item is no longer referenced by the producer and
+/// a popped slot no longer references the item. This allows passing objects with non thread
+/// safe reference counting (like JsonObjectPtr) from one thread to the other.
+template<typename T> class SpscQueue
+{
+  std::vector<T> mSlots;
+  size_t mMask; ///< number of slots-1 (number of slots is a power of 2)
+  std::atomic<size_t> mWriteIdx; ///< index of next slot to write, only modified by the producer
+  std::atomic<size_t> mReadIdx; ///< index of next slot to read, only modified by the consumer
+
+public:
+
+  /// @param aCapacity max number of items in the queue, rounded up to the next power of 2
+  SpscQueue(size_t aCapacity) :
+    mWriteIdx(0),
+    mReadIdx(0)
+  {
+    size_t n = 1;
+    while (n<aCapacity) n <<= 1;
+    mSlots.resize(n);
+    mMask = n-1;
+  }
+
+  /// @brief add an item (producer side only)
+  /// @param aItem the item, which is moved into the queue (and is empty afterwards) when there is space
+  /// @return false if the queue is full (aItem is unchanged then)
+  bool push(T& aItem)
+  {
+    size_t w = mWriteIdx.load(std::memory_order_relaxed);
+    if (w-mReadIdx.load(std::memory_order_acquire)>mMask) return false; // full
+    mSlots[w & mMask] = std::move(aItem);
+    aItem = T();
+    mWriteIdx.store(w+1, std::memory_order_release);
+    return true;
+  }
+
+  /// @brief remove the oldest item (consumer side only)
+  /// @param aItem is assigned the item (moved out of the queue) if there is one
+  /// @return false if the queue is empty
+  bool pop(T& aItem)
+  {
+    size_t r = mReadIdx.load(std::memory_order_relaxed);
+    if (r==mWriteIdx.load(std::memory_order_acquire)) return false; // empty
+    aItem = std::move(mSlots[r & mMask]);
+    mSlots[r & mMask] = T();
+    mReadIdx.store(r+1, std::memory_order_release);
+    return true;
+  }
+
+  /// @return number of items in the queue. Exact only on the producer or consumer side, when
+  ///   called from a third thread, the value might be outdated already
+  size_t size() const
+  {
+    return mWriteIdx.load(std::memory_order_acquire)-mReadIdx.load(std::memory_order_acquire);
+  }
+
+  /// @return max number of items in the queue
+  size_t capacity() const { return mSlots.size(); }
+
+  /// @brief remove all items
+  /// @note must only be called while neither producer nor consumer access the queue
+  void clear()
+  {
+    T item;
+    while (pop(item)) item = T();
+  }
+
+};
@@ -0,0 +1,166 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "trafficmeter.h"
+
+#include <math.h>
+
+using namespace p44;
+
+// MARK: - TrafficMeter
+
+TrafficMeter::TrafficMeter() :
+  mSizeMetering(false)
+{
+  reset();
+}
+
+
+void TrafficMeter::reset()
+{
+  mSent = { 0, 0, 0 };
+  mReceived = { 0, 0, 0 };
+  mNumProcessed = 0;
+  mProcessingTime = 0;
+  mMaxProcessingTime = 0;
+}
+
+
+void TrafficMeter::sent(JsonObjectPtr aMessage)
+{
+  account(mSent, aMessage);
+}
+
+
+void TrafficMeter::received(JsonObjectPtr aMessage)
+{
+  account(mReceived, aMessage);
+}
+
+
+void TrafficMeter::account(DirectionStats& aStats, JsonObjectPtr aMessage)
+{
+  aStats.mMessages++;
+  if (mSizeMetering && aMessage) {
+    aStats.mJsonBytes += aMessage->json_str().size()+1; // plus message terminator
+    aStats.mBinaryBytes += binarySize(aMessage);
+  }
+}
+
+
+void TrafficMeter::processed(MLMicroSeconds aProcessingTime)
+{
+  mNumProcessed++;
+  mProcessingTime += aProcessingTime;
+  if (aProcessingTime>mMaxProcessingTime) mMaxProcessingTime = aProcessingTime;
+}
+
+
+/// @return size of a MessagePack header for a string, array or map with given number of bytes/elements
+static size_t headerSize(size_t aCount, size_t aFixLimit)
+{
+  if (aCount<aFixLimit) return 1; // fixstr/fixarray/fixmap
+  if (aFixLimit==32 && aCount<0x100) return 2; // str8 (no array8/map8)
+  if (aCount<0x10000) return 3;
+  return 5;
+}
+
+
+static size_t intSize(int64_t aInt)
+{
+  if (aInt>=-32 && aInt<=127) return 1; // fixint
+  if (aInt>=-128 && aInt<=255) return 2;
+  if (aInt>=-32768 && aInt<=65535) return 3;
+  if (aInt>=-2147483648LL && aInt<=4294967295LL) return 5;
+  return 9;
+}
+
+
+size_t TrafficMeter::binarySize(JsonObjectPtr aObj)
+{
+  if (!aObj) return 1; // nil
+  switch (aObj->type()) {
+    case json_type_null:
+    case json_type_boolean:
+      return 1;
+    case json_type_int:
+      return intSize(aObj->int64Value());
+    case json_type_double: {
+      double v = aObj->doubleValue();
+      if (v==floor(v) && fabs(v)<9e18) return intSize(static_cast<int64_t>(v)); // integral values can be sent as int
+      if (static_cast<double>(static_cast<float>(v))==v) return 5; // float32 is lossless
+      return 9; // float64
+    }
+    case json_type_string: {
+      size_t n = aObj->stringValue().size();
+      return headerSize(n, 32)+n;
+    }
+    case json_type_array: {
+      int n = aObj->arrayLength();
+      size_t sz = headerSize(static_cast<size_t>(n), 16);
+      for (int i=0; i<n; i++) sz += binarySize(aObj->arrayGet(i));
+      return sz;
+    }
+    case json_type_object: {
+      size_t sz = 0;
+      size_t n = 0;
+      string key;
+      JsonObjectPtr val;
+      aObj->resetKeyIteration();
+      while (aObj->nextKeyValue(key, val)) {
+        n++;
+        sz += headerSize(key.size(), 32)+key.size()+binarySize(val);
+      }
+      return headerSize(n, 16)+sz;
+    }
+  }
+  return 1;
+}
+
+
+string TrafficMeter::directionStatistics(const char* aLabel, const DirectionStats& aStats)
+{
+  string s = string_format("%s: %ld msgs", aLabel, aStats.mMessages);
+  if (mSizeMetering && aStats.mMessages>0) {
+    string_format_append(s,
+      " / %llu bytes JSON (avg %llu) / %llu bytes binary (avg %llu, %d%%)",
+      (unsigned long long)aStats.mJsonBytes, (unsigned long long)(aStats.mJsonBytes/(uint64_t)aStats.mMessages),
+      (unsigned long long)aStats.mBinaryBytes, (unsigned long long)(aStats.mBinaryBytes/(uint64_t)aStats.mMessages),
+      aStats.mJsonBytes>0 ? (int)(aStats.mBinaryBytes*100/aStats.mJsonBytes) : 0
+    );
+  }
+  return s;
+}
+
+
+string TrafficMeter::statistics()
+{
+  string s = directionStatistics("sent", mSent);
+  s += ", ";
+  s += directionStatistics("received", mReceived);
+  string_format_append(s,
+    ", processing: avg %lld uS, max %lld uS",
+    (long long)(mNumProcessed>0 ? mProcessingTime/mNumProcessed : 0), (long long)mMaxProcessingTime
+  );
+  return s;
+}
@@ -0,0 +1,88 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "p44mbrd_common.h"
+
+#include "jsonobject.hpp"
+
+using namespace p44;
+
+
+/// @brief accounting of bridge API message volume and processing cost
+/// Processing time of received messages is always accounted (cheap). Message sizes are only
+/// accounted when enabled, because this requires serializing the message once more. Sizes are
+/// recorded as JSON text (as sent on the wire) and as the size the same message would need in a
+/// compact binary encoding (MessagePack rules), to quantify what a binary transport could gain.
+class TrafficMeter
+{
+  bool mSizeMetering; ///< if set, message sizes are accounted
+
+  typedef struct {
+    long mMessages; ///< number of messages
+    uint64_t mJsonBytes; ///< accumulated size as JSON text
+    uint64_t mBinaryBytes; ///< accumulated size as compact binary encoding
+  } DirectionStats;
+
+  DirectionStats mSent; ///< outgoing messages
+  DirectionStats mReceived; ///< incoming messages
+  long mNumProcessed; ///< number of received messages processed
+  MLMicroSeconds mProcessingTime; ///< accumulated processing time of received messages
+  MLMicroSeconds mMaxProcessingTime; ///< max processing time of a single received message
+
+public:
+
+  TrafficMeter();
+
+  /// @param aEnabled enable accounting of message sizes
+  void setSizeMetering(bool aEnabled) { mSizeMetering = aEnabled; }
+
+  /// account a message sent
+  /// @param aMessage the message
+  void sent(JsonObjectPtr aMessage);
+
+  /// account a message received
+  /// @param aMessage the message
+  void received(JsonObjectPtr aMessage);
+
+  /// account processing time of a received message
+  /// @param aProcessingTime the time spent processing the message
+  void processed(MLMicroSeconds aProcessingTime);
+
+  /// reset all counters
+  void reset();
+
+  /// @return statistics as a single line of text
+  string statistics();
+
+  /// @param aObj a JSON object (or null)
+  /// @return number of bytes the object would need in MessagePack encoding
+  static size_t binarySize(JsonObjectPtr aObj);
+
+private:
+
+  void account(DirectionStats& aStats, JsonObjectPtr aMessage);
+  string directionStatistics(const char* aLabel, const DirectionStats& aStats);
+
+};
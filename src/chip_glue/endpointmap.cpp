@@ -0,0 +1,299 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "endpointmap.h"
+#include "chip_error.h"
+
+#include <platform/KeyValueStoreManager.h>
+
+#include <algorithm>
+
+using namespace chip;
+
+// Binary format (all values little endian):
+// - header: version:u8, reserved:u8, firstFreeEndpointId:u16, numEntries:u32
+// - numEntries times: uidHash:u64, endpointId:u16, lastSeen:u32
+static const uint8_t kEndpointMapVersion = 1;
+static const size_t kHeaderSize = 8;
+static const size_t kEntrySize = 14;
+static const size_t kInitialLoadBufferSize = kHeaderSize+128*kEntrySize;
+static const uint32_t kPlausibleUnixTime = 1577836800; // 2020-01-01, anything before means the clock is not yet set
+static const uint32_t kSeenResolution = 24*3600; // only update seen time once a day, to avoid KVS writes at every lookup
+static const char* kBackupSuffix = ".bak"; // KVS key suffix for the raw data of a table that could not be loaded
+static const char* kFirstFreeSuffix = ".firstFree"; // KVS key suffix for the redundantly stored first free endpointId
+
+
+static void putLE(string& aBlob, uint64_t aValue, int aBytes)
+{
+  for (int i=0; i<aBytes; i++) { aBlob.push_back(static_cast<char>(aValue & 0xFF)); aValue >>= 8; }
+}
+
+static uint64_t getLE(const uint8_t* aP, int aBytes)
+{
+  uint64_t v = 0;
+  for (int i=aBytes-1; i>=0; i--) v = (v<<8) | aP[i];
+  return v;
+}
+
+
+EndpointMap::EndpointMap(const string aKVSKey) :
+  mKVSKey(aKVSKey),
+  mFirstFreeEndpointId(kInvalidEndpointId),
+  mStoredFirstFreeEndpointId(kInvalidEndpointId),
+  mLoaded(false),
+  mLoadFailed(false),
+  mDirty(false)
+{
+}
+
+
+uint64_t EndpointMap::uidHash(const string aEndpointUID)
+{
+  // 64-bit FNV-1a
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i=0; i<aEndpointUID.size(); i++) {
+    h ^= static_cast<uint8_t>(aEndpointUID[i]);
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+
+uint32_t EndpointMap::seenTime()
+{
+  uint32_t t = static_cast<uint32_t>(time(nullptr));
+  return t<kPlausibleUnixTime ? 0 : t; // do not record seen time as long as clock is not set
+}
+
+
+EndpointMap::EntriesVector::iterator EndpointMap::findEntry(uint64_t aUIDHash)
+{
+  return std::lower_bound(mEntries.begin(), mEntries.end(), aUIDHash, [](const Entry& aEntry, uint64_t aHash) { return aEntry.mUIDHash<aHash; });
+}
+
+
+ErrorPtr EndpointMap::load()
+{
+  DeviceLayer::PersistedStorage::KeyValueStoreManager &kvs = DeviceLayer::PersistedStorage::KeyValueStoreMgr();
+  std::vector<uint8_t> buf(kInitialLoadBufferSize);
+  size_t n = 0;
+  CHIP_ERROR chiperr;
+  while (true) {
+    chiperr = kvs.Get(mKVSKey.c_str(), buf.data(), buf.size(), &n);
+    if (chiperr!=CHIP_ERROR_BUFFER_TOO_SMALL) break;
+    buf.resize(buf.size()*2);
+  }
+  mEntries.clear();
+  mLoaded = false;
+  mLoadFailed = false;
+  mDirty = false;
+  mFirstFreeEndpointId = kInvalidEndpointId;
+  mStoredFirstFreeEndpointId = kInvalidEndpointId;
+  if (chiperr==CHIP_ERROR_PERSISTED_STORAGE_VALUE_NOT_FOUND) {
+    OLOG(LOG_INFO, "no endpoint map stored yet");
+    return ErrorPtr();
+  }
+  ErrorPtr err;
+  if (chiperr!=CHIP_NO_ERROR) {
+    err = P44ChipError::err(chiperr, "loading endpoint map");
+    n = 0;
+  }
+  else if (n<kHeaderSize || buf[0]!=kEndpointMapVersion) {
+    err = TextError::err("endpoint map has invalid size (%zu) or unknown version (%d)", n, n>0 ? buf[0] : -1);
+  }
+  else if (n<kHeaderSize+static_cast<size_t>(getLE(&buf[4], 4))*kEntrySize) {
+    err = TextError::err("endpoint map truncated: %zu bytes for %zu entries", n, static_cast<size_t>(getLE(&buf[4], 4)));
+  }
+  if (Error::notOK(err)) {
+    mLoadFailed = true;
+    salvage(buf.data(), n);
+    return err;
+  }
+  mFirstFreeEndpointId = static_cast<EndpointId>(getLE(&buf[2], 2));
+  mStoredFirstFreeEndpointId = mFirstFreeEndpointId;
+  size_t numEntries = static_cast<size_t>(getLE(&buf[4], 4));
+  mEntries.reserve(numEntries);
+  const uint8_t* p = &buf[kHeaderSize];
+  for (size_t i=0; i<numEntries; i++, p+=kEntrySize) {
+    Entry e;
+    e.mUIDHash = getLE(p, 8);
+    e.mEndpointId = static_cast<EndpointId>(getLE(p+8, 2));
+    e.mLastSeen = static_cast<uint32_t>(getLE(p+10, 4));
+    mEntries.push_back(e);
+  }
+  // stored sorted, but make sure
+  if (!std::is_sorted(mEntries.begin(), mEntries.end(), [](const Entry& aA, const Entry& aB) { return aA.mUIDHash<aB.mUIDHash; })) {
+    std::sort(mEntries.begin(), mEntries.end(), [](const Entry& aA, const Entry& aB) { return aA.mUIDHash<aB.mUIDHash; });
+  }
+  mLoaded = true;
+  OLOG(LOG_INFO, "loaded %zu entries, first free endpointId=%d", mEntries.size(), mFirstFreeEndpointId);
+  return ErrorPtr();
+}
+
+
+void EndpointMap::salvage(const uint8_t* aData, size_t aSize)
+{
+  DeviceLayer::PersistedStorage::KeyValueStoreManager &kvs = DeviceLayer::PersistedStorage::KeyValueStoreMgr();
+  // keep the raw data, the table will be overwritten at next save()
+  if (aSize>0) {
+    string bakKey = mKVSKey + kBackupSuffix;
+    CHIP_ERROR chiperr = kvs.Put(bakKey.c_str(), aData, aSize);
+    if (chiperr==CHIP_NO_ERROR) {
+      OLOG(LOG_WARNING, "raw data of endpoint map that could not be loaded (%zu bytes) backed up as '%s'", aSize, bakKey.c_str());
+    }
+    else {
+      OLOG(LOG_ERR, "could not back up endpoint map that could not be loaded: %s", P44ChipError::err(chiperr)->text());
+    }
+  }
+  // recover the first free endpointId from the header, if it looks valid
+  EndpointId firstFree = kInvalidEndpointId;
+  if (aSize>=kHeaderSize && aData[0]==kEndpointMapVersion) {
+    firstFree = static_cast<EndpointId>(getLE(&aData[2], 2));
+    // recover all complete entries
+    size_t numEntries = std::min(static_cast<size_t>(getLE(&aData[4], 4)), (aSize-kHeaderSize)/kEntrySize);
+    const uint8_t* p = &aData[kHeaderSize];
+    for (size_t i=0; i<numEntries; i++, p+=kEntrySize) {
+      Entry e;
+      e.mUIDHash = getLE(p, 8);
+      e.mEndpointId = static_cast<EndpointId>(getLE(p+8, 2));
+      e.mLastSeen = static_cast<uint32_t>(getLE(p+10, 4));
+      EntriesVector::iterator pos = findEntry(e.mUIDHash);
+      if (pos==mEntries.end() || pos->mUIDHash!=e.mUIDHash) mEntries.insert(pos, e);
+    }
+  }
+  // the separately stored first free endpointId
+  EndpointId storedFirstFree;
+  string ffKey = mKVSKey + kFirstFreeSuffix;
+  if (kvs.Get(ffKey.c_str(), &storedFirstFree)==CHIP_NO_ERROR) {
+    if (firstFree==kInvalidEndpointId || storedFirstFree>firstFree) firstFree = storedFirstFree;
+  }
+  mFirstFreeEndpointId = firstFree;
+  mStoredFirstFreeEndpointId = firstFree;
+  if (firstFree!=kInvalidEndpointId) {
+    OLOG(LOG_WARNING, "recovered %zu entries and first free endpointId=%d from endpoint map that could not be loaded", mEntries.size(), firstFree);
+  }
+  else {
+    OLOG(LOG_ERR, "first free endpointId could not be recovered, endpoint map will NOT be saved to avoid re-using endpointIds");
+  }
+}
+
+
+ErrorPtr EndpointMap::save()
+{
+  if (!mDirty) return ErrorPtr();
+  if (mLoadFailed && mStoredFirstFreeEndpointId==kInvalidEndpointId) {
+    return TextError::err("stored endpoint map could not be loaded and first free endpointId is unknown, not overwriting it");
+  }
+  string blob;
+  blob.reserve(kHeaderSize+mEntries.size()*kEntrySize);
+  putLE(blob, kEndpointMapVersion, 1);
+  putLE(blob, 0, 1); // reserved
+  putLE(blob, mFirstFreeEndpointId, 2);
+  putLE(blob, mEntries.size(), 4);
+  for (EntriesVector::iterator pos = mEntries.begin(); pos!=mEntries.end(); ++pos) {
+    putLE(blob, pos->mUIDHash, 8);
+    putLE(blob, pos->mEndpointId, 2);
+    putLE(blob, pos->mLastSeen, 4);
+  }
+  DeviceLayer::PersistedStorage::KeyValueStoreManager &kvs = DeviceLayer::PersistedStorage::KeyValueStoreMgr();
+  CHIP_ERROR chiperr = kvs.Put(mKVSKey.c_str(), blob.data(), blob.size());
+  if (chiperr!=CHIP_NO_ERROR) return P44ChipError::err(chiperr, "saving endpoint map");
+  // also store first free endpointId separately, for recovery when the table gets damaged
+  EndpointId firstFree = mFirstFreeEndpointId;
+  string ffKey = mKVSKey + kFirstFreeSuffix;
+  chiperr = kvs.Put(ffKey.c_str(), firstFree);
+  if (chiperr!=CHIP_NO_ERROR) OLOG(LOG_WARNING, "could not store first free endpointId separately: %s", P44ChipError::err(chiperr)->text());
+  mStoredFirstFreeEndpointId = mFirstFreeEndpointId;
+  mDirty = false;
+  mLoaded = true;
+  mLoadFailed = false;
+  OLOG(LOG_INFO, "saved %zu entries (%zu bytes), first free endpointId=%d", mEntries.size(), blob.size(), mFirstFreeEndpointId);
+  return ErrorPtr();
+}
+
+
+EndpointId EndpointMap::lookup(const string aEndpointUID)
+{
+  uint64_t h = uidHash(aEndpointUID);
+  EntriesVector::iterator pos = findEntry(h);
+  if (pos==mEntries.end() || pos->mUIDHash!=h) return kInvalidEndpointId;
+  uint32_t now = seenTime();
+  if (now && (pos->mLastSeen>now || now-pos->mLastSeen>kSeenResolution)) {
+    pos->mLastSeen = now;
+    mDirty = true;
+  }
+  return pos->mEndpointId;
+}
+
+
+void EndpointMap::assign(const string aEndpointUID, EndpointId aEndpointId)
+{
+  uint64_t h = uidHash(aEndpointUID);
+  EntriesVector::iterator pos = findEntry(h);
+  if (pos==mEntries.end() || pos->mUIDHash!=h) {
+    Entry e;
+    e.mUIDHash = h;
+    e.mEndpointId = aEndpointId;
+    e.mLastSeen = seenTime();
+    mEntries.insert(pos, e);
+  }
+  else {
+    pos->mEndpointId = aEndpointId;
+    pos->mLastSeen = seenTime();
+  }
+  mDirty = true;
+}
+
+
+void EndpointMap::setFirstFreeEndpointId(EndpointId aFirstFreeEndpointId)
+{
+  if (aFirstFreeEndpointId!=mFirstFreeEndpointId) {
+    mFirstFreeEndpointId = aFirstFreeEndpointId;
+    mDirty = true;
+  }
+}
+
+
+size_t EndpointMap::collectGarbage(uint32_t aMaxAgeSeconds)
+{
+  uint32_t now = seenTime();
+  // Note: compare in 64 bits, large max ages (meant as "practically never") must not wrap around
+  if (aMaxAgeSeconds==0 || static_cast<uint64_t>(now)<static_cast<uint64_t>(kPlausibleUnixTime)+aMaxAgeSeconds) return 0; // no GC, or clock not set
+  uint32_t limit = now-aMaxAgeSeconds;
+  // entries last seen while clock was not set start aging now
+  for (EntriesVector::iterator pos = mEntries.begin(); pos!=mEntries.end(); ++pos) {
+    if (pos->mLastSeen==0) {
+      pos->mLastSeen = now;
+      mDirty = true;
+    }
+  }
+  size_t before = mEntries.size();
+  mEntries.erase(std::remove_if(mEntries.begin(), mEntries.end(), [limit](const Entry& aEntry) {
+    return aEntry.mLastSeen<limit;
+  }), mEntries.end());
+  size_t removed = before-mEntries.size();
+  if (removed>0) {
+    mDirty = true;
+    OLOG(LOG_NOTICE, "removed %zu endpoint mappings not seen for more than %u days", removed, aMaxAgeSeconds/(24*3600));
+  }
+  return removed;
+}
@@ -0,0 +1,115 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include "p44mbrd_common.h"
+
+#include <lib/core/DataModelTypes.h>
+
+using namespace p44;
+
+
+/// @brief compact endpointUID -> endpointId mapping table, persisted as a single binary KVS blob
+/// @note entries are kept sorted by the hash of the endpointUID, so lookups are binary searches in memory.
+///   The table also holds the first free endpointId, so a single KVS write commits all changes at once.
+class EndpointMap : public P44LoggingObj
+{
+  typedef P44LoggingObj inherited;
+
+  struct Entry {
+    uint64_t mUIDHash; ///< hash of the endpointUID
+    chip::EndpointId mEndpointId; ///< the endpointId assigned to the endpointUID
+    uint32_t mLastSeen; ///< unix time (seconds) when the endpointUID was last seen, 0 if unknown
+  };
+  typedef std::vector<Entry> EntriesVector;
+
+  string mKVSKey; ///< the KVS key to store the table
+  EntriesVector mEntries; ///< entries, sorted by mUIDHash
+  chip::EndpointId mFirstFreeEndpointId; ///< next endpointId to assign
+  chip::EndpointId mStoredFirstFreeEndpointId; ///< first free endpointId as stored (or recovered), kInvalidEndpointId if none
+  bool mLoaded; ///< set when table was loaded from KVS
+  bool mLoadFailed; ///< set when a stored table exists, but could not be loaded (completely)
+  bool mDirty; ///< set when table needs to be saved
+
+public:
+
+  /// @param aKVSKey the KVS key to load the table from and save it to
+  EndpointMap(const string aKVSKey);
+
+  virtual string logContextPrefix() override { return "EndpointMap"; }
+
+  /// @brief load the table from the KVS
+  /// @return ok if loaded, or if there is no table stored yet (check isLoaded() to distinguish), error otherwise
+  /// @note when a stored table cannot be loaded, its raw data is backed up in the KVS, and as much as
+  ///   possible is salvaged from it, in particular the first free endpointId (also stored separately),
+  ///   so endpointIds already used are not assigned again (check loadFailed()).
+  ErrorPtr load();
+
+  /// @brief save the table to the KVS (if anything has changed since last load() or save())
+  /// @return ok or error
+  /// @note refuses to save when loading a stored table failed and its first free endpointId could not
+  ///   be recovered, because the stored table would be replaced by one possibly re-using endpointIds.
+  ErrorPtr save();
+
+  /// @return true if the table was actually loaded from the KVS (false: no table stored yet, or load failed)
+  bool isLoaded() const { return mLoaded; }
+
+  /// @return true if a table is stored, but could not be loaded. firstFreeEndpointId() is the
+  ///   recovered value then, or kInvalidEndpointId if it could not be recovered.
+  bool loadFailed() const { return mLoadFailed; }
+
+  /// @return number of entries in the table
+  size_t size() const { return mEntries.size(); }
+
+  /// @brief look up the endpointId for a given endpointUID, and mark it seen
+  /// @param aEndpointUID the endpointUID
+  /// @return endpointId or kInvalidEndpointId if the endpointUID is not in the table
+  chip::EndpointId lookup(const string aEndpointUID);
+
+  /// @brief set the endpointId for a endpointUID (and mark it seen)
+  /// @param aEndpointUID the endpointUID
+  /// @param aEndpointId the endpointId to assign
+  void assign(const string aEndpointUID, chip::EndpointId aEndpointId);
+
+  /// @return first free endpointId (as loaded, or set via setFirstFreeEndpointId()), kInvalidEndpointId if none
+  chip::EndpointId firstFreeEndpointId() const { return mFirstFreeEndpointId; }
+
+  /// @param aFirstFreeEndpointId the new first free endpointId
+  void setFirstFreeEndpointId(chip::EndpointId aFirstFreeEndpointId);
+
+  /// @brief remove entries not seen for a given time
+  /// @param aMaxAgeSeconds entries not seen for longer than this are removed
+  /// @return number of entries removed
+  /// @note endpointIds are never re-assigned anyway (first free endpointId only ever increments),
+  ///   so removing entries only means a vanished device coming back much later will get a new endpointId
+  size_t collectGarbage(uint32_t aMaxAgeSeconds);
+
+private:
+
+  void salvage(const uint8_t* aData, size_t aSize);
+
+  static uint64_t uidHash(const string aEndpointUID);
+  static uint32_t seenTime();
+  EntriesVector::iterator findEntry(uint64_t aUIDHash);
+
+};
@@ -23,6 +23,7 @@
 
 
 #include "p44deviceattestationprovider.h"
+#include "mainloop.hpp"
 
 #include <crypto/CHIPCryptoPAL.h>
 #include <lib/core/CHIPError.h>
@@ -139,6 +140,12 @@ const uint8_t kDevelopmentDAC_PrivateKey_FFF1_8002[32] = {
 #endif // INCLUDE_DEVEL_FALLBACK
 
 
+P44DeviceAttestationProvider::P44DeviceAttestationProvider() :
+  mDACKeypairLoaded(false)
+{
+}
+
+
 void P44DeviceAttestationProvider::loadFromFactoryData(FactoryDataProviderPtr aFactoryDataProvider)
 {
   // initialize from factory data provider
@@ -149,6 +156,8 @@ void P44DeviceAttestationProvider::loadFromFactoryData(FactoryDataProviderPtr aF
   mPAIC = aFactoryDataProvider->getBytes("PAI"); ///< the product attestation intermediate certificate
   mDACKey = aFactoryDataProvider->getBytes("DACKey"); ///< the device attestation private key
   mDACPubKey = aFactoryDataProvider->getBytes("DACPubKey"); ///< the device attestation public key
+  // keypair will be (re)loaded from new key data at first use
+  mDACKeypairLoaded = false;
 }
 
 
@@ -202,7 +211,7 @@ static CHIP_ERROR LoadKeypairFromRaw(ByteSpan private_key, ByteSpan public_key,
 }
 
 
-CHIP_ERROR P44DeviceAttestationProvider::SignWithDeviceAttestationKey(const ByteSpan & message_to_sign, MutableByteSpan & out_span)
+CHIP_ERROR P44DeviceAttestationProvider::loadDACKeypair()
 {
   ByteSpan privKey;
   ByteSpan pubKey;
@@ -222,18 +231,42 @@ CHIP_ERROR P44DeviceAttestationProvider::SignWithDeviceAttestationKey(const Byte
   {
     pubKey = ByteSpan((uint8_t *)mDACPubKey.c_str(), mDACPubKey.size());
   }
+  // In a non-exemplary implementation, the public key is not needed here. It is used here merely because
+  // Crypto::P256Keypair is only (currently) constructable from raw keys if both private/public keys are present.
+  ReturnErrorOnFailure(LoadKeypairFromRaw(privKey, pubKey, mDACKeypair));
+  mDACKeypairLoaded = true;
+  // raw private key is no longer needed, wipe it
+  if (!mDACKey.empty()) {
+    Crypto::ClearSecretData(reinterpret_cast<uint8_t*>(&mDACKey[0]), mDACKey.size());
+    mDACKey.clear();
+  }
+  return CHIP_NO_ERROR;
+}
 
+
+CHIP_ERROR P44DeviceAttestationProvider::SignWithDeviceAttestationKey(const ByteSpan & message_to_sign, MutableByteSpan & out_span)
+{
   Crypto::P256ECDSASignature signature;
-  Crypto::P256Keypair keypair;
 
   VerifyOrReturnError(!empty(out_span), CHIP_ERROR_INVALID_ARGUMENT);
   VerifyOrReturnError(!empty(message_to_sign), CHIP_ERROR_INVALID_ARGUMENT);
   VerifyOrReturnError(out_span.size() >= signature.Capacity(), CHIP_ERROR_BUFFER_TOO_SMALL);
 
-  // In a non-exemplary implementation, the public key is not needed here. It is used here merely because
-  // Crypto::P256Keypair is only (currently) constructable from raw keys if both private/public keys are present.
-  ReturnErrorOnFailure(LoadKeypairFromRaw(privKey, pubKey, keypair));
-  ReturnErrorOnFailure(keypair.ECDSA_sign_msg(message_to_sign.data(), message_to_sign.size(), signature));
+  MLMicroSeconds start = MainLoop::now();
+  // Note: keypair is deserialized only once, at first use (i.e. when the stack is up and crypto is initialized)
+  bool firstUse = !mDACKeypairLoaded;
+  if (firstUse) {
+    ReturnErrorOnFailure(loadDACKeypair());
+  }
+  MLMicroSeconds loaded = MainLoop::now();
+  ReturnErrorOnFailure(mDACKeypair.ECDSA_sign_msg(message_to_sign.data(), message_to_sign.size(), signature));
+  if (firstUse) {
+    // one-shot measurement, to compare keypair loading cost with signing alone
+    LOG(LOG_INFO, "DAC attestation: loading keypair took %lld uS, first signature %lld uS", (long long)(loaded-start), (long long)(MainLoop::now()-loaded));
+  }
+  else {
+    LOG(LOG_DEBUG, "DAC attestation signature created in %lld uS", (long long)(MainLoop::now()-start));
+  }
 
   return CopySpanToMutableSpan(ByteSpan{ signature.ConstBytes(), signature.Length() }, out_span);
 }
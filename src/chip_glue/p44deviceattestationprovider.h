@@ -29,6 +29,7 @@
 #include "factorydataprovider.h"
 
 #include <credentials/DeviceAttestationCredsProvider.h>
+#include <crypto/CHIPCryptoPAL.h>
 
 using namespace chip;
 using namespace Credentials;
@@ -40,11 +41,19 @@ class P44DeviceAttestationProvider : public DeviceAttestationCredentialsProvider
   string mFirmwareInfo; ///< the firmware information from the certification
   string mDAC; ///< the device attestation certificate
   string mPAIC; ///< the product attestation intermediate certificate
-  string mDACKey; ///< the device attestation private key
+  string mDACKey; ///< the device attestation private key (cleared once loaded into mDACKeypair)
   string mDACPubKey; ///< the device attestation public key
 
+  Crypto::P256Keypair mDACKeypair; ///< the device attestation keypair, deserialized once for signing
+  bool mDACKeypairLoaded; ///< set when mDACKeypair is ready for use
+
+  /// @brief deserialize the DAC keypair into mDACKeypair, and clear the raw private key
+  CHIP_ERROR loadDACKeypair();
+
 public:
 
+  P44DeviceAttestationProvider();
+
   void loadFromFactoryData(FactoryDataProviderPtr aFactoryDataProvider);
 
   CHIP_ERROR GetCertificationDeclaration(MutableByteSpan & out_span) override;
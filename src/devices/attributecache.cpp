@@ -0,0 +1,117 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "attributecache.h"
+
+#include <string.h>
+
+// global cache mode and statistics over all devices
+static AttributeCache::Mode gCacheMode = AttributeCache::Mode::on;
+static long gHits = 0;
+static long gMisses = 0;
+static long gInvalidations = 0;
+static long gMismatches = 0;
+
+
+void AttributeCache::setMode(Mode aMode)
+{
+  gCacheMode = aMode;
+}
+
+
+AttributeCache::Mode AttributeCache::mode()
+{
+  return gCacheMode;
+}
+
+
+bool AttributeCache::get(chip::ClusterId aClusterId, chip::AttributeId aAttributeId, uint8_t* aBuffer, uint16_t aLength)
+{
+  ValueMap::iterator pos = mValues.find(key(aClusterId, aAttributeId));
+  if (pos==mValues.end() || pos->second.size()!=aLength) {
+    gMisses++;
+    return false;
+  }
+  memcpy(aBuffer, pos->second.data(), aLength);
+  gHits++;
+  return true;
+}
+
+
+void AttributeCache::store(chip::ClusterId aClusterId, chip::AttributeId aAttributeId, const uint8_t* aBuffer, uint16_t aLength)
+{
+  mValues[key(aClusterId, aAttributeId)].assign((const char*)aBuffer, aLength);
+}
+
+
+bool AttributeCache::verify(chip::ClusterId aClusterId, chip::AttributeId aAttributeId, const uint8_t* aBuffer, uint16_t aLength)
+{
+  string& cached = mValues[key(aClusterId, aAttributeId)];
+  bool ok = true;
+  if (!cached.empty()) {
+    if (cached.size()==aLength && memcmp(cached.data(), aBuffer, aLength)==0) {
+      gHits++;
+    }
+    else {
+      gMismatches++;
+      ok = false;
+    }
+  }
+  else {
+    gMisses++;
+  }
+  cached.assign((const char*)aBuffer, aLength);
+  return ok;
+}
+
+
+void AttributeCache::invalidate(chip::ClusterId aClusterId, chip::AttributeId aAttributeId)
+{
+  if (mValues.erase(key(aClusterId, aAttributeId))>0) gInvalidations++;
+}
+
+
+void AttributeCache::clear()
+{
+  mValues.clear();
+}
+
+
+string AttributeCache::statistics()
+{
+  const char* modeTxt = gCacheMode==Mode::off ? "off" : (gCacheMode==Mode::verify ? "verify" : "on");
+  long reads = gHits+gMisses+gMismatches;
+  return string_format(
+    "mode %s, %ld reads, %ld hits (%d%%), %ld misses, %ld invalidations, %ld mismatches",
+    modeTxt, reads, gHits, reads>0 ? (int)(gHits*100/reads) : 0, gMisses, gInvalidations, gMismatches
+  );
+}
+
+
+void AttributeCache::resetStatistics()
+{
+  gHits = 0;
+  gMisses = 0;
+  gInvalidations = 0;
+  gMismatches = 0;
+}
@@ -0,0 +1,92 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "p44mbrd_common.h"
+
+#include <lib/core/DataModelTypes.h>
+
+#include <map>
+
+using namespace p44;
+using namespace std;
+
+
+/// @brief cache for encoded values of a device's external attributes
+/// Values are stored in the encoding the matter stack expects from external attribute read callbacks,
+/// so cache hits can be served with a plain memcpy, without running through the device's
+/// handleReadAttribute() chain. Entries must be invalidated whenever the underlying value changes.
+class AttributeCache
+{
+public:
+
+  enum class Mode : uint8_t {
+    off, ///< no caching, every read goes to the device
+    on, ///< serve reads from the cache when possible
+    verify ///< read from device always and compare with cached value (to detect missing invalidations)
+  };
+
+private:
+
+  typedef std::map<uint64_t, string> ValueMap;
+  ValueMap mValues; ///< encoded values by cluster/attribute key
+
+  static inline uint64_t key(chip::ClusterId aClusterId, chip::AttributeId aAttributeId) { return ((uint64_t)aClusterId<<32) | aAttributeId; }
+
+public:
+
+  /// @param aMode caching mode for all devices
+  static void setMode(Mode aMode);
+
+  /// @return current caching mode
+  static Mode mode();
+
+  /// look up a cached value
+  /// @param aBuffer buffer to copy the value into
+  /// @param aLength size of the buffer, must match the size of the cached value
+  /// @return true if value was found and copied into aBuffer
+  bool get(chip::ClusterId aClusterId, chip::AttributeId aAttributeId, uint8_t* aBuffer, uint16_t aLength);
+
+  /// store a value
+  /// @param aBuffer the encoded value
+  /// @param aLength size of the encoded value
+  void store(chip::ClusterId aClusterId, chip::AttributeId aAttributeId, const uint8_t* aBuffer, uint16_t aLength);
+
+  /// compare a value just read from the device with the cached one, and update the cache
+  /// @return false if there was a cached value, but it differed from aBuffer
+  bool verify(chip::ClusterId aClusterId, chip::AttributeId aAttributeId, const uint8_t* aBuffer, uint16_t aLength);
+
+  /// invalidate a cached value
+  void invalidate(chip::ClusterId aClusterId, chip::AttributeId aAttributeId);
+
+  /// invalidate all cached values
+  void clear();
+
+  /// @return statistics (hits, misses, invalidations, mismatches) over all devices as a string
+  static string statistics();
+
+  /// reset the statistics counters
+  static void resetStatistics();
+
+};
@@ -64,6 +64,7 @@ BoolanStateDevice::BoolanStateDevice(IdentifyDelegate* aIdentifyDelegateP, Devic
 
 void BoolanStateDevice::updateCurrentState(bool aState, bool aIsValid, UpdateMode aUpdateMode)
 {
+  TRACE_SPAN("device", "updateCurrentState", logContextPrefix());
   if (aIsValid) {
     BooleanState::Attributes::StateValue::Set(endpointId(), aState);
     if (aUpdateMode.Has(UpdateFlags::matter)) {
@@ -129,6 +130,7 @@ void OccupancySensingDevice::didGetInstalled()
 
 void OccupancySensingDevice::updateCurrentState(bool aState, bool aIsValid, UpdateMode aUpdateMode)
 {
+  TRACE_SPAN("device", "updateCurrentState", logContextPrefix());
   using namespace OccupancySensing;
   if (aIsValid) {
     BitMask<OccupancyBitmap> b;
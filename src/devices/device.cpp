@@ -62,18 +62,18 @@ Device::Device(DeviceInfoDelegate& aDeviceInfoDelegate) :
 
 string Device::logContextPrefix()
 {
-  string ep;
-  if (endpointId()!=kInvalidEndpointId) ep = string_format(" @endpoint %d", endpointId());
-  string pep;
-  if (mPartOfComposedDevice && GetParentEndpointId()!=kInvalidEndpointId) pep = string_format(" (part of @endpoint %d)", GetParentEndpointId());
-  return string_format(
-    "%s %sdevice '%s'%s%s",
-    deviceType(),
-    mPartOfComposedDevice ? "sub" : "",
-    mDeviceInfoDelegate.name().c_str(), // bridge side name is available from start, but not node label (although the two might be in sync later)
-    ep.c_str(),
-    pep.c_str()
-  );
+  if (mLogContextPrefix.empty()) {
+    // (re)build only when needed, as this is called for every log line of the device
+    mLogContextPrefix = string_format(
+      "%s %sdevice '%s'",
+      deviceType(),
+      mPartOfComposedDevice ? "sub" : "",
+      mDeviceInfoDelegate.name().c_str() // bridge side name is available from start, but not node label (although the two might be in sync later)
+    );
+    if (endpointId()!=kInvalidEndpointId) string_format_append(mLogContextPrefix, " @endpoint %d", endpointId());
+    if (mPartOfComposedDevice && GetParentEndpointId()!=kInvalidEndpointId) string_format_append(mLogContextPrefix, " (part of @endpoint %d)", GetParentEndpointId());
+  }
+  return mLogContextPrefix;
 }
 
 
@@ -204,6 +204,9 @@ void Device::willBeInstalled()
 void Device::didGetInstalled()
 {
   SetTagList(endpointId(), mTagList);
+  // initial reachability, later changes must be reported via updateReachable()
+  mReachable = mDeviceInfoDelegate.isReachable();
+  invalidateCachedAttribute(BridgedDeviceBasicInformation::Id, BridgedDeviceBasicInformation::Attributes::Reachable::Id);
   mDeviceInfoDelegate.deviceDidGetInstalled();
   OLOG(LOG_DEBUG, "did get installed");
 }
@@ -232,6 +235,7 @@ void Device::didBecomeOperational()
 
 void Device::willBeDisabled()
 {
+  mAttributeCache.clear();
 }
 
 
@@ -241,6 +245,7 @@ void Device::updateReachable(bool aReachable, UpdateMode aUpdateMode)
 {
   if (mReachable!=aReachable || aUpdateMode.Has(UpdateFlags::forced)) {
     mReachable = aReachable;
+    invalidateCachedAttribute(BridgedDeviceBasicInformation::Id, BridgedDeviceBasicInformation::Attributes::Reachable::Id);
     OLOG(LOG_INFO, "Updating reachable to %s - updatemode=%d", mReachable ? "REACHABLE" : "OFFLINE", aUpdateMode.Raw());
     if (aUpdateMode.Has(UpdateFlags::matter)) {
       reportAttributeChange(BridgedDeviceBasicInformation::Id, BridgedDeviceBasicInformation::Attributes::Reachable::Id);
@@ -253,6 +258,7 @@ void Device::updateNodeLabel(const string aNodeLabel, UpdateMode aUpdateMode)
   if (mNodeLabel!=aNodeLabel || aUpdateMode.Has(UpdateFlags::forced)) {
     OLOG(LOG_INFO, "Updating node label to '%s' - updatemode=%d", aNodeLabel.c_str(), aUpdateMode.Raw());
     mNodeLabel = aNodeLabel;
+    invalidateCachedAttribute(BridgedDeviceBasicInformation::Id, BridgedDeviceBasicInformation::Attributes::NodeLabel::Id);
     if (aUpdateMode.Has(UpdateFlags::bridged)) {
       // propagate to native device
       if (!mDeviceInfoDelegate.changeName(mNodeLabel)) {
@@ -260,6 +266,8 @@ void Device::updateNodeLabel(const string aNodeLabel, UpdateMode aUpdateMode)
         OLOG(LOG_WARNING, "cannot set bridged device's name to nodeLabel");
       }
     }
+    // bridge side name might have changed
+    invalidateLogContextPrefix();
     if (aUpdateMode.Has(UpdateFlags::matter)) {
       reportAttributeChange(BridgedDeviceBasicInformation::Id, BridgedDeviceBasicInformation::Attributes::NodeLabel::Id);
     }
@@ -268,6 +276,33 @@ void Device::updateNodeLabel(const string aNodeLabel, UpdateMode aUpdateMode)
 
 // MARK: Attribute access
 
+Status Device::readAttribute(ClusterId clusterId, chip::AttributeId attributeId, uint8_t * buffer, uint16_t maxReadLength)
+{
+  AttributeCache::Mode mode = AttributeCache::mode();
+  if (mode==AttributeCache::Mode::off || !isCacheableAttribute(clusterId, attributeId)) {
+    return handleReadAttribute(clusterId, attributeId, buffer, maxReadLength);
+  }
+  if (mode==AttributeCache::Mode::on && mAttributeCache.get(clusterId, attributeId, buffer, maxReadLength)) {
+    return Status::Success;
+  }
+  // not cached (or verifying): read from device
+  // Note: clear buffer first, to make sure parts not written by the handler (e.g. after string contents) are defined
+  memset(buffer, 0, maxReadLength);
+  Status ret = handleReadAttribute(clusterId, attributeId, buffer, maxReadLength);
+  if (ret==Status::Success) {
+    if (mode==AttributeCache::Mode::verify) {
+      if (!mAttributeCache.verify(clusterId, attributeId, buffer, maxReadLength)) {
+        OLOG(LOG_WARNING, "cached value of attr 0x%04x in cluster 0x%04x was stale (missing invalidation)", (int)attributeId, (int)clusterId);
+      }
+    }
+    else {
+      mAttributeCache.store(clusterId, attributeId, buffer, maxReadLength);
+    }
+  }
+  return ret;
+}
+
+
 Status Device::handleReadAttribute(ClusterId clusterId, chip::AttributeId attributeId, uint8_t * buffer, uint16_t maxReadLength)
 {
   if (clusterId==BasicInformation::Id) {
@@ -276,14 +311,13 @@ Status Device::handleReadAttribute(ClusterId clusterId, chip::AttributeId attrib
   else if (clusterId==BridgedDeviceBasicInformation::Id) {
     // Reachable flag
     if (attributeId == BridgedDeviceBasicInformation::Attributes::Reachable::Id) {
-      return getAttr(buffer, maxReadLength, mDeviceInfoDelegate.isReachable());
+      // Note: the state last set via updateReachable(), which also invalidates the cached value
+      return getAttr(buffer, maxReadLength, mReachable);
     }
     // Writable Node Label
     if (attributeId == BridgedDeviceBasicInformation::Attributes::NodeLabel::Id) {
       FOCUSOLOG("reading node label: %s", mNodeLabel.c_str());
-      MutableByteSpan zclNameSpan(buffer, maxReadLength);
-      MakeZclCharString(zclNameSpan, mNodeLabel.substr(0,maxReadLength-1).c_str());
-      return Status::Success;
+      return getAttrString(buffer, maxReadLength, mNodeLabel);
     }
   }
   return Status::Failure;
@@ -315,6 +349,8 @@ void Device::handleAttributeChange(ClusterId clusterId, chip::AttributeId attrib
 
 void Device::reportAttributeChange(ClusterId aClusterId, chip::AttributeId aAttributeId)
 {
+  TRACE_EVENT("matter", "reportAttributeChange", string_format("cluster 0x%04x attr 0x%04x - %s", (int)aClusterId, (int)aAttributeId, logContextPrefix().c_str()));
+  invalidateCachedAttribute(aClusterId, aAttributeId);
   MatterReportingAttributeChangeCallback(endpointId(), aClusterId, aAttributeId);
 }
 
@@ -369,6 +405,7 @@ bool IdentifiableDevice::updateIdentifyTime(uint16_t aIdentifyTime, UpdateMode a
   if (aIdentifyTime!=mIdentifyTime || aUpdateMode.Has(UpdateFlags::forced)) {
     OLOG(LOG_INFO, "updating identifyTime to %hu - updatemode=0x%x", aIdentifyTime, aUpdateMode.Raw());
     mIdentifyTime = aIdentifyTime;
+    invalidateCachedAttribute(Identify::Id, Identify::Attributes::IdentifyTime::Id);
     if (aUpdateMode.Has(UpdateFlags::bridged)) {
       mIdentifyTickTimer.cancel();
       if (mIdentifyDelegateP) {
@@ -38,6 +38,8 @@
 
 #include "p44mbrd_main.h"
 #include "matter_utils.h"
+#include "attributecache.h"
+#include "eventtrace.h"
 
 #include "logger.hpp"
 
@@ -144,6 +146,10 @@ class Device : public p44::P44LoggingObj
   string mNodeLabel; ///< currently reported node label, usually synchronized with actual device name
   /// @}
 
+  AttributeCache mAttributeCache; ///< cached encoded values of external attributes
+
+  string mLogContextPrefix; ///< cached log context prefix, empty when it needs to be (re)built
+
 public:
 
   /// @param aDeviceInfoDelegate object reference for implementation of device info handling
@@ -152,8 +158,13 @@ public:
   virtual ~Device();
 
   /// @return a prefix string identifying the device for log messages issued via the OLOG macro
+  /// @note the prefix is built on first use only and then cached until invalidateLogContextPrefix() is called
   virtual string logContextPrefix() override;
 
+  /// @brief invalidate the cached log context prefix
+  /// @note must be called whenever information shown in the prefix (name, endpoint, parent endpoint) changes
+  inline void invalidateLogContextPrefix() { mLogContextPrefix.clear(); };
+
   /// @return a short name for the type of device
   virtual const char *deviceType() = 0;
 
@@ -181,6 +192,10 @@ public:
   /// @note valid only after device setup is complete and device is operational
   inline chip::EndpointId GetParentEndpointId() const { return mParentEndpointId; };
 
+  /// @return the dynamic endpoint index of this device
+  /// @note valid only after device setup is complete
+  inline chip::EndpointId dynamicEndpointIdx() const { return mDynamicEndpointIdx; };
+
   /// @return true when this device endpoint is part of a composed device
   inline bool isPartOfComposedDevice() const { return mPartOfComposedDevice; };
 
@@ -210,6 +225,8 @@ public:
 
   /// @brief update the reachable status.
   /// Device adapters should call this when detecting reachability changes
+  /// @note the Reachable attribute is served from the status set here (initially, from the
+  ///   device info delegate's isReachable() at installation)
   void updateReachable(bool aReachable, UpdateMode aUpdateMode);
 
   /// @brief update the node label.
@@ -223,13 +240,13 @@ public:
   /// These must ONLY be called during setup of a device, but NOT while a device is already operational.
   /// @{
 
-  inline void SetEndpointId(chip::EndpointId aID) { mEndpointId = aID; };
+  inline void SetEndpointId(chip::EndpointId aID) { mEndpointId = aID; invalidateLogContextPrefix(); };
   inline void SetDynamicEndpointIdx(chip::EndpointId aIdx) { mDynamicEndpointIdx = aIdx; };
-  inline void SetParentEndpointId(chip::EndpointId aID) { mParentEndpointId = aID; };
+  inline void SetParentEndpointId(chip::EndpointId aID) { mParentEndpointId = aID; invalidateLogContextPrefix(); };
   inline void initNodeLabel(const string aName) { mNodeLabel = aName; };
 
   /// @brief Set this device to behave as part of a composed device
-  inline void flagAsPartOfComposedDevice() { mPartOfComposedDevice = true; };
+  inline void flagAsPartOfComposedDevice() { mPartOfComposedDevice = true; invalidateLogContextPrefix(); };
 
   /// @}
 
@@ -256,6 +273,10 @@ public:
   /// @brief called immediately before device gets disabled
   virtual void willBeDisabled();
 
+  /// external attribute read access, served from the attribute cache when possible
+  /// @note this is what the external attribute callback must call, handleReadAttribute() is only called on cache misses
+  Status readAttribute(ClusterId clusterId, chip::AttributeId attributeId, uint8_t * buffer, uint16_t maxReadLength);
+
   /// handler for external attribute read access
   virtual Status handleReadAttribute(ClusterId clusterId, chip::AttributeId attributeId, uint8_t * buffer, uint16_t maxReadLength);
 
@@ -266,8 +287,13 @@ public:
   virtual void handleAttributeChange(ClusterId clusterId, chip::AttributeId attributeId);
 
   /// utility to report attribute changes in this device to matter for reporting in subscriptions
+  /// @note this also invalidates the cached value of the attribute
   void reportAttributeChange(ClusterId aClusterId, chip::AttributeId aAttributeId);
 
+  /// utility to invalidate the cached value of an external attribute
+  /// @note must be called whenever an external attribute value changes, even if the change is not reported to matter
+  inline void invalidateCachedAttribute(ClusterId aClusterId, chip::AttributeId aAttributeId) { mAttributeCache.invalidate(aClusterId, aAttributeId); };
+
 protected:
 
   /// Use cluster declarations from a ZAP template endpoint during device setup
@@ -281,6 +307,11 @@ protected:
   ///   of all to-be-bridged devices. This template endpoint must be set to disabled)
   void useClusterTemplates(const Span<EmberAfClusterSpec>& aTemplateClusterSpecList);
 
+  /// @return true if the external attribute's value can be cached
+  /// @note subclasses must override this to exclude attributes that change without invalidateCachedAttribute()
+  ///   being called, such as values derived from the current time
+  virtual bool isCacheableAttribute(ClusterId clusterId, chip::AttributeId attributeId) { return true; };
+
   /// called to have the final leaf class declare the correct device type list
   virtual bool finalizeDeviceDeclaration() = 0;
 
@@ -307,6 +338,19 @@ protected:
     }
   }
 
+  /// utility for returning (short) string attributes in HandleReadAttribute implementations
+  /// @note encodes directly from aString into the length-prefixed ZCL string buffer, truncating if needed
+  static inline Status getAttrString(uint8_t* aBuffer, uint16_t aMaxReadLength, const string& aString)
+  {
+    if (aMaxReadLength<1) return Status::Failure;
+    size_t n = aString.size();
+    if (n>aMaxReadLength-1u) n = aMaxReadLength-1u;
+    if (n>0xFE) n = 0xFE; // 0xFF is reserved for null string
+    aBuffer[0] = static_cast<uint8_t>(n);
+    memcpy(aBuffer+1, aString.data(), n);
+    return Status::Success;
+  }
+
   /// utility for preparing attribute data in HandleWriteAttribute implementations
   template <typename T> static inline Status setAttr(T &aValue, uint8_t* aBuffer)
   {
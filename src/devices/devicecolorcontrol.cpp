@@ -125,6 +125,8 @@ bool DeviceColorControl::updateCurrentColorMode(InternalColorMode aColorMode, Up
   ) {
     OLOG(LOG_INFO, "set color mode to 0x%02x (InternalColorMode) - updatemode=0x%x", (int)aColorMode, aUpdateMode.Raw());
     mColorMode = aColorMode;
+    invalidateCachedAttribute(ColorControl::Id, ColorControl::Attributes::ColorMode::Id);
+    invalidateCachedAttribute(ColorControl::Id, ColorControl::Attributes::EnhancedColorMode::Id);
     if (aUpdateMode.Has(UpdateFlags::bridged)) {
       switch (mColorMode) {
         case InternalColorMode::hs:
@@ -161,10 +163,12 @@ bool DeviceColorControl::updateCurrentColorMode(InternalColorMode aColorMode, Up
 
 bool DeviceColorControl::updateCurrentHue(uint8_t aHue, UpdateMode aUpdateMode, uint16_t aTransitionTimeDS)
 {
+  TRACE_SPAN("device", "updateCurrentHue", logContextPrefix());
   bool changed = aHue!=mHue;
   if (changed || aUpdateMode.Has(UpdateFlags::forced)) {
     OLOG(LOG_INFO, "set hue to 0x%02x (matter-units) - updatemode=0x%x", aHue, aUpdateMode.Raw());
     mHue = aHue;
+    invalidateCachedAttribute(ColorControl::Id, ColorControl::Attributes::CurrentHue::Id);
     aUpdateMode.Clear(UpdateFlags::forced); // do not force color mode changes
     if (!updateCurrentColorMode(InternalColorMode::hs, aUpdateMode, aTransitionTimeDS)) {
       // color mode has not changed, must separately update hue (otherwise, color mode change already sends H+S)
@@ -184,10 +188,12 @@ bool DeviceColorControl::updateCurrentHue(uint8_t aHue, UpdateMode aUpdateMode,
 
 bool DeviceColorControl::updateCurrentSaturation(uint8_t aSaturation, UpdateMode aUpdateMode, uint16_t aTransitionTimeDS)
 {
+  TRACE_SPAN("device", "updateCurrentSaturation", logContextPrefix());
   bool changed = aSaturation!=mSaturation;
   if (changed || aUpdateMode.Has(UpdateFlags::forced)) {
     OLOG(LOG_INFO, "set saturation to 0x%02x (matter-units) - updatemode=0x%x", aSaturation, aUpdateMode.Raw());
     mSaturation = aSaturation;
+    invalidateCachedAttribute(ColorControl::Id, ColorControl::Attributes::CurrentSaturation::Id);
     aUpdateMode.Clear(UpdateFlags::forced); // do not force color mode changes
     if (!updateCurrentColorMode(InternalColorMode::hs, aUpdateMode, aTransitionTimeDS)) {
       // color mode has not changed, must separately update saturation (otherwise, color mode change already sendt H+S)
@@ -207,12 +213,14 @@ bool DeviceColorControl::updateCurrentSaturation(uint8_t aSaturation, UpdateMode
 
 bool DeviceColorControl::updateCurrentColortemp(uint16_t aColortemp, UpdateMode aUpdateMode, uint16_t aTransitionTimeDS)
 {
+  TRACE_SPAN("device", "updateCurrentColortemp", logContextPrefix());
   bool changed = aColortemp!=mColorTemp;
   if (changed || aUpdateMode.Has(UpdateFlags::forced)) {
     OLOG(LOG_INFO, "set colortemp to 0x%04x (matter-units) - updatemode=0x%x", aColortemp, aUpdateMode.Raw());
     mColorTemp = aColortemp;
     if (mColorTemp<COLOR_TEMP_PHYSICAL_MIN) mColorTemp = COLOR_TEMP_PHYSICAL_MIN;
     else if (mColorTemp>COLOR_TEMP_PHYSICAL_MAX) mColorTemp = COLOR_TEMP_PHYSICAL_MAX;
+    invalidateCachedAttribute(ColorControl::Id, ColorControl::Attributes::ColorTemperatureMireds::Id);
     aUpdateMode.Clear(UpdateFlags::forced); // do not force color mode changes
     if (!updateCurrentColorMode(InternalColorMode::ct, aUpdateMode, aTransitionTimeDS)) {
       // color mode has not changed, must separately update colortemp (otherwise, color mode change already sends CT)
@@ -232,10 +240,12 @@ bool DeviceColorControl::updateCurrentColortemp(uint16_t aColortemp, UpdateMode
 
 bool DeviceColorControl::updateCurrentX(uint16_t aX, UpdateMode aUpdateMode, uint16_t aTransitionTimeDS)
 {
+  TRACE_SPAN("device", "updateCurrentX", logContextPrefix());
   bool changed = aX!=mX;
   if (changed || aUpdateMode.Has(UpdateFlags::forced)) {
     OLOG(LOG_INFO, "set X to 0x%04x (matter-units) - updatemode=0x%x", aX, aUpdateMode.Raw());
     mX = aX;
+    invalidateCachedAttribute(ColorControl::Id, ColorControl::Attributes::CurrentX::Id);
     aUpdateMode.Clear(UpdateFlags::forced); // do not force color mode changes
     if (!updateCurrentColorMode(InternalColorMode::xy, aUpdateMode, aTransitionTimeDS)) {
       // color mode has not changed, must separately update X (otherwise, color mode change already sends X+Y)
@@ -255,10 +265,12 @@ bool DeviceColorControl::updateCurrentX(uint16_t aX, UpdateMode aUpdateMode, uin
 
 bool DeviceColorControl::updateCurrentY(uint16_t aY, UpdateMode aUpdateMode, uint16_t aTransitionTimeDS)
 {
+  TRACE_SPAN("device", "updateCurrentY", logContextPrefix());
   bool changed = aY!=mY;
   if (changed || aUpdateMode.Has(UpdateFlags::forced)) {
     OLOG(LOG_INFO, "set Y to 0x%04x (matter-units) - updatemode=0x%x", aY, aUpdateMode.Raw());
     mY = aY;
+    invalidateCachedAttribute(ColorControl::Id, ColorControl::Attributes::CurrentY::Id);
     aUpdateMode.Clear(UpdateFlags::forced); // do not force color mode changes
     if (!updateCurrentColorMode(InternalColorMode::xy, aUpdateMode, aTransitionTimeDS)) {
       // color mode has not changed, must separately update Y (otherwise, color mode change already sends X+Y)
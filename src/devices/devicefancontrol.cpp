@@ -98,6 +98,7 @@ void DeviceFanControl::setDefaultOnLevel(double aLevelPercent)
 
 bool DeviceFanControl::updateLevel(double aLevelPercent, Device::UpdateMode aUpdateMode)
 {
+  TRACE_SPAN("device", "updateLevel", logContextPrefix());
   Percent currentLevel = static_cast<uint8_t>(aLevelPercent);
   Percent previousLevel;
   PercentCurrent::Get(endpointId(), &previousLevel);
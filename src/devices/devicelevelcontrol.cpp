@@ -83,6 +83,7 @@ void DeviceLevelControl::changeOnOff_impl(bool aOn)
 
 bool DeviceLevelControl::updateCurrentLevel(uint8_t aAmount, int8_t aDirection, uint16_t aTransitionTimeDs, bool aWithOnOff, UpdateMode aUpdateMode)
 {
+  TRACE_SPAN("device", "updateCurrentLevel", logContextPrefix());
   uint8_t minlevel, maxlevel;
   Attributes::MinLevel::Get(endpointId(), &minlevel);
   Attributes::MaxLevel::Get(endpointId(), &maxlevel);
@@ -107,6 +108,7 @@ bool DeviceLevelControl::updateCurrentLevel(uint8_t aAmount, int8_t aDirection,
       else level = minlevel; // set to minimum, but not to off
     }
     mLevel = static_cast<uint8_t>(level);
+    invalidateCachedAttribute(LevelControl::Id, LevelControl::Attributes::CurrentLevel::Id);
     if (aUpdateMode.Has(UpdateFlags::bridged)) {
       mLevelControlDelegate.setLevel(
         (double)(level-minlevel)/(maxlevel-minlevel)*100, // bridge side is always 0..100%, mapped to minlevel..maxlevel
@@ -146,6 +148,7 @@ void DeviceLevelControl::setDefaultOnLevel(double aLevelPercent)
 
 bool DeviceLevelControl::updateLevel(double aLevelPercent, UpdateMode aUpdateMode)
 {
+  TRACE_SPAN("device", "updateLevel", logContextPrefix());
   uint8_t minlevel, maxlevel;
   Attributes::MinLevel::Get(endpointId(), &minlevel);
   Attributes::MaxLevel::Get(endpointId(), &maxlevel);
@@ -457,6 +460,14 @@ Status DeviceLevelControl::handleReadAttribute(ClusterId clusterId, chip::Attrib
 }
 
 
+bool DeviceLevelControl::isCacheableAttribute(ClusterId clusterId, chip::AttributeId attributeId)
+{
+  // remaining time is calculated from current time, cannot be cached
+  if (clusterId==LevelControl::Id && attributeId==LevelControl::Attributes::RemainingTime::Id) return false;
+  return inherited::isCacheableAttribute(clusterId, attributeId);
+}
+
+
 Status DeviceLevelControl::handleWriteAttribute(ClusterId clusterId, chip::AttributeId attributeId, uint8_t * buffer)
 {
   if (clusterId==LevelControl::Id) {
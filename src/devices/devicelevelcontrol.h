@@ -106,6 +106,7 @@ public:
   /// @{
   virtual Status handleReadAttribute(ClusterId clusterId, chip::AttributeId attributeId, uint8_t * buffer, uint16_t maxReadLength) override;
   virtual Status handleWriteAttribute(ClusterId clusterId, chip::AttributeId attributeId, uint8_t * buffer) override;
+  virtual bool isCacheableAttribute(ClusterId clusterId, chip::AttributeId attributeId) override;
   /// @}
 
   /// @name handlers for command implementations
@@ -74,9 +74,11 @@ void DeviceOnOff::changeOnOff_impl(bool aOn)
 
 bool DeviceOnOff::updateOnOff(bool aOn, UpdateMode aUpdateMode)
 {
+  TRACE_SPAN("device", "updateOnOff", logContextPrefix());
   if (aOn!=mOn || aUpdateMode.Has(UpdateFlags::forced)) {
     OLOG(LOG_INFO, "updating onOff to %s - updatemode=0x%x", aOn ? "ON" : "OFF", aUpdateMode.Raw());
     mOn = aOn;
+    invalidateCachedAttribute(OnOff::Id, OnOff::Attributes::OnOff::Id);
     if (aUpdateMode.Has(UpdateFlags::bridged)) {
       changeOnOff_impl(mOn);
     }
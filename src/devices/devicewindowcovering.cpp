@@ -32,6 +32,8 @@
 
 #include <app/clusters/window-covering-server/window-covering-server.h>
 
+#include <algorithm>
+
 using namespace Clusters;
 
 // MARK: - DeviceWindowCovering
@@ -44,13 +46,21 @@ static const EmberAfDeviceType gWindowCoveringTypes[] = {
 
 DeviceWindowCovering::DeviceWindowCovering(WindowCoveringDelegate& aWindowCoveringDelegate, IdentifyDelegate* aIdentifyDelegateP, DeviceInfoDelegate& aDeviceInfoDelegate) :
   inherited(aIdentifyDelegateP, aDeviceInfoDelegate),
-  mWindowCoveringDelegate(aWindowCoveringDelegate)
+  mWindowCoveringDelegate(aWindowCoveringDelegate),
+  mLiftMotion(WINDOWCOVERING_DEFAULT_LIFT_TRAVEL_TIME),
+  mTiltMotion(WINDOWCOVERING_DEFAULT_TILT_TRAVEL_TIME)
 {
   // - declare onoff device specific clusters
   useClusterTemplates(Span<EmberAfClusterSpec>(gWindowCoveringClusters));
 }
 
 
+DeviceWindowCovering::~DeviceWindowCovering()
+{
+  sMovingCoverings.remove(this);
+}
+
+
 string DeviceWindowCovering::description()
 {
   string s = inherited::description();
@@ -80,6 +90,22 @@ CHIP_ERROR DeviceWindowCovering::HandleMovement(WindowCovering::WindowCoveringTy
 {
   OLOG(LOG_INFO, "WindowCoveringDelegate::HandleMovement: start moving");
   mWindowCoveringDelegate.startMovement(type);
+  // start predicting the current position
+  WindowCovering::NPercent100ths target;
+  if (type==WindowCovering::WindowCoveringType::Lift) {
+    WindowCovering::Attributes::TargetPositionLiftPercent100ths::Get(endpointId(), target);
+  }
+  else {
+    WindowCovering::Attributes::TargetPositionTiltPercent100ths::Get(endpointId(), target);
+  }
+  if (!target.IsNull()) {
+    AxisMotion& m = axisMotion(type);
+    Percent100ths current = currentPosition(type);
+    // Note: only a movement starting from standstill can be used for learning travel times
+    m.mLearnStartPos = current;
+    m.mLearnStartTime = m.mMoving ? Never : MainLoop::now();
+    startPrediction(type, current, target.Value());
+  }
   return CHIP_NO_ERROR;
 }
 
@@ -96,5 +122,204 @@ CHIP_ERROR DeviceWindowCovering::HandleStopMotion()
 {
   OLOG(LOG_INFO, "WindowCoveringDelegate::HandleStopMotion: stop moving");
   mWindowCoveringDelegate.stopMovement();
+  // freeze predicted positions, cluster will set target positions to current positions
+  stopPrediction(WindowCovering::WindowCoveringType::Lift);
+  stopPrediction(WindowCovering::WindowCoveringType::Tilt);
   return CHIP_NO_ERROR;
 }
+
+
+// MARK: motion model
+
+std::list<DeviceWindowCovering*> DeviceWindowCovering::sMovingCoverings;
+MLTicket DeviceWindowCovering::sMotionTicket;
+
+static const int kFullTravel = 100*100; ///< full travel in Percent100ths
+static const int kMinLearnDistance = 20*100; ///< movements must be at least this long to learn travel time from
+static const MLMicroSeconds kMinTravelTime = 500*MilliSecond; ///< learned full travel times below this are considered implausible
+static const MLMicroSeconds kMaxTravelTime = 5*Minute; ///< learned full travel times above this are considered implausible
+static const MLMicroSeconds kMinConfirmationTimeout = 10*Second; ///< minimum time to wait for confirmation of reaching target
+
+
+DeviceWindowCovering::AxisMotion::AxisMotion(MLMicroSeconds aDefaultTravelTime) :
+  mMoving(false),
+  mStartPos(0),
+  mStartTime(Never),
+  mTargetPos(0),
+  mLearnStartPos(0),
+  mLearnStartTime(Never),
+  mTravelTimeOpen(aDefaultTravelTime),
+  mTravelTimeClose(aDefaultTravelTime)
+{
+}
+
+
+MLMicroSeconds DeviceWindowCovering::AxisMotion::travelTime(Percent100ths aFrom, Percent100ths aTo) const
+{
+  // Note: 100% is fully closed/down
+  int dist = abs((int)aTo-(int)aFrom);
+  return (aTo<aFrom ? mTravelTimeOpen : mTravelTimeClose)*dist/kFullTravel;
+}
+
+
+void DeviceWindowCovering::setCurrentPosition(WindowCovering::WindowCoveringType aAxis, Percent100ths aPosition)
+{
+  // Note: these also update the operational status
+  if (aAxis==WindowCovering::WindowCoveringType::Lift) {
+    WindowCovering::LiftPositionSet(endpointId(), WindowCovering::NPercent100ths(aPosition));
+  }
+  else {
+    WindowCovering::TiltPositionSet(endpointId(), WindowCovering::NPercent100ths(aPosition));
+  }
+}
+
+
+Percent100ths DeviceWindowCovering::currentPosition(WindowCovering::WindowCoveringType aAxis)
+{
+  WindowCovering::NPercent100ths current;
+  if (aAxis==WindowCovering::WindowCoveringType::Lift) {
+    WindowCovering::Attributes::CurrentPositionLiftPercent100ths::Get(endpointId(), current);
+  }
+  else {
+    WindowCovering::Attributes::CurrentPositionTiltPercent100ths::Get(endpointId(), current);
+  }
+  return current.IsNull() ? 0 : current.Value();
+}
+
+
+void DeviceWindowCovering::startPrediction(WindowCovering::WindowCoveringType aAxis, Percent100ths aFrom, Percent100ths aTo)
+{
+  AxisMotion& m = axisMotion(aAxis);
+  m.mStartPos = aFrom;
+  m.mStartTime = MainLoop::now();
+  m.mTargetPos = aTo;
+  m.mMoving = abs((int)aTo-(int)aFrom)>kTargetTolerance;
+  FOCUSOLOG("%s prediction: from %d to %d in %lld mS",
+    aAxis==WindowCovering::WindowCoveringType::Lift ? "lift" : "tilt",
+    aFrom, aTo, (long long)(m.travelTime(aFrom, aTo)/MilliSecond)
+  );
+  updateMovingList();
+}
+
+
+void DeviceWindowCovering::stopPrediction(WindowCovering::WindowCoveringType aAxis)
+{
+  AxisMotion& m = axisMotion(aAxis);
+  m.mMoving = false;
+  m.mLearnStartTime = Never;
+  updateMovingList();
+}
+
+
+bool DeviceWindowCovering::predictionStep(WindowCovering::WindowCoveringType aAxis, MLMicroSeconds aNow)
+{
+  AxisMotion& m = axisMotion(aAxis);
+  if (!m.mMoving) return false;
+  MLMicroSeconds duration = m.travelTime(m.mStartPos, m.mTargetPos);
+  MLMicroSeconds elapsed = aNow-m.mStartTime;
+  int p = m.mTargetPos;
+  if (elapsed>=2*duration+kMinConfirmationTimeout) {
+    // bridge did not confirm end of movement in time, assume target reached
+    OLOG(LOG_INFO, "no confirmation of reaching %s target, assuming %d reached", aAxis==WindowCovering::WindowCoveringType::Lift ? "lift" : "tilt", m.mTargetPos);
+    m.mMoving = false;
+    m.mLearnStartTime = Never;
+    setCurrentPosition(aAxis, m.mTargetPos);
+    return false;
+  }
+  if (elapsed<duration) {
+    p = m.mStartPos + (int)(((int64_t)m.mTargetPos-m.mStartPos)*elapsed/duration);
+  }
+  // do not predict reaching the target, as this would end the operation in the cluster
+  // before the bridge actually reports the covering to have stopped.
+  int dir = m.mTargetPos>m.mStartPos ? 1 : -1;
+  if ((m.mTargetPos-p)*dir<kTargetTolerance) p = m.mTargetPos-dir*kTargetTolerance;
+  if ((p-m.mStartPos)*dir<0) p = m.mStartPos;
+  if (p!=currentPosition(aAxis)) {
+    setCurrentPosition(aAxis, static_cast<Percent100ths>(p));
+  }
+  return true;
+}
+
+
+void DeviceWindowCovering::updateMovingList()
+{
+  bool moving = mLiftMotion.mMoving || mTiltMotion.mMoving;
+  bool listed = std::find(sMovingCoverings.begin(), sMovingCoverings.end(), this)!=sMovingCoverings.end();
+  if (moving && !listed) {
+    sMovingCoverings.push_back(this);
+    if (!sMotionTicket) {
+      sMotionTicket.executeOnce(boost::bind(&DeviceWindowCovering::motionTimerHandler), WINDOWCOVERING_PROGRESS_INTERVAL);
+    }
+  }
+  else if (!moving && listed) {
+    sMovingCoverings.remove(this);
+  }
+}
+
+
+void DeviceWindowCovering::motionTimerHandler()
+{
+  MLMicroSeconds now = MainLoop::now();
+  std::list<DeviceWindowCovering*>::iterator pos = sMovingCoverings.begin();
+  while (pos!=sMovingCoverings.end()) {
+    DeviceWindowCovering* dev = *pos;
+    bool moving = dev->predictionStep(WindowCovering::WindowCoveringType::Lift, now);
+    moving = dev->predictionStep(WindowCovering::WindowCoveringType::Tilt, now) || moving;
+    if (moving) ++pos;
+    else pos = sMovingCoverings.erase(pos);
+  }
+  if (!sMovingCoverings.empty()) {
+    sMotionTicket.executeOnce(boost::bind(&DeviceWindowCovering::motionTimerHandler), WINDOWCOVERING_PROGRESS_INTERVAL);
+  }
+  else {
+    sMotionTicket.cancel();
+  }
+}
+
+
+void DeviceWindowCovering::updateActualMotion(WindowCovering::WindowCoveringType aAxis, Percent100ths aTarget, const WindowCovering::NPercent100ths& aCurrent, bool aMoving)
+{
+  AxisMotion& m = axisMotion(aAxis);
+  MLMicroSeconds now = MainLoop::now();
+  if (!aMoving) {
+    // not moving (any more), current is actual or target
+    Percent100ths pos = aCurrent.IsNull() ? aTarget : aCurrent.Value();
+    if (m.mMoving && m.mLearnStartTime!=Never && abs((int)pos-(int)m.mTargetPos)<=kTargetTolerance) {
+      // movement observed from start to target, learn travel time
+      int dist = abs((int)pos-(int)m.mLearnStartPos);
+      if (dist>=kMinLearnDistance) {
+        MLMicroSeconds fullTravel = (now-m.mLearnStartTime)*kFullTravel/dist;
+        if (fullTravel>=kMinTravelTime && fullTravel<=kMaxTravelTime) {
+          MLMicroSeconds& t = pos<m.mLearnStartPos ? m.mTravelTimeOpen : m.mTravelTimeClose;
+          t = (t+fullTravel)/2;
+          OLOG(LOG_INFO, "learned %s %s travel time: measured %lld mS, now assuming %lld mS for full travel",
+            aAxis==WindowCovering::WindowCoveringType::Lift ? "lift" : "tilt",
+            pos<m.mLearnStartPos ? "open" : "close",
+            (long long)(fullTravel/MilliSecond), (long long)(t/MilliSecond)
+          );
+        }
+      }
+    }
+    m.mMoving = false;
+    m.mLearnStartTime = Never;
+    updateMovingList();
+    setCurrentPosition(aAxis, pos);
+    return;
+  }
+  // moving
+  bool retargeted = !m.mMoving || abs((int)aTarget-(int)m.mTargetPos)>kTargetTolerance;
+  if (!aCurrent.IsNull()) {
+    // actual transitional position known: correct prediction
+    setCurrentPosition(aAxis, aCurrent.Value());
+    // Note: movement start was not observed or target changed -> cannot learn from it
+    if (retargeted) m.mLearnStartTime = Never;
+    startPrediction(aAxis, aCurrent.Value(), aTarget);
+  }
+  else if (retargeted) {
+    // movement started or changed outside of our control, predict from last known position
+    Percent100ths current = currentPosition(aAxis);
+    m.mLearnStartPos = current;
+    m.mLearnStartTime = m.mMoving ? Never : now;
+    startPrediction(aAxis, current, aTarget);
+  }
+}
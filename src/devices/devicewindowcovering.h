@@ -29,6 +29,16 @@
 
 using namespace chip;
 
+#ifndef WINDOWCOVERING_PROGRESS_INTERVAL
+  #define WINDOWCOVERING_PROGRESS_INTERVAL (1*Second) ///< interval for reporting predicted positions of all moving window coverings
+#endif
+#ifndef WINDOWCOVERING_DEFAULT_LIFT_TRAVEL_TIME
+  #define WINDOWCOVERING_DEFAULT_LIFT_TRAVEL_TIME (60*Second) ///< initial assumption for full lift travel, until learned
+#endif
+#ifndef WINDOWCOVERING_DEFAULT_TILT_TRAVEL_TIME
+  #define WINDOWCOVERING_DEFAULT_TILT_TRAVEL_TIME (3*Second) ///< initial assumption for full tilt travel, until learned
+#endif
+
 
 /// @brief delegate for window covering implementations
 class WindowCoveringDelegate
@@ -62,9 +72,31 @@ class DeviceWindowCovering : public IdentifiableDevice, public WindowCovering::D
 
   WindowCoveringDelegate& mWindowCoveringDelegate;
 
+  /// @brief motion model for one axis (lift or tilt)
+  struct AxisMotion {
+    bool mMoving; ///< set while prediction is running
+    Percent100ths mStartPos; ///< position at mStartTime (movement start or last actual position report)
+    MLMicroSeconds mStartTime; ///< time of mStartPos
+    Percent100ths mTargetPos; ///< position the movement is heading to
+    Percent100ths mLearnStartPos; ///< position where the movement originally started (for learning travel times)
+    MLMicroSeconds mLearnStartTime; ///< time when the movement originally started, Never if not suitable for learning
+    MLMicroSeconds mTravelTimeOpen; ///< (learned) time for full travel in open/up direction
+    MLMicroSeconds mTravelTimeClose; ///< (learned) time for full travel in close/down direction
+    AxisMotion(MLMicroSeconds aDefaultTravelTime);
+    MLMicroSeconds travelTime(Percent100ths aFrom, Percent100ths aTo) const;
+  };
+  AxisMotion mLiftMotion;
+  AxisMotion mTiltMotion;
+
+  static std::list<DeviceWindowCovering*> sMovingCoverings; ///< window coverings with a running prediction
+  static MLTicket sMotionTicket; ///< the one timer reporting predicted positions for all moving window coverings
+
 public:
 
+  static const int kTargetTolerance = 100; ///< positions (in Percent100ths) closer than this to the target count as "target reached"
+
   DeviceWindowCovering(WindowCoveringDelegate& aWindowCoveringDelegate, IdentifyDelegate* aIdentifyDelegateP, DeviceInfoDelegate& aDeviceInfoDelegate);
+  virtual ~DeviceWindowCovering();
 
   virtual void didGetInstalled() override;
 
@@ -79,6 +111,16 @@ public:
   virtual CHIP_ERROR HandleStopMotion() override;
   /// @}
 
+  /// @brief update the motion model with actual state as reported by the bridge
+  /// @param aAxis lift or tilt
+  /// @param aTarget the target position as reported by the bridge
+  /// @param aCurrent the current position as reported by the bridge, null if not known
+  /// @param aMoving true if the bridge reports the covering to be moving
+  /// @note while moving and no current position is known, the current position is predicted from the
+  ///   (learned) travel times. Actual current positions reported correct the prediction, and the end of
+  ///   a movement from end to end is used to learn the travel times.
+  void updateActualMotion(WindowCovering::WindowCoveringType aAxis, Percent100ths aTarget, const WindowCovering::NPercent100ths& aCurrent, bool aMoving);
+
 protected:
 
   /// called to have the final leaf class declare the correct device type list
@@ -86,7 +128,13 @@ protected:
 
 private:
 
-  
-  // additional storage for windowCovering cluster
+  AxisMotion& axisMotion(WindowCovering::WindowCoveringType aAxis) { return aAxis==WindowCovering::WindowCoveringType::Lift ? mLiftMotion : mTiltMotion; }
+  void setCurrentPosition(WindowCovering::WindowCoveringType aAxis, Percent100ths aPosition);
+  Percent100ths currentPosition(WindowCovering::WindowCoveringType aAxis);
+  void startPrediction(WindowCovering::WindowCoveringType aAxis, Percent100ths aFrom, Percent100ths aTo);
+  void stopPrediction(WindowCovering::WindowCoveringType aAxis);
+  bool predictionStep(WindowCovering::WindowCoveringType aAxis, MLMicroSeconds aNow);
+  void updateMovingList();
+  static void motionTimerHandler();
 
 };
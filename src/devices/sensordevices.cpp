@@ -75,6 +75,7 @@ void DeviceTemperature::setupSensorParams(bool aHasMin, double aMin, bool aHasMa
 
 void DeviceTemperature::updateMeasuredValue(double aMeasuredValue, bool aIsValid, UpdateMode aUpdateMode)
 {
+  TRACE_SPAN("device", "updateMeasuredValue", logContextPrefix());
   using namespace TemperatureMeasurement::Attributes;
   if (aIsValid) MeasuredValue::Set(endpointId(), matterValue(aMeasuredValue)); else MeasuredValue::SetNull(endpointId());
   if (aUpdateMode.Has(UpdateFlags::matter)) {
@@ -125,6 +126,7 @@ void DeviceIlluminance::setupSensorParams(bool aHasMin, double aMin, bool aHasMa
 
 void DeviceIlluminance::updateMeasuredValue(double aMeasuredValue, bool aIsValid, UpdateMode aUpdateMode)
 {
+  TRACE_SPAN("device", "updateMeasuredValue", logContextPrefix());
   using namespace IlluminanceMeasurement::Attributes;
   if (aIsValid) MeasuredValue::Set(endpointId(), matterValue(aMeasuredValue)); else MeasuredValue::SetNull(endpointId());
   if (aUpdateMode.Has(UpdateFlags::matter)) {
@@ -174,6 +176,7 @@ void DeviceHumidity::setupSensorParams(bool aHasMin, double aMin, bool aHasMax,
 
 void DeviceHumidity::updateMeasuredValue(double aMeasuredValue, bool aIsValid, UpdateMode aUpdateMode)
 {
+  TRACE_SPAN("device", "updateMeasuredValue", logContextPrefix());
   using namespace RelativeHumidityMeasurement::Attributes;
   if (aIsValid) MeasuredValue::Set(endpointId(), matterValue(aMeasuredValue)); else MeasuredValue::SetNull(endpointId());
   if (aUpdateMode.Has(UpdateFlags::matter)) {
@@ -70,6 +70,10 @@
 // FIXME: implement
 //#include "chip_glue/p44deviceinfoprovider.h" // infos like Fixed and User Tags,
 #include "chip_glue/p44deviceattestationprovider.h"
+#include "chip_glue/endpointmap.h"
+#include "stalldetector.h"
+#include "eventtrace.h"
+#include "adapters/apicapture.h"
 
 #include "actions.h"
 #include "device.h"
@@ -86,6 +90,7 @@
 #include <vector>
 
 // Device implementation adapters
+#include "adapters/apisocket.h"
 #if P44_ADAPTERS
   #include "adapters/p44/p44bridge.h"
 #endif // P44_ADAPTERS
@@ -131,6 +136,9 @@ using namespace p44;
 
 #define P44_DEFAULT_BRIDGE_SERVICE "4444"
 #define CC_DEFAULT_BRIDGE_SERVICE "18163" // RPC 18=R, 16=P, 3=C
+#define DEFAULT_ENDPOINT_GC_DAYS 90
+#define MAX_ENDPOINT_GC_DAYS 36500 // 100 years, more fits into uint32 seconds only barely or not at all
+#define DEFAULT_ENDPOINT_BATCH_MS 50
 
 
 /// Main program application object
@@ -149,6 +157,25 @@ class P44mbrd : public CmdLineApp, public AppDelegate, public BridgeMainDelegate
   Device * mDevices[CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT];
   EndpointId mNumDynamicEndPoints;
   EndpointId mFirstFreeEndpointId;
+  DevicesList mRetiredDevices; ///< replaced devices whose disabled endpoints are still registered (mDevices refers to them)
+
+  // endpoint mapping, changes during device installation are committed all at once
+  EndpointMap mEndpointMap; ///< endpointUID -> endpointId mappings and first free endpointId
+  std::list<string> mEndpointMapJournalDeletions; ///< obsolete KVS keys to delete at next commit
+  uint32_t mEndpointMapMaxAge; ///< endpoint mappings not seen for this number of seconds are removed, 0=never
+
+  // endpoint enable/disable, changes are collected and applied all at once
+  /// a not yet applied change of an endpoint's state
+  typedef struct {
+    DevicePtr mDevice; ///< the device whose endpoint is to be changed
+    bool mEnable; ///< the new enabled state
+    bool mRegister; ///< if set, the endpoint must be (re-)registered with mDevice's declaration first
+    DevicePtr mPreviousDevice; ///< when re-registering: the device whose (disabled) registration is replaced, NULL if not registered yet
+  } EndpointStateChange;
+  typedef std::list<EndpointStateChange> EndpointStateChangesList;
+  EndpointStateChangesList mPendingEndpointStates; ///< endpoint state changes not yet applied, in order of request
+  MLTicket mEndpointStatesTicket; ///< for applying the pending endpoint state changes
+  MLMicroSeconds mEndpointBatchWindow; ///< time to collect endpoint state changes before applying them in one batch
 
   // Network commissioning
   #if CHIP_DEVICE_LAYER_TARGET_LINUX
@@ -163,6 +190,8 @@ class P44mbrd : public CmdLineApp, public AppDelegate, public BridgeMainDelegate
   typedef std::list<BridgeAdapter*> BridgeAdaptersList;
   BridgeAdaptersList mAdapters;
   int mUnstartedAdapters;
+  DispatchQueue mBulkWork; ///< for installing endpoints in chunks, giving the mainloop a chance to do other things in between
+  ApiReplayer mApiReplayer; ///< fake bridge API, only used in replay mode
 
   // actions
   ActionsManager::EndPointListsMap mEndPointLists;
@@ -175,7 +204,11 @@ public:
     mChipAppInitialized(false),
     mNumDynamicEndPoints(0),
     mFirstFreeEndpointId(kInvalidEndpointId),
+    mEndpointMap(kP44mbrNamespace "endpointTable"),
+    mEndpointMapMaxAge(DEFAULT_ENDPOINT_GC_DAYS*24*3600),
+    mEndpointBatchWindow(DEFAULT_ENDPOINT_BATCH_MS*MilliSecond),
     mEthernetNetworkCommissioningInstance(0, &mEthernetDriver),
+    mBulkWork("endpoint installation"),
     mActionsManager(mActions, mEndPointLists)
   {
   }
@@ -211,6 +244,8 @@ public:
       { 0, "interface",           true,   "interface name;The network interface name to advertise on. Must have IPv6 link local address. If not set, first network interface with Ipv6 link local is used." },
       { 0, "PICS",                true,   "filepath;A file containing PICS items" },
       { 0, "KVS",                 true,   "filepath;A file to store Key Value Store items" },
+      { 0, "endpointgcdays",      true,   "days;forget endpoint mappings of devices not seen for this many days (0=never, default=90)" },
+      { 0, "endpointbatch",       true,   "milliseconds;collect endpoint enable/disable changes for this time and apply them at once (0=next mainloop cycle, default=50)" },
       #if CHIP_CONFIG_TRANSPORT_TRACE_ENABLED
       { 0, "trace_file",          true,   "filepath;Output trace data to the provided file." },
       { 0, "trace_log",           false,  "enables traces to go to the log" },
@@ -219,17 +254,38 @@ public:
       // p44mbrd command line args
       #if P44_ADAPTERS
       // - P44 device implementations
-      { 0, "p44apihost",          true, "host;host of the p44 bridge API" },
+      { 0, "p44apihost",          true, "host;host of the p44 bridge API, or unix:/path for a local socket" },
       { 0, "p44apiservice",       true, "port;port of the p44 bridge API, default is " P44_DEFAULT_BRIDGE_SERVICE },
+      { 0, "p44apibinary",        false, "offer MessagePack encoding to the p44 bridge API (JSON is used when the peer does not support it)" },
+      { 0, "outputinterval",      true, "milliseconds;min interval between output value commands to the same p44 device channel (0=no throttling)" },
       // TODO: remove legacy options
       { 0, "bridgeapihost",       true, nullptr },
       { 0, "bridgeapiservice",    true, nullptr },
       #endif
       #if CC_ADAPTERS
       // - CC device implementations
-      { 0, "ccapihost",           true, "host;host of the CC bridge API" },
+      { 0, "ccapihost",           true, "host;host of the CC bridge API, or unix:/path for a local socket" },
       { 0, "ccapiservice",        true, "port;port of the CC bridge API, default is " CC_DEFAULT_BRIDGE_SERVICE },
       #endif // CC_ADAPTERS
+      { 0, "apidispatchbudget",   true, "milliseconds;process received bridge API messages in slices of max this time per mainloop cycle (0=immediately, default)" },
+      { 0, "apipeeruid",          true, "uid;user id a bridge API peer connected via local socket may run as (in addition to root and own uid)" },
+      { 0, "apisizemetering",     false, "account bridge API message sizes as JSON and as compact binary encoding (shown in statistics)" },
+      { 0, "attrcache",           true, "mode;cache external attribute values: 0=off, 1=on (default), 2=verify (always read from device, log stale cached values)" },
+      { 0, "apicapture",          false, "start capturing bridge API traffic at startup (can also be started/stopped via bridge API)" },
+      { 0, "apicapturefile",      true, "filepath;file to capture bridge API traffic into" },
+      { 0, "apicapturesize",      true, "bytes;max size of the capture file, rotated to <file>.1 when exceeded" },
+      { 0, "apireplay",           true, "capturefile;do not run as bridge, but as fake bridge API replaying the API traffic received in capturefile" },
+      { 0, "apireplayservice",    true, "port;port for the fake bridge API to accept a p44mbrd connection on, or unix:/path for a local socket" },
+      { 0, "apireplaycc",         false, "replay CC API traffic (default: P44 API traffic)" },
+      { 0, "apireplayfast",       false, "replay as fast as possible (default: original timing)" },
+      { 0, "eventtrace",          false, "start recording an event trace at startup (can also be started/stopped via bridge API)" },
+      { 0, "eventtracefile",      true, "filepath;file to write the event trace (Chrome trace event JSON) to when recording stops" },
+      { 0, "eventtracebuffer",    true, "numevents;max number of events kept while recording an event trace" },
+      { 0, "stallthreshold",      true, "milliseconds;log mainloop handlers running longer than this and keep stall statistics (0=disabled, default)" },
+      { 0, "bulkslice",           true, "milliseconds;max time per mainloop cycle for bulk work like processing device lists and installing endpoints (0=one pass)" },
+      { 0, "shards",              true, "numshards;number of p44mbrd instances sharing the devices of the same bridge API (default=1, no sharding)" },
+      { 0, "shard",               true, "shardindex;index of this instance among the shards, 0..numshards-1. Each shard needs its own KVS and matter ports" },
+      { 0, "shardbyzone",         false, "partition devices among shards by zone instead of by hash of their endpointUID" },
       #if CHIP_LOG_FILTERING
       { 0, "chiploglevel",        true, "loglevel;level of detail for logging (0..4, default=2=Progress)" },
       #endif // CHIP_LOG_FILTERING
@@ -244,7 +300,13 @@ public:
     if (parseCommandLine(argc, argv)) {
       // parsed ok, app not terminated
       processStandardLogOptions(true, LOG_ERR);
-      /* NOP at this time */
+      int gcdays = DEFAULT_ENDPOINT_GC_DAYS;
+      getIntOption("endpointgcdays", gcdays);
+      if (gcdays>MAX_ENDPOINT_GC_DAYS) gcdays = MAX_ENDPOINT_GC_DAYS;
+      mEndpointMapMaxAge = gcdays>0 ? static_cast<uint32_t>(gcdays)*24*3600 : 0;
+      int batchms = DEFAULT_ENDPOINT_BATCH_MS;
+      getIntOption("endpointbatch", batchms);
+      mEndpointBatchWindow = batchms>0 ? batchms*MilliSecond : 0;
     }
     // app now ready to run (or cleanup when already terminated by cmd line parsing)
     return run();
@@ -264,6 +326,38 @@ public:
 
   void initAdapters()
   {
+    int dispatchbudget = 0;
+    getIntOption("apidispatchbudget", dispatchbudget);
+    int numshards = 1;
+    int shardindex = 0;
+    getIntOption("shards", numshards);
+    getIntOption("shard", shardindex);
+    bool shardbyzone = getOption("shardbyzone");
+    bool sizemetering = getOption("apisizemetering");
+    int attrcache = (int)AttributeCache::Mode::on;
+    getIntOption("attrcache", attrcache);
+    AttributeCache::setMode(static_cast<AttributeCache::Mode>(attrcache));
+    int stallthreshold = 0;
+    getIntOption("stallthreshold", stallthreshold);
+    StallDetector::sharedDetector().setThreshold(stallthreshold*MilliSecond);
+    const char* tracefile = nullptr;
+    getStringOption("eventtracefile", tracefile);
+    int tracebuffer = EVENT_TRACE_BUFFER_SIZE;
+    getIntOption("eventtracebuffer", tracebuffer);
+    EventTrace::sharedTrace().setup(tracefile ? tracefile : tempPath("p44mbrd_trace.json"), tracebuffer>0 ? (size_t)tracebuffer : 0);
+    if (getOption("eventtrace")) EventTrace::sharedTrace().enable(true);
+    const char* capturefile = nullptr;
+    getStringOption("apicapturefile", capturefile);
+    int capturesize = API_CAPTURE_MAX_SIZE;
+    getIntOption("apicapturesize", capturesize);
+    ApiCapture::sharedCapture().setup(capturefile ? capturefile : tempPath("p44mbrd_api.cap"), capturesize>0 ? (size_t)capturesize : 0);
+    if (getOption("apicapture")) ApiCapture::sharedCapture().enable(true);
+    int bulkslice = (int)(BULK_WORK_SLICE/MilliSecond);
+    getIntOption("bulkslice", bulkslice);
+    mBulkWork.setBudget(bulkslice*MilliSecond);
+    int peeruid = -1;
+    getIntOption("apipeeruid", peeruid);
+    setApiAllowedPeerUid(peeruid);
     #if P44_ADAPTERS
     const char* p44apihost = nullptr;
     const char* p44apiservice = P44_DEFAULT_BRIDGE_SERVICE;
@@ -273,6 +367,14 @@ public:
     if (p44apihost) {
       P44_BridgeImpl* p44bridgeP = &P44_BridgeImpl::adapter();
       p44bridgeP->setAPIParams(p44apihost, p44apiservice);
+      p44bridgeP->api().dispatchQueue().setBudget(dispatchbudget*MilliSecond);
+      p44bridgeP->api().trafficMeter().setSizeMetering(sizemetering);
+      p44bridgeP->api().setOfferBinary(getOption("p44apibinary"));
+      int outputinterval = (int)(P44_OUTPUT_COMMAND_INTERVAL/MilliSecond);
+      getIntOption("outputinterval", outputinterval);
+      p44bridgeP->setOutputCommandInterval(outputinterval*MilliSecond);
+      p44bridgeP->setSharding(numshards, shardindex, shardbyzone);
+      p44bridgeP->setBulkWorkSlice(bulkslice*MilliSecond);
       mAdapters.push_back(p44bridgeP);
     }
     #endif // P44_ADAPTERS
@@ -284,6 +386,10 @@ public:
     if (ccapihost) {
       CC_BridgeImpl* ccbridgeP = &CC_BridgeImpl::adapter();
       ccbridgeP->setAPIParams(ccapihost, ccapiservice);
+      ccbridgeP->dispatchQueue().setBudget(dispatchbudget*MilliSecond);
+      ccbridgeP->trafficMeter().setSizeMetering(sizemetering);
+      ccbridgeP->setSharding(numshards, shardindex, shardbyzone);
+      ccbridgeP->setBulkWorkSlice(bulkslice*MilliSecond);
       mAdapters.push_back(ccbridgeP);
     }
     #endif // CC_ADAPTERS
@@ -359,6 +465,12 @@ public:
   virtual void initialize() override
   {
     OLOG(LOG_NOTICE, "p44: p44utils mainloop started");
+    const char* replayfile;
+    if (getStringOption("apireplay", replayfile)) {
+      // replay mode: act as fake bridge API only
+      startApiReplay(replayfile);
+      return;
+    }
     // Instantiate and initialize adapters
     initAdapters();
     // start the adapters
@@ -369,6 +481,21 @@ public:
   }
 
 
+  void startApiReplay(const char* aCaptureFile)
+  {
+    ErrorPtr err = mApiReplayer.load(aCaptureFile, getOption("apireplaycc") ? ApiCapture::cc : ApiCapture::p44);
+    if (Error::isOK(err)) {
+      const char* service = P44_DEFAULT_BRIDGE_SERVICE;
+      getStringOption("apireplayservice", service);
+      err = mApiReplayer.start(service, getOption("apireplayfast"));
+    }
+    if (Error::notOK(err)) {
+      OLOG(LOG_ERR, "cannot start API replay: %s", err->text());
+      terminateApp(EXIT_FAILURE);
+    }
+  }
+
+
   void startChip()
   {
     ErrorPtr err;
@@ -391,9 +518,8 @@ public:
       updateCommissionableStatus(true);
     }
     // install the devices we have
+    // Note: stack becomes operational when installation (which might be done in chunks) is complete
     installInitiallyBridgedDevices();
-    // stack is now operational
-    stackDidBecomeOperational();
   }
 
 
@@ -406,6 +532,36 @@ public:
   #endif
 
 
+  /// @brief record deletion of an obsolete (per device) KVS key in the journal
+  /// @note will be deleted from KVS only at the next commitEndpointMapJournal()
+  void journalEndpointMapDeletion(const string aKey)
+  {
+    mEndpointMapJournalDeletions.push_back(aKey);
+  }
+
+
+  /// @brief write all endpoint mapping changes and first free endpointId to the KVS (as a single blob)
+  /// @note obsolete KVS keys are deleted only after the mapping table has been saved successfully
+  void commitEndpointMapJournal()
+  {
+    mEndpointMap.setFirstFreeEndpointId(mFirstFreeEndpointId);
+    ErrorPtr err = mEndpointMap.save();
+    if (Error::notOK(err)) {
+      OLOG(LOG_ERR, "could not save endpoint map: %s", err->text());
+      return;
+    }
+    if (!mEndpointMapJournalDeletions.empty()) {
+      chip::DeviceLayer::PersistedStorage::KeyValueStoreManager &kvs = chip::DeviceLayer::PersistedStorage::KeyValueStoreMgr();
+      for (std::list<string>::iterator pos = mEndpointMapJournalDeletions.begin(); pos!=mEndpointMapJournalDeletions.end(); ++pos) {
+        CHIP_ERROR chiperr = kvs.Delete(pos->c_str());
+        if (chiperr!=CHIP_ERROR_PERSISTED_STORAGE_VALUE_NOT_FOUND) LogErrorOnFailure(chiperr);
+      }
+      OLOG(LOG_INFO, "removed %zu obsolete endpoint KVS entries", mEndpointMapJournalDeletions.size());
+      mEndpointMapJournalDeletions.clear();
+    }
+  }
+
+
   CHIP_ERROR installSingleBridgedDevice(DevicePtr dev, chip::EndpointId aParentEndpointId)
   {
     CHIP_ERROR chiperr;
@@ -418,40 +574,49 @@ public:
     // signal installation to device (which, at this point, is a fully constructed class)
     dev->willBeInstalled();
     // now install
-    chip::DeviceLayer::PersistedStorage::KeyValueStoreManager &kvs = chip::DeviceLayer::PersistedStorage::KeyValueStoreMgr();
     // note: endpointUID identifies the endpoint, of which one adapted device might have multiple.
-    string key = kP44mbrNamespace "device_eps/"; key += dev->deviceInfoDelegate().endpointUID();
-    EndpointId endpointId = kInvalidEndpointId;
-    #if MIGRATE_DYNAMIC_ENDPOINT_IDX_KVS
-    // need to look up in the old table first
-    string legacy_key = kP44mbrNamespace "devices/"; legacy_key += dev->deviceInfoDelegate().endpointUID(); // old endpointUID -> dynamicEndpointIdx mapping
-    EndpointId legacyDynamicEndpointIdx = kInvalidEndpointId;
-    chiperr = kvs.Get(legacy_key.c_str(), &legacyDynamicEndpointIdx);
-    if (chiperr==CHIP_NO_ERROR) {
-      // this device was mapped before with the fixed index/endpointID scheme
-      // calculate the endpointId
-      endpointId = static_cast<chip::EndpointId>(legacyDynamicEndpointIdx + kLegacyFirstDynamicEndpointID);
-      // migrate kvs entry into new format
-      chiperr = kvs.Delete(legacy_key.c_str()); // delete from legacy
-      LogErrorOnFailure(chiperr);
-      chiperr = kvs.Put(key.c_str(), endpointId); // store in new
-      LogErrorOnFailure(chiperr);
-      POLOG(dev, LOG_NOTICE, "migrated KVS entry from legacy dynamicEndpointIdx (%u) to endpointId (%u)", legacyDynamicEndpointIdx, endpointId);
-    }
-    else if (chiperr!=CHIP_ERROR_PERSISTED_STORAGE_VALUE_NOT_FOUND) {
-      LogErrorOnFailure(chiperr);
-    }
-    else // not found in legacy store
-    #endif
-    {
-      // lookup previously used endpointId
-      chiperr = kvs.Get(key.c_str(), &endpointId);
-      if (chiperr==CHIP_ERROR_PERSISTED_STORAGE_VALUE_NOT_FOUND) {
-        POLOG(dev, LOG_NOTICE, "is NEW (was not previously mapped to an endpoint) -> adding to bridge");
-        endpointId = kInvalidEndpointId;
-        chiperr = CHIP_NO_ERROR;
+    string uid = dev->deviceInfoDelegate().endpointUID();
+    chiperr = CHIP_NO_ERROR;
+    EndpointId endpointId = mEndpointMap.lookup(uid);
+    if (endpointId==kInvalidEndpointId) {
+      // not in the endpoint map, but might still have a per-device KVS entry from earlier versions
+      chip::DeviceLayer::PersistedStorage::KeyValueStoreManager &kvs = chip::DeviceLayer::PersistedStorage::KeyValueStoreMgr();
+      string key = kP44mbrNamespace "device_eps/"; key += uid;
+      #if MIGRATE_DYNAMIC_ENDPOINT_IDX_KVS
+      // need to look up in the old table first
+      string legacy_key = kP44mbrNamespace "devices/"; legacy_key += uid; // old endpointUID -> dynamicEndpointIdx mapping
+      EndpointId legacyDynamicEndpointIdx = kInvalidEndpointId;
+      chiperr = kvs.Get(legacy_key.c_str(), &legacyDynamicEndpointIdx);
+      if (chiperr==CHIP_NO_ERROR) {
+        // this device was mapped before with the fixed index/endpointID scheme
+        // calculate the endpointId
+        endpointId = static_cast<chip::EndpointId>(legacyDynamicEndpointIdx + kLegacyFirstDynamicEndpointID);
+        // migrate kvs entry into endpoint map (at next journal commit)
+        journalEndpointMapDeletion(legacy_key); // delete from legacy
+        mEndpointMap.assign(uid, endpointId); // store in new
+        POLOG(dev, LOG_NOTICE, "migrated KVS entry from legacy dynamicEndpointIdx (%u) to endpointId (%u)", legacyDynamicEndpointIdx, endpointId);
+      }
+      else if (chiperr!=CHIP_ERROR_PERSISTED_STORAGE_VALUE_NOT_FOUND) {
+        LogErrorOnFailure(chiperr);
+      }
+      else // not found in legacy store
+      #endif
+      {
+        // lookup previously used endpointId in per-device KVS entry
+        chiperr = kvs.Get(key.c_str(), &endpointId);
+        if (chiperr==CHIP_NO_ERROR) {
+          // migrate kvs entry into endpoint map (at next journal commit)
+          journalEndpointMapDeletion(key);
+          mEndpointMap.assign(uid, endpointId);
+          POLOG(dev, LOG_INFO, "migrated per-device KVS entry for endpointId (%u) into endpoint map", endpointId);
+        }
+        else if (chiperr==CHIP_ERROR_PERSISTED_STORAGE_VALUE_NOT_FOUND) {
+          POLOG(dev, LOG_NOTICE, "is NEW (was not previously mapped to an endpoint) -> adding to bridge");
+          endpointId = kInvalidEndpointId;
+          chiperr = CHIP_NO_ERROR;
+        }
+        LogErrorOnFailure(chiperr);
       }
-      LogErrorOnFailure(chiperr);
     }
     if (endpointId!=kInvalidEndpointId) {
       // This UID was already assigned to an endpoint earlier - re-use the endpoint ID for this dSUID
@@ -486,9 +651,8 @@ public:
       // must get a new endpointId
       endpointId = mFirstFreeEndpointId;
       POLOG(dev, LOG_NOTICE, "will be assigned new endpointId %d", endpointId);
-      // save new UID<->endpointId relation
-      chiperr = kvs.Put(key.c_str(), endpointId);
-      LogErrorOnFailure(chiperr);
+      // save new UID<->endpointId relation (at next journal commit)
+      mEndpointMap.assign(uid, endpointId);
       // determine next free
       if (++mFirstFreeEndpointId==0xFFFF) mFirstFreeEndpointId = emberAfEndpointCount(); // increment and wraparound from 0xFFFE to first dynamic endpoint
     }
@@ -514,64 +678,103 @@ public:
     mNumDynamicEndPoints = 0;
     memset(mDevices, 0, sizeof(mDevices));
     CHIP_ERROR chiperr;
-    chip::DeviceLayer::PersistedStorage::KeyValueStoreManager &kvs = chip::DeviceLayer::PersistedStorage::KeyValueStoreMgr();
-    // determine highest endpointId in use
-    chiperr = kvs.Get(kP44mbrNamespace "firstFreeEndpointId", &mFirstFreeEndpointId);
-    if (chiperr==CHIP_ERROR_PERSISTED_STORAGE_VALUE_NOT_FOUND) {
-      // no highest endpoint recorded so far
-      #if MIGRATE_DYNAMIC_ENDPOINT_IDX_KVS
-      // - obtain from legacy map
-      char legacyDynamicEndPointMap[CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT+1];
-      size_t nde;
-      chiperr = kvs.Get(kP44mbrNamespace "endPointMap", legacyDynamicEndPointMap, CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT, &nde);
+    // load the endpoint map
+    ErrorPtr err = mEndpointMap.load();
+    if (Error::notOK(err)) {
+      OLOG(LOG_ERR, "could not load endpoint map, continuing with what could be recovered: %s", err->text());
+    }
+    if (mEndpointMap.isLoaded() || mEndpointMap.loadFailed()) {
+      // endpoint map knows (or has recovered) highest endpointId in use
+      // Note: must NOT fall back to the legacy KVS entries, these were deleted after migration
+      mFirstFreeEndpointId = mEndpointMap.firstFreeEndpointId();
+    }
+    else {
+      // no endpoint map yet, determine highest endpointId in use from per-device KVS entries of earlier versions
+      chip::DeviceLayer::PersistedStorage::KeyValueStoreManager &kvs = chip::DeviceLayer::PersistedStorage::KeyValueStoreMgr();
+      chiperr = kvs.Get(kP44mbrNamespace "firstFreeEndpointId", &mFirstFreeEndpointId);
       if (chiperr==CHIP_NO_ERROR) {
-        // legacy endpoint map (still) exists, find highest index used
-        mFirstFreeEndpointId = emberAfFixedEndpointCount();
-        for (EndpointId i=0; i<nde; i++) {
-          if (legacyDynamicEndPointMap[i]!=' ') {
-            if (i>=mFirstFreeEndpointId-kLegacyFirstDynamicEndpointID) {
-              mFirstFreeEndpointId = static_cast<chip::EndpointId>(i+kLegacyFirstDynamicEndpointID+1);
+        // now stored in the endpoint map
+        journalEndpointMapDeletion(kP44mbrNamespace "firstFreeEndpointId");
+      }
+      else if (chiperr==CHIP_ERROR_PERSISTED_STORAGE_VALUE_NOT_FOUND) {
+        // no highest endpoint recorded so far
+        #if MIGRATE_DYNAMIC_ENDPOINT_IDX_KVS
+        // - obtain from legacy map
+        char legacyDynamicEndPointMap[CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT+1];
+        size_t nde;
+        chiperr = kvs.Get(kP44mbrNamespace "endPointMap", legacyDynamicEndPointMap, CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT, &nde);
+        if (chiperr==CHIP_NO_ERROR) {
+          // legacy endpoint map (still) exists, find highest index used
+          mFirstFreeEndpointId = emberAfFixedEndpointCount();
+          for (EndpointId i=0; i<nde; i++) {
+            if (legacyDynamicEndPointMap[i]!=' ') {
+              if (i>=mFirstFreeEndpointId-kLegacyFirstDynamicEndpointID) {
+                mFirstFreeEndpointId = static_cast<chip::EndpointId>(i+kLegacyFirstDynamicEndpointID+1);
+              }
             }
           }
+          // forget the legacy map
+          OLOG(LOG_NOTICE, "migrated endpoint kvs: determined first free endpointId as %d", mFirstFreeEndpointId);
+          // safety saving, in case something goes wrong below before it is saved again
+          mEndpointMap.setFirstFreeEndpointId(mFirstFreeEndpointId);
+          err = mEndpointMap.save();
+          if (Error::isOK(err)) kvs.Delete(kP44mbrNamespace "endPointMap");
         }
-        // forget the legacy map
-        OLOG(LOG_NOTICE, "migrated endpoint kvs: determined first free endpointId as %d", mFirstFreeEndpointId);
-        kvs.Put(kP44mbrNamespace "firstFreeEndpointId", mFirstFreeEndpointId); // safety saving, in case something goes wrong below before it is saved again
-        kvs.Delete(kP44mbrNamespace "endPointMap");
-      }
-      else if (chiperr==CHIP_ERROR_PERSISTED_STORAGE_VALUE_NOT_FOUND) {
-        // that's ok
-        chiperr = CHIP_NO_ERROR;
+        else if (chiperr==CHIP_ERROR_PERSISTED_STORAGE_VALUE_NOT_FOUND) {
+          // that's ok
+          chiperr = CHIP_NO_ERROR;
+        }
+        else {
+          LogErrorOnFailure(chiperr);
+        }
+        #endif // MIGRATE_DYNAMIC_ENDPOINT_IDX_KVS
       }
       else {
         LogErrorOnFailure(chiperr);
       }
-      #endif // MIGRATE_DYNAMIC_ENDPOINT_IDX_KVS
     }
     // validate
     if (mFirstFreeEndpointId==kInvalidEndpointId || mFirstFreeEndpointId<emberAfFixedEndpointCount()) {
-      // none recorded or is invalid - reset and store
+      // none recorded or is invalid - reset (will be stored with the journal commit below)
       mFirstFreeEndpointId = emberAfFixedEndpointCount(); // use first possible endpointId.
-      kvs.Put(kP44mbrNamespace "firstFreeEndpointId", mFirstFreeEndpointId);
       OLOG(LOG_NOTICE, "reset first free endpointID to: %d", mFirstFreeEndpointId);
     }
     // process list of to-be-bridged devices of all adapters
     chiperr = installAdaptersInitialDevices();
-    // save updated next free endpoint
-    chiperr = kvs.Put(kP44mbrNamespace "firstFreeEndpointId", mFirstFreeEndpointId);
-    LogErrorOnFailure(chiperr);
-    // Add the devices as dynamic endpoints
+    // forget about devices not seen for a long time
+    mEndpointMap.collectGarbage(mEndpointMapMaxAge);
+    // save updated next free endpoint and all new endpoint mappings at once
+    commitEndpointMapJournal();
+    // Add the devices as dynamic endpoints, in chunks so the stack can handle requests in between
     for (size_t i=0; i<mNumDynamicEndPoints; i++) {
-      if (mDevices[i]->addAsDeviceEndpoint()) {
-        POLOG(mDevices[i], LOG_DEBUG, "registered before starting Matter mainloop");
-        // report installed
-        mDevices[i]->didGetInstalled();
-      }
+      mBulkWork.dispatch(boost::bind(&P44mbrd::installInitialDeviceEndpoint, this, i));
     }
+    mBulkWork.dispatch(boost::bind(&P44mbrd::initialDevicesInstalled, this));
+  }
+
+
+  void installInitialDeviceEndpoint(size_t aDynamicEndpointIndex)
+  {
+    Device* dev = mDevices[aDynamicEndpointIndex];
+    if (dev && dev->addAsDeviceEndpoint()) {
+      POLOG(dev, LOG_DEBUG, "registered as initial device");
+      // report installed
+      dev->didGetInstalled();
+    }
+  }
+
+
+  void initialDevicesInstalled()
+  {
     // inform the adapters of installed devices
     for (BridgeAdaptersList::iterator pos = mAdapters.begin(); pos!=mAdapters.end(); ++pos) {
       (*pos)->initialDevicesInstalled();
     }
+    // memory report (peak is usually reached during startup, while processing the adapters' device lists)
+    string mem = memoryUsageInfo();
+    if (!mem.empty()) OLOG(LOG_NOTICE, "memory usage after installing %d dynamic endpoints: %s", mNumDynamicEndPoints, mem.c_str());
+    // stack is now operational
+    stackDidBecomeOperational();
   }
 
 
@@ -653,49 +856,61 @@ public:
   }
 
 
-  ErrorPtr addAdditionalDevice(DevicePtr aDevice, BridgeAdapter& aAdapter) override
+  ErrorPtr addAdditionalDevices(DevicesList& aDevices, BridgeAdapter& aAdapter) override
   {
     ErrorPtr err;
-    if (!aDevice) {
-      return TextError::err("addAdditionalDevice: no device");
+    if (aDevices.empty()) {
+      return TextError::err("addAdditionalDevices: no devices");
     }
     if (!mChipAppInitialized) {
       // we are still waiting for the first bridged device and haven't started CHIP yet -> start now
-      OLOG(LOG_NOTICE, "First bridgeable device installed, can start CHIP now, finally");
-      // starting chip will take care of actually installing the device
+      OLOG(LOG_NOTICE, "First bridgeable device(s) installed, can start CHIP now, finally");
+      // starting chip will take care of actually installing the devices
       // - but unwind call stack before
       MainLoop::currentMainLoop().executeNow(boost::bind(&P44mbrd::startChip, this));
-    }
-    else {
-      // already running
-      installDevice(aDevice, aAdapter);
-      // save possibly modified first free endpointID (increased when previously unknown devices have been added)
-      chip::DeviceLayer::PersistedStorage::KeyValueStoreManager &kvs = chip::DeviceLayer::PersistedStorage::KeyValueStoreMgr();
-      CHIP_ERROR chiperr = kvs.Put(kP44mbrNamespace "firstFreeEndpointId", mFirstFreeEndpointId);
-      LogErrorOnFailure(chiperr);
-      // add as new endpoint to bridge
-      if (aDevice->addAsDeviceEndpoint()) {
-        POLOG(aDevice, LOG_NOTICE, "added as additional dynamic endpoint while Matter already running");
+      return err;
+    }
+    // already running
+    TRACE_SPAN("matter", "add devices", string_format("%zu devices", aDevices.size()));
+    for (DevicesList::iterator pos = aDevices.begin(); pos!=aDevices.end(); ++pos) {
+      installDevice(*pos, aAdapter);
+    }
+    // save possibly modified first free endpointID (increased when previously unknown devices have been added)
+    // and the new devices' (and subdevices') endpoint mappings, all at once
+    commitEndpointMapJournal();
+    // add as new endpoints to bridge
+    // Note: adding all endpoints in the same mainloop cycle lets the reporting engine coalesce
+    //   the resulting PartsList changes into one change and one round of reports.
+    int added = 0;
+    for (DevicesList::iterator pos = aDevices.begin(); pos!=aDevices.end(); ++pos) {
+      DevicePtr dev = *pos;
+      if (dev->addAsDeviceEndpoint()) {
+        POLOG(dev, LOG_NOTICE, "added as additional dynamic endpoint while Matter already running");
         // report installed
-        aDevice->didGetInstalled();
-        aDevice->didBecomeOperational();
+        dev->didGetInstalled();
+        dev->didBecomeOperational();
         // dump status
-        POLOG(aDevice, LOG_INFO, "initialized from chip: %s", aDevice->description().c_str());
+        POLOG(dev, LOG_INFO, "initialized from chip: %s", dev->description().c_str());
         // also add subdevices that are part of this additional device and thus not yet present
-        for (DevicesList::iterator pos = aDevice->subDevices().begin(); pos!=aDevice->subDevices().end(); ++pos) {
-          DevicePtr subDev = *pos;
+        for (DevicesList::iterator spos = dev->subDevices().begin(); spos!=dev->subDevices().end(); ++spos) {
+          DevicePtr subDev = *spos;
           if (subDev->addAsDeviceEndpoint()) {
             POLOG(subDev, LOG_NOTICE, "added as part of composed device as additional dynamic endpoint while CHIP is already up");
             subDev->didBecomeOperational();
             // dump status
-            POLOG(subDev, LOG_INFO, "initialized composed device as part of %s", aDevice->description().c_str());
+            POLOG(subDev, LOG_INFO, "initialized composed device as part of %s", dev->description().c_str());
           }
         }
+        added++;
       }
       else {
+        POLOG(dev, LOG_ERR, "failed adding device as endpoint");
         err = TextError::err("failed adding device as endpoint");
       }
     }
+    if (aDevices.size()>1) {
+      OLOG(LOG_NOTICE, "added %d of %zu arrived devices in one batch", added, aDevices.size());
+    }
     return err;
   }
 
@@ -706,26 +921,196 @@ public:
     // subdevices first
     for (DevicesList::iterator pos = aDevice->subDevices().begin(); pos!=aDevice->subDevices().end(); ++pos) {
       (*pos)->willBeDisabled();
-      emberAfEndpointEnableDisable((*pos)->endpointId(), false);
-      POLOG((*pos), LOG_NOTICE, "subdevice endpoint disabled, device no longer operational");
+      queueEndpointState(*pos, false);
     }
-    // disable main device now
-    emberAfEndpointEnableDisable(aDevice->endpointId(), false);
-    POLOG(aDevice, LOG_NOTICE, "main device endpoint disabled, device no longer operational");
+    // main device last
+    queueEndpointState(aDevice, false);
   }
 
 
-  void reEnableDevice(DevicePtr aDevice, BridgeAdapter& aAdapter) override
+  void reEnableDevice(DevicePtr aDevice, DevicePtr aPreviousDevice, BridgeAdapter& aAdapter) override
   {
-    POLOG(aDevice, LOG_NOTICE, "re-enabling as dynamic endpoint");
-    // report re-installed
-    aDevice->didGetInstalled();
-    aDevice->didBecomeOperational();
+    POLOG(aPreviousDevice, LOG_NOTICE, "re-appeared, re-enabling its dynamic endpoint with the new device definition");
+    // main device first
+    if (!takeOverEndpoint(aDevice, aPreviousDevice, aPreviousDevice->GetParentEndpointId())) return;
     // subdevices
+    DevicesList previousSubDevices = aPreviousDevice->subDevices();
     for (DevicesList::iterator pos = aDevice->subDevices().begin(); pos!=aDevice->subDevices().end(); ++pos) {
-      (*pos)->didGetInstalled();
-      emberAfEndpointEnableDisable((*pos)->endpointId(), true);
-      aDevice->didBecomeOperational();
+      DevicePtr subDev = *pos;
+      DevicePtr previousSubDev;
+      for (DevicesList::iterator ppos = previousSubDevices.begin(); ppos!=previousSubDevices.end(); ++ppos) {
+        if ((*ppos)->deviceInfoDelegate().endpointUID()==subDev->deviceInfoDelegate().endpointUID()) {
+          previousSubDev = *ppos;
+          previousSubDevices.erase(ppos);
+          break;
+        }
+      }
+      if (previousSubDev && previousSubDev->endpointId()!=kInvalidEndpointId) {
+        // re-use the endpoint of the same subdevice
+        takeOverEndpoint(subDev, previousSubDev, aDevice->endpointId());
+      }
+      else {
+        // subdevice was not part of the previous definition, needs a new endpoint
+        if (installSingleBridgedDevice(subDev, aDevice->endpointId())!=CHIP_NO_ERROR) {
+          POLOG(subDev, LOG_ERR, "failed installing new subdevice");
+          continue;
+        }
+        queueEndpointRegistration(subDev, DevicePtr());
+      }
+    }
+    // new subdevices might have got new endpointIds
+    commitEndpointMapJournal();
+    // previous subdevices no longer present keep their disabled endpoint, which still refers to the device object
+    for (DevicesList::iterator ppos = previousSubDevices.begin(); ppos!=previousSubDevices.end(); ++ppos) {
+      if ((*ppos)->endpointId()!=kInvalidEndpointId) {
+        POLOG(*ppos, LOG_NOTICE, "not part of the re-appeared device any more, endpoint stays disabled");
+        mRetiredDevices.push_back(*ppos);
+      }
+    }
+  }
+
+
+  /// let a new device object take over the (disabled) dynamic endpoint of a previous device object with the same endpointUID
+  /// @note the endpoint gets registered again with the new device's declaration, and enabled, together
+  ///   with the other endpoint state changes of the current batch
+  bool takeOverEndpoint(DevicePtr aDevice, DevicePtr aPreviousDevice, EndpointId aParentEndpointId)
+  {
+    EndpointId ep = aPreviousDevice->endpointId();
+    EndpointId idx = aPreviousDevice->dynamicEndpointIdx();
+    if (ep!=kInvalidEndpointId && idx<mNumDynamicEndPoints) {
+      // the previous device might itself be waiting to take over the endpoint
+      Device* owner = mDevices[idx];
+      for (EndpointStateChangesList::iterator pos = mPendingEndpointStates.begin(); pos!=mPendingEndpointStates.end(); ++pos) {
+        if (pos->mRegister && pos->mDevice->endpointId()==ep) owner = pos->mDevice.get();
+      }
+      if (owner!=aPreviousDevice.get()) ep = kInvalidEndpointId;
+    }
+    if (ep==kInvalidEndpointId || idx>=mNumDynamicEndPoints) {
+      POLOG(aPreviousDevice, LOG_ERR, "has no installed endpoint to be taken over by the new device definition");
+      return false;
+    }
+    aDevice->willBeInstalled();
+    aDevice->SetEndpointId(ep);
+    aDevice->SetDynamicEndpointIdx(idx);
+    aDevice->SetParentEndpointId(aParentEndpointId);
+    mEndpointMap.lookup(aDevice->deviceInfoDelegate().endpointUID()); // mark seen
+    // the endpoint's registration refers to the previous device's declaration and storage, must be replaced
+    queueEndpointRegistration(aDevice, aPreviousDevice);
+    return true;
+  }
+
+
+  bool isEndpointEnabled(EndpointId aEndpointId, BridgeAdapter& aAdapter) override
+  {
+    // latest not yet applied change determines the state
+    for (EndpointStateChangesList::reverse_iterator pos = mPendingEndpointStates.rbegin(); pos!=mPendingEndpointStates.rend(); ++pos) {
+      if (pos->mDevice->endpointId()==aEndpointId) return pos->mEnable;
+    }
+    return emberAfEndpointIsEnabled(aEndpointId);
+  }
+
+
+  /// queue a change of a device's endpoint enabled state, to be applied together with all other
+  /// changes requested within the batch window.
+  /// @note enabling/disabling an endpoint marks the Descriptor PartsList of all its parents and the
+  ///   root endpoint dirty. Applying all changes in one mainloop cycle lets the reporting engine
+  ///   coalesce these into one PartsList change and one round of reports, instead of one per endpoint.
+  void queueEndpointState(DevicePtr aDevice, bool aEnable)
+  {
+    EndpointStateChange change;
+    change.mDevice = aDevice;
+    change.mEnable = aEnable;
+    change.mRegister = false;
+    queueEndpointStateChange(change);
+  }
+
+
+  /// queue (re-)registering a device's endpoint, which also enables it, to be applied together with
+  /// all other endpoint state changes requested within the batch window.
+  /// @param aDevice the device, must already have its endpointId and dynamic endpoint index assigned
+  /// @param aPreviousDevice the device whose (disabled) registration of the same endpoint is to be
+  ///   replaced, NULL for an endpoint not registered before
+  void queueEndpointRegistration(DevicePtr aDevice, DevicePtr aPreviousDevice)
+  {
+    EndpointStateChange change;
+    change.mDevice = aDevice;
+    change.mEnable = true;
+    change.mRegister = true;
+    change.mPreviousDevice = aPreviousDevice;
+    queueEndpointStateChange(change);
+  }
+
+
+  void queueEndpointStateChange(EndpointStateChange& aChange)
+  {
+    EndpointId ep = aChange.mDevice->endpointId();
+    if (ep==kInvalidEndpointId) {
+      POLOG(aChange.mDevice, LOG_WARNING, "has no endpoint, cannot %s it", aChange.mEnable ? "enable" : "disable");
+      return;
+    }
+    bool scheduled = !mPendingEndpointStates.empty();
+    // a later change of the same endpoint supersedes an earlier one not yet applied
+    for (EndpointStateChangesList::iterator pos = mPendingEndpointStates.begin(); pos!=mPendingEndpointStates.end(); ++pos) {
+      if (pos->mDevice->endpointId()==ep) {
+        if (pos->mRegister) {
+          // the registration is still needed, and still replaces the registration actually in place
+          aChange.mRegister = true;
+          aChange.mPreviousDevice = pos->mPreviousDevice;
+        }
+        mPendingEndpointStates.erase(pos);
+        break;
+      }
+    }
+    mPendingEndpointStates.push_back(aChange);
+    if (!scheduled) {
+      mEndpointStatesTicket.executeOnce(boost::bind(&P44mbrd::applyEndpointStates, this), mEndpointBatchWindow);
+    }
+  }
+
+
+  void applyEndpointStates()
+  {
+    mEndpointStatesTicket.cancel();
+    TRACE_SPAN("matter", "endpoint state batch", string_format("%zu changes", mPendingEndpointStates.size()));
+    int enabled = 0;
+    int disabled = 0;
+    // take the changes out first, device callbacks might queue new ones
+    EndpointStateChangesList changes;
+    changes.swap(mPendingEndpointStates);
+    // in order of request: subdevices are disabled before, and enabled after their main device
+    for (EndpointStateChangesList::iterator pos = changes.begin(); pos!=changes.end(); ++pos) {
+      DevicePtr dev = pos->mDevice;
+      EndpointId ep = dev->endpointId();
+      if (pos->mRegister) {
+        // (re-)register the endpoint with the new device's declaration, which also enables it
+        if (pos->mPreviousDevice) emberAfClearDynamicEndpoint(dev->dynamicEndpointIdx());
+        mDevices[dev->dynamicEndpointIdx()] = dev.get();
+        if (!dev->addAsDeviceEndpoint()) {
+          POLOG(dev, LOG_ERR, "failed (re-)adding as dynamic endpoint");
+          continue;
+        }
+        dev->didGetInstalled();
+        if (pos->mEnable) {
+          dev->didBecomeOperational();
+          POLOG(dev, LOG_NOTICE, "endpoint %s, device operational", pos->mPreviousDevice ? "taken over from previous device definition" : "added");
+          enabled++;
+          continue;
+        }
+        // vanished again before the batch was applied
+      }
+      if (emberAfEndpointIsEnabled(ep)==pos->mEnable) continue; // already in requested state
+      emberAfEndpointEnableDisable(ep, pos->mEnable);
+      if (pos->mEnable) {
+        POLOG(dev, LOG_NOTICE, "endpoint enabled, device operational again");
+        enabled++;
+      }
+      else {
+        POLOG(dev, LOG_NOTICE, "endpoint disabled, device no longer operational");
+        disabled++;
+      }
+    }
+    if (enabled+disabled>0) {
+      OLOG(LOG_INFO, "applied endpoint state changes in one batch: %d enabled, %d disabled", enabled, disabled);
     }
   }
 
@@ -1053,6 +1438,8 @@ public:
       decoder->SetOptions(options);
       chip::trace::AddTraceStream(decoder);
     }
+    // transport events also go to the event trace (when recording)
+    chip::trace::AddTraceStream(new EventTraceStream());
     chip::trace::InitTrace();
     #endif // CHIP_CONFIG_TRANSPORT_TRACE_ENABLED
 
@@ -1252,20 +1639,24 @@ Status emberAfExternalAttributeReadCallback(
   uint16_t maxReadLength
 )
 {
+  MLMicroSeconds start = MainLoop::now();
   Status ret = Status::Failure;
   DevicePtr dev = deviceForEndPointId(endpoint);
   if (dev) {
+    TRACE_SPAN("matter", "attribute read", string_format("cluster 0x%04x attr 0x%04x - %s", (int)clusterId, (int)attributeMetadata->attributeId, dev->logContextPrefix().c_str()));
     POLOG(dev, LOG_DEBUG,
       "read external attr 0x%04x in cluster 0x%04x, expecting %d bytes, attr.size=%d",
       (int)attributeMetadata->attributeId, (int)clusterId, (int)maxReadLength, (int)attributeMetadata->size
     );
-    ret = dev->handleReadAttribute(clusterId, attributeMetadata->attributeId, buffer, maxReadLength);
+    ret = dev->readAttribute(clusterId, attributeMetadata->attributeId, buffer, maxReadLength);
     if (ret!=Status::Success) {
       POLOG(dev, LOG_ERR, "NOT HANDLED: reading external attr 0x%04x in cluster 0x%04x", (int)attributeMetadata->attributeId, (int)clusterId);
     }
     else {
       POLOG(dev, LOG_DEBUG, "- result[%d] = %s%s", maxReadLength, dataToHexString(buffer, maxReadLength>16 ? 16 : maxReadLength, ' ').c_str(), maxReadLength>16 ? " ..." : "");
     }
+    MLMicroSeconds stall = StallDetector::sharedDetector().handled(start);
+    if (stall) StallDetector::sharedDetector().stalled(stall, string_format("attribute read in cluster 0x%04x", (int)clusterId), dev->logContextPrefix());
   }
   return ret;
 }
@@ -1276,9 +1667,11 @@ Status emberAfExternalAttributeWriteCallback(
   const EmberAfAttributeMetadata * attributeMetadata, uint8_t * bufferOrZeroes
 )
 {
+  MLMicroSeconds start = MainLoop::now();
   Status ret = Status::Failure;
   DevicePtr dev = deviceForEndPointId(endpoint);
   if (dev) {
+    TRACE_SPAN("matter", "attribute write", string_format("cluster 0x%04x attr 0x%04x - %s", (int)clusterId, (int)attributeMetadata->attributeId, dev->logContextPrefix().c_str()));
     POLOG(dev, LOG_DEBUG, "write external attr 0x%04x in cluster 0x%04x, attr.size=%d", (int)attributeMetadata->attributeId, (int)clusterId, (int)attributeMetadata->size);
     POLOG(dev, LOG_DEBUG, "- new data = %s", bufferOrZeroes ? dataToHexString(bufferOrZeroes, attributeMetadata->size, ' ').c_str() : "<no data provided: treat as all zeroes>");
     if (!bufferOrZeroes) {
@@ -1296,6 +1689,9 @@ Status emberAfExternalAttributeWriteCallback(
     else {
       POLOG(dev, LOG_DEBUG, "- processed external attribute write");
     }
+    dev->invalidateCachedAttribute(clusterId, attributeMetadata->attributeId);
+    MLMicroSeconds stall = StallDetector::sharedDetector().handled(start);
+    if (stall) StallDetector::sharedDetector().stalled(stall, string_format("attribute write in cluster 0x%04x", (int)clusterId), dev->logContextPrefix());
   }
   return ret;
 }
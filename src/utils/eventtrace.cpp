@@ -0,0 +1,172 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "eventtrace.h"
+
+#include "jsonobject.hpp"
+
+#include <stdio.h>
+
+using namespace p44;
+
+// MARK: - EventTrace
+
+bool EventTrace::sEnabled = false;
+
+
+EventTrace::EventTrace() :
+  mNextEvent(0),
+  mWrapped(false),
+  mBufferSize(EVENT_TRACE_BUFFER_SIZE)
+{
+}
+
+
+EventTrace& EventTrace::sharedTrace()
+{
+  static EventTrace trace;
+  return trace;
+}
+
+
+void EventTrace::setup(const string aTraceFile, size_t aBufferSize)
+{
+  mTraceFile = aTraceFile;
+  if (aBufferSize>0) mBufferSize = aBufferSize;
+}
+
+
+void EventTrace::enable(bool aEnable)
+{
+  if (aEnable==sEnabled) return;
+  if (aEnable) {
+    mEvents.clear();
+    mEvents.reserve(mBufferSize);
+    mNextEvent = 0;
+    mWrapped = false;
+    sEnabled = true;
+    LOG(LOG_NOTICE, "event trace started, recording up to %zu events", mBufferSize);
+  }
+  else {
+    sEnabled = false;
+    ErrorPtr err = writeTrace();
+    if (Error::notOK(err)) {
+      LOG(LOG_ERR, "event trace: cannot write '%s': %s", mTraceFile.c_str(), err->text());
+    }
+    else {
+      LOG(LOG_NOTICE, "event trace stopped, %zu events written to '%s'", mWrapped ? mBufferSize : mNextEvent, mTraceFile.c_str());
+    }
+    // release the buffer
+    std::vector<TraceEvent>().swap(mEvents);
+  }
+}
+
+
+void EventTrace::span(const char* aCategory, const char* aName, MLMicroSeconds aStart, const string& aDetail)
+{
+  record(aCategory, aName, aStart, MainLoop::now()-aStart, aDetail);
+}
+
+
+void EventTrace::instant(const char* aCategory, const char* aName, const string& aDetail)
+{
+  record(aCategory, aName, MainLoop::now(), -1, aDetail);
+}
+
+
+void EventTrace::record(const char* aCategory, const char* aName, MLMicroSeconds aTimestamp, MLMicroSeconds aDuration, const string& aDetail)
+{
+  if (mEvents.size()<mBufferSize) {
+    mEvents.push_back(TraceEvent());
+  }
+  TraceEvent& ev = mEvents[mNextEvent];
+  ev.mCategory = aCategory;
+  ev.mName = aName;
+  ev.mDetail = aDetail;
+  ev.mTimestamp = aTimestamp;
+  ev.mDuration = aDuration;
+  mNextEvent++;
+  if (mNextEvent>=mBufferSize) {
+    mNextEvent = 0;
+    mWrapped = true;
+  }
+}
+
+
+ErrorPtr EventTrace::writeTrace()
+{
+  if (mTraceFile.empty()) return TextError::err("no trace file path set");
+  FILE* f = fopen(mTraceFile.c_str(), "w");
+  if (!f) return SysError::errNo();
+  fputs("{\"traceEvents\":[\n", f);
+  size_t n = mWrapped ? mBufferSize : mNextEvent;
+  size_t i = mWrapped ? mNextEvent : 0;
+  for (size_t k=0; k<n; k++) {
+    const TraceEvent& ev = mEvents[i];
+    string s = string_format(
+      "{\"cat\":\"%s\",\"name\":\"%s\",\"pid\":1,\"tid\":1,\"ts\":%lld,",
+      ev.mCategory, ev.mName, (long long)ev.mTimestamp
+    );
+    if (ev.mDuration>=0) string_format_append(s, "\"ph\":\"X\",\"dur\":%lld", (long long)ev.mDuration);
+    else s += "\"ph\":\"i\",\"s\":\"t\"";
+    if (!ev.mDetail.empty()) {
+      s += ",\"args\":{\"detail\":";
+      s += JsonObject::newString(ev.mDetail)->json_str();
+      s += "}";
+    }
+    s += k<n-1 ? "},\n" : "}\n";
+    fputs(s.c_str(), f);
+    if (++i>=mBufferSize) i = 0;
+  }
+  fputs("]}\n", f);
+  fclose(f);
+  return ErrorPtr();
+}
+
+
+#if CHIP_CONFIG_TRANSPORT_TRACE_ENABLED
+
+// MARK: - EventTraceStream
+
+void EventTraceStream::StartEvent(const std::string& aLabel)
+{
+  mLabel = aLabel;
+  mDetail.clear();
+}
+
+
+void EventTraceStream::AddField(const std::string& aTag, const std::string& aData)
+{
+  if (!EventTrace::enabled()) return;
+  if (!mDetail.empty()) mDetail += ", ";
+  mDetail += aTag + "=" + aData;
+}
+
+
+void EventTraceStream::FinishEvent()
+{
+  // Note: event names must be static strings, so the label goes into the detail
+  TRACE_EVENT("chip", "transport", mLabel + ": " + mDetail);
+}
+
+#endif // CHIP_CONFIG_TRANSPORT_TRACE_ENABLED
@@ -0,0 +1,147 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "p44mbrd_common.h"
+
+#include <vector>
+
+using namespace p44;
+
+#ifndef EVENT_TRACE_BUFFER_SIZE
+  #define EVENT_TRACE_BUFFER_SIZE 20000 ///< default number of events kept in the trace ring buffer
+#endif
+
+
+/// @brief recorder for activity traces in Chrome trace event format
+/// While enabled, spans (begin and duration) and instant events are recorded into a ring buffer, using
+/// MainLoop::now() as a common timeline for bridge API, device and matter activity. When disabled, the
+/// buffer is written as Chrome trace event JSON (loadable in chrome://tracing or ui.perfetto.dev).
+/// When not enabled, recording costs a single check of a static flag.
+class EventTrace
+{
+  typedef struct {
+    const char* mCategory; ///< category (static string)
+    const char* mName; ///< event name (static string)
+    string mDetail; ///< optional detail, such as device or method
+    MLMicroSeconds mTimestamp; ///< start of span or time of instant event
+    MLMicroSeconds mDuration; ///< duration of the span, <0 for instant events
+  } TraceEvent;
+
+  static bool sEnabled;
+  std::vector<TraceEvent> mEvents; ///< ring buffer
+  size_t mNextEvent; ///< index of the next event to write in the ring buffer
+  bool mWrapped; ///< set when the ring buffer has wrapped
+  size_t mBufferSize; ///< size of the ring buffer
+  string mTraceFile; ///< file path to write the trace to
+
+public:
+
+  EventTrace();
+
+  /// @return the shared event trace of the application
+  static EventTrace& sharedTrace();
+
+  /// @return true when tracing is enabled
+  static inline bool enabled() { return sEnabled; }
+
+  /// @param aTraceFile path of the file to write the trace to when tracing gets disabled
+  /// @param aBufferSize number of events the ring buffer can hold
+  void setup(const string aTraceFile, size_t aBufferSize);
+
+  /// enable or disable tracing
+  /// @param aEnable true to start recording (discarding previously recorded events),
+  ///   false to stop and write the recorded events to the trace file
+  void enable(bool aEnable);
+
+  /// record a span
+  /// @param aCategory the category, such as "bridge" or "device"
+  /// @param aName the name of the event
+  /// @param aStart start of the span
+  /// @param aDetail detail, such as device or method
+  void span(const char* aCategory, const char* aName, MLMicroSeconds aStart, const string& aDetail);
+
+  /// record an instant event
+  void instant(const char* aCategory, const char* aName, const string& aDetail);
+
+private:
+
+  void record(const char* aCategory, const char* aName, MLMicroSeconds aTimestamp, MLMicroSeconds aDuration, const string& aDetail);
+  ErrorPtr writeTrace();
+
+};
+
+
+/// @brief records a span from its creation to the end of the enclosing scope
+class TraceSpan
+{
+  const char* mCategory;
+  const char* mName;
+  MLMicroSeconds mStart;
+
+public:
+
+  string mDetail; ///< detail to include with the span
+
+  TraceSpan(const char* aCategory, const char* aName) :
+    mCategory(aCategory), mName(aName), mStart(EventTrace::enabled() ? MainLoop::now() : Never) {}
+
+  ~TraceSpan() { if (mStart!=Never && EventTrace::enabled()) EventTrace::sharedTrace().span(mCategory, mName, mStart, mDetail); }
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+/// trace the enclosing scope as a span
+/// @note the detail expression is only evaluated when tracing is enabled
+/// @note the span variable is named after the line, so multiple spans can be used in the same scope
+/// @note the `if (!..) {} else` form prevents a following `else` from binding to the macro's `if`
+#define TRACE_SPAN(cat, name, detail) \
+  TraceSpan TRACE_CONCAT(_traceSpan, __LINE__)(cat, name); \
+  if (!EventTrace::enabled()) {} else TRACE_CONCAT(_traceSpan, __LINE__).mDetail = (detail)
+
+/// trace an instant event
+/// @note the detail expression is only evaluated when tracing is enabled
+#define TRACE_EVENT(cat, name, detail) \
+  if (!EventTrace::enabled()) {} else EventTrace::sharedTrace().instant(cat, name, detail)
+
+
+#if CHIP_CONFIG_TRANSPORT_TRACE_ENABLED
+
+#include <tracing/TraceHandlers.h>
+
+/// @brief trace stream recording chip transport trace events as instant events into the EventTrace
+class EventTraceStream : public chip::trace::TraceStream
+{
+  string mLabel;
+  string mDetail;
+
+public:
+
+  virtual void StartEvent(const std::string& aLabel) override;
+  virtual void AddField(const std::string& aTag, const std::string& aData) override;
+  virtual void FinishEvent() override;
+};
+
+#endif // CHIP_CONFIG_TRANSPORT_TRACE_ENABLED
@@ -51,7 +51,7 @@ string attrString(const EndpointId aEndpointId, const ClusterId aClusterId, cons
 }
 
 
-void setAttrString(const EndpointId aEndpointId, const ClusterId aClusterId, const AttributeId aAttributeId, string aString, p44::AbbreviationStyle aAbbreviationStyle)
+void setAttrString(const EndpointId aEndpointId, const ClusterId aClusterId, const AttributeId aAttributeId, const string& aString, p44::AbbreviationStyle aAbbreviationStyle)
 {
   const size_t maxStrLen = 512;
   uint8_t zclString[maxStrLen+2];
@@ -63,20 +63,48 @@ void setAttrString(const EndpointId aEndpointId, const ClusterId aClusterId, con
     if (emberAfIsStringAttributeType(mdP->attributeType) || longString) {
       size_t netSz = mdP->size-(longString ? 2 : 1);
       if (netSz>maxStrLen) netSz = maxStrLen;
-      abbreviate(aString, netSz, aAbbreviationStyle);
-      if (longString) {
-        memmove(zclString + 2, aString.data(), aString.size());
-        zclString[0] = (uint8_t) ((aString.size()) & 0xFF);
-        zclString[1] = (uint8_t) ((aString.size() >> 8) & 0xFF);
+      size_t hdrSz = longString ? 2 : 1;
+      size_t n;
+      if (aString.size()<=netSz) {
+        // fits, copy directly
+        n = aString.size();
+        memcpy(zclString+hdrSz, aString.data(), n);
       }
       else {
-        memmove(zclString + 1, aString.data(), aString.size());
-        zclString[0] = (uint8_t)aString.size();
+        // needs abbreviation, only now we need a copy
+        string abbr = aString;
+        abbreviate(abbr, netSz, aAbbreviationStyle);
+        n = abbr.size();
+        memcpy(zclString+hdrSz, abbr.data(), n);
       }
+      zclString[0] = (uint8_t)(n & 0xFF);
+      if (longString) zclString[1] = (uint8_t)((n >> 8) & 0xFF);
       emAfReadOrWriteAttribute(&srch, &mdP, zclString, 0, true);
     }
   }
 }
 
 
+string memoryUsageInfo()
+{
+  string info;
+  FILE* f = fopen("/proc/self/status", "r");
+  if (f) {
+    string line;
+    while (string_fgetline(f, line)) {
+      // VmRSS: current resident set size, VmHWM: peak resident set size
+      if (line.compare(0, 6, "VmRSS:")==0 || line.compare(0, 6, "VmHWM:")==0) {
+        string v = line.substr(6);
+        size_t b = v.find_first_not_of(" \t");
+        if (b!=string::npos) v.erase(0, b);
+        if (!info.empty()) info += ", ";
+        info += line.substr(0, 5) + "=" + v;
+      }
+    }
+    fclose(f);
+  }
+  return info;
+}
+
+
 
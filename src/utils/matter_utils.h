@@ -36,7 +36,10 @@ using namespace Clusters;
 using Status = Protocols::InteractionModel::Status;
 
 string attrString(const EndpointId aEndpointId, const ClusterId aClusterId, const AttributeId aAttributeId);
-void setAttrString(const EndpointId aEndpointId, const ClusterId aClusterId, const AttributeId aAttributeId, string aString, p44::AbbreviationStyle aAbbreviationStyle);
+void setAttrString(const EndpointId aEndpointId, const ClusterId aClusterId, const AttributeId aAttributeId, const string& aString, p44::AbbreviationStyle aAbbreviationStyle);
+
+/// @return short info about the process' memory usage (current and peak resident set size), empty if not available
+string memoryUsageInfo();
 
 #define ATTR_STRING(cluster, attr, endpoint) attrString(endpoint, cluster::Id, cluster::Attributes::attr::Id)
 #define SET_ATTR_STRING(cluster, attr, endpoint, string) setAttrString(endpoint, cluster::Id, cluster::Attributes::attr::Id, string, p44::end_ellipsis)
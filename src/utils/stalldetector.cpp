@@ -0,0 +1,126 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "stalldetector.h"
+
+using namespace p44;
+
+// MARK: - StallDetector
+
+// upper limits of the histogram buckets (last bucket is everything above)
+static const MLMicroSeconds gBucketLimits[] = { 1*MilliSecond, 5*MilliSecond, 10*MilliSecond, 50*MilliSecond, 100*MilliSecond, 500*MilliSecond, 1*Second };
+
+
+StallDetector::StallDetector() :
+  mThreshold(0),
+  mLastHeartbeat(Never),
+  mLastAttributedStall(Never)
+{
+  reset();
+}
+
+
+StallDetector& StallDetector::sharedDetector()
+{
+  static StallDetector detector;
+  return detector;
+}
+
+
+void StallDetector::setThreshold(MLMicroSeconds aThreshold)
+{
+  mThreshold = aThreshold;
+  mHeartbeatTicket.cancel();
+  if (mThreshold>0) {
+    mLastHeartbeat = MainLoop::now();
+    mHeartbeatTicket.executeOnce(boost::bind(&StallDetector::heartbeat, this), STALL_HEARTBEAT_INTERVAL);
+  }
+}
+
+
+MLMicroSeconds StallDetector::handled(MLMicroSeconds aStart)
+{
+  if (mThreshold==0) return 0;
+  MLMicroSeconds duration = MainLoop::now()-aStart;
+  int b = 0;
+  while (b<numBuckets-1 && duration>=gBucketLimits[b]) b++;
+  mHistogram[b]++;
+  return duration>mThreshold ? duration : 0;
+}
+
+
+void StallDetector::stalled(MLMicroSeconds aDuration, const string aAttribution, const string aContext)
+{
+  mLastAttributedStall = MainLoop::now();
+  StallStats& s = mStalls[aAttribution];
+  s.mCount++;
+  s.mTotal += aDuration;
+  if (aDuration>s.mMax) {
+    s.mMax = aDuration;
+    s.mMaxContext = aContext;
+  }
+  OLOG(LOG_WARNING, "mainloop stalled for %.1f mS by %s%s%s", (double)aDuration/MilliSecond, aAttribution.c_str(), aContext.empty() ? "" : " - ", aContext.c_str());
+}
+
+
+void StallDetector::heartbeat()
+{
+  MLMicroSeconds now = MainLoop::now();
+  MLMicroSeconds delay = now-mLastHeartbeat-STALL_HEARTBEAT_INTERVAL;
+  if (delay>mThreshold && (mLastAttributedStall==Never || mLastAttributedStall<mLastHeartbeat)) {
+    // delayed, but not by a handler that reported a stall: must be something we do not measure
+    stalled(delay, "unattributed (matter stack or other)", "");
+  }
+  mLastHeartbeat = now;
+  mHeartbeatTicket.executeOnce(boost::bind(&StallDetector::heartbeat, this), STALL_HEARTBEAT_INTERVAL);
+}
+
+
+string StallDetector::statistics()
+{
+  if (mThreshold==0) return "disabled";
+  string s = "handler run times:";
+  for (int b=0; b<numBuckets; b++) {
+    if (b<numBuckets-1) string_format_append(s, " <%lldmS:", (long long)(gBucketLimits[b]/MilliSecond));
+    else string_format_append(s, " >=%lldmS:", (long long)(gBucketLimits[b-1]/MilliSecond));
+    string_format_append(s, "%ld", mHistogram[b]);
+  }
+  string_format_append(s, "; stalls >%lldmS:", (long long)(mThreshold/MilliSecond));
+  if (mStalls.empty()) s += " none";
+  for (StallStatsMap::iterator pos = mStalls.begin(); pos!=mStalls.end(); ++pos) {
+    string_format_append(s,
+      "\n- %s: %ld times, avg %.1f mS, max %.1f mS%s%s",
+      pos->first.c_str(), pos->second.mCount,
+      (double)pos->second.mTotal/pos->second.mCount/MilliSecond, (double)pos->second.mMax/MilliSecond,
+      pos->second.mMaxContext.empty() ? "" : " at ", pos->second.mMaxContext.c_str()
+    );
+  }
+  return s;
+}
+
+
+void StallDetector::reset()
+{
+  for (int b=0; b<numBuckets; b++) mHistogram[b] = 0;
+  mStalls.clear();
+}
@@ -0,0 +1,102 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2023 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44mbrd.
+//
+//  p44mbrd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44mbrd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44mbrd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include "p44mbrd_common.h"
+
+#include <map>
+
+using namespace p44;
+
+#ifndef STALL_HEARTBEAT_INTERVAL
+  #define STALL_HEARTBEAT_INTERVAL (100*MilliSecond) ///< interval of the heartbeat timer detecting stalls not caused by a measured handler
+#endif
+
+
+/// @brief detector for mainloop stalls
+/// Handlers p44mbrd implements itself (bridge API messages and answers, external attribute access) measure
+/// their run time and report it here, with an attribution (the handler, like a notification type or cluster)
+/// and a context (like the device). All measured run times go into a histogram, those exceeding the
+/// threshold are logged and accounted per attribution. Stalls caused by code not measured this way (matter
+/// stack timers, report engine runs etc.) are detected as delays of a heartbeat timer.
+class StallDetector : public P44LoggingObj
+{
+  typedef P44LoggingObj inherited;
+
+  MLMicroSeconds mThreshold; ///< handler run times exceeding this are considered stalls, 0 = detector disabled
+  MLTicket mHeartbeatTicket; ///< heartbeat timer to detect unattributed stalls
+  MLMicroSeconds mLastHeartbeat; ///< when the heartbeat timer last ran
+  MLMicroSeconds mLastAttributedStall; ///< when the last attributed stall ended
+
+  static const int numBuckets = 8;
+  long mHistogram[numBuckets]; ///< number of handler runs per run time bucket
+
+  typedef struct {
+    long mCount; ///< number of stalls
+    MLMicroSeconds mTotal; ///< accumulated stall time
+    MLMicroSeconds mMax; ///< longest stall
+    string mMaxContext; ///< context of the longest stall
+  } StallStats;
+  typedef std::map<string, StallStats> StallStatsMap;
+  StallStatsMap mStalls; ///< stall statistics per attribution
+
+public:
+
+  StallDetector();
+
+  /// @return the shared stall detector of the application
+  static StallDetector& sharedDetector();
+
+  virtual string logContextPrefix() override { return "stall detector"; }
+
+  /// @param aThreshold handler run times exceeding this are logged and accounted as stalls, 0 = disabled
+  void setThreshold(MLMicroSeconds aThreshold);
+
+  /// @return true if the detector is enabled
+  bool enabled() { return mThreshold>0; }
+
+  /// account the run time of a handler
+  /// @param aStart the time (MainLoop::now()) when the handler started
+  /// @return the run time of the handler if it exceeded the threshold, 0 otherwise. When non-zero, the
+  ///   caller must report it with an attribution by calling stalled().
+  /// @note this is cheap, so attribution info needs to be built only in the (rare) case of a stall
+  MLMicroSeconds handled(MLMicroSeconds aStart);
+
+  /// log and account a stall
+  /// @param aDuration the stall time, as returned by handled()
+  /// @param aAttribution what caused the stall, such as "notification 'push'". Stalls are accounted per attribution.
+  /// @param aContext additional info, such as the device concerned (not used for accounting)
+  void stalled(MLMicroSeconds aDuration, const string aAttribution, const string aContext);
+
+  /// @return statistics (histogram and stalls per attribution) as text
+  string statistics();
+
+  /// reset the statistics
+  void reset();
+
+private:
+
+  void heartbeat();
+
+};